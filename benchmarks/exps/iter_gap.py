@@ -0,0 +1,76 @@
+# -*- coding: future_fstrings -*-
+#
+# Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+# 
+# This file is part of Salus
+# (see https://github.com/SymbioticLab/Salus).
+# 
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+# 
+#    http://www.apache.org/licenses/LICENSE-2.0
+# 
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+"""
+Iteration gap: Measure queue-to-start latency of iterations in the ExecutionEngine
+
+Two training jobs are started together, so that they are packed into the same lane and each
+of their iterations has to wait for the other job's iteration to finish before it can start.
+
+The ExecutionEngine writes an `iter_start` event to the performance log for every expensive
+iteration, with the time the iteration spent in queue (queued_us), and the time since it became
+runnable (gap_us), i.e. since it was queued or the previous iteration on the lane finished,
+whichever is later.
+
+Collected data: the performance log, use scripts/parse_iter_gap.py to get the distribution.
+"""
+from __future__ import absolute_import, print_function, division, unicode_literals
+
+from absl import flags
+import logging
+
+from benchmarks.driver.server.config import presets
+from benchmarks.driver.workload import WTL, Executor
+from benchmarks.exps import run_seq, maybe_forced_preset, case_switch_main
+
+
+FLAGS = flags.FLAGS
+logger = logging.getLogger(__name__)
+
+
+def same_lane(argv):
+    """Run two copies of the same workload concurrently. Defaults to inception4 50"""
+    name = argv[0] if len(argv) > 0 else 'inception4'
+    bs = int(argv[1]) if len(argv) > 1 else 50
+    batch_num = int(argv[2]) if len(argv) > 2 else 200
+
+    scfg = maybe_forced_preset(presets.Profiling)
+
+    run_seq(scfg.copy(output_dir=FLAGS.save_dir / 'same_lane' / f'{name}_{bs}'),
+            WTL.create(name, bs, batch_num, executor=Executor.Salus),
+            WTL.create(name, bs, batch_num, executor=Executor.Salus),
+            )
+
+
+def alone(argv):
+    """Run one workload alone, which measures the engine overhead without any contention"""
+    name = argv[0] if len(argv) > 0 else 'inception4'
+    bs = int(argv[1]) if len(argv) > 1 else 50
+    batch_num = int(argv[2]) if len(argv) > 2 else 200
+
+    scfg = maybe_forced_preset(presets.Profiling)
+
+    run_seq(scfg.copy(output_dir=FLAGS.save_dir / 'alone' / f'{name}_{bs}'),
+            WTL.create(name, bs, batch_num, executor=Executor.Salus),
+            )
+
+
+@case_switch_main
+def main():
+    return same_lane, alone
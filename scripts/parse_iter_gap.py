@@ -0,0 +1,72 @@
+#
+# Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+# 
+# This file is part of Salus
+# (see https://github.com/SymbioticLab/Salus).
+# 
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+# 
+#    http://www.apache.org/licenses/LICENSE-2.0
+# 
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+"""
+Report the distribution of iteration queue-to-start latency from a performance log
+
+Usage: parse_iter_gap.py <perf.output> [<perf.output> ...]
+"""
+from __future__ import print_function, absolute_import, division
+
+import json
+import re
+import sys
+
+import pandas as pd
+
+
+ptn_iter_start = re.compile(r'''event: \s iter_start \s (?P<evt>\{.*\})''', re.VERBOSE)
+
+
+def load_file(path):
+    rows = []
+    with open(path) as f:
+        for line in f:
+            m = ptn_iter_start.search(line)
+            if not m:
+                continue
+            rows.append(json.loads(m.group('evt')))
+    return pd.DataFrame(rows, columns=['sess', 'graphId', 'laneId', 'queued_us', 'gap_us'])
+
+
+def distribution(series):
+    return series.describe(percentiles=[.5, .9, .99, .999])
+
+
+def main(paths):
+    df = pd.concat([load_file(p) for p in paths], ignore_index=True)
+    if df.empty:
+        print('No iter_start event found, is performance logging enabled?')
+        return
+
+    print('Gap since runnable (us):')
+    print(distribution(df.gap_us).to_string())
+    print()
+    print('Time in queue (us):')
+    print(distribution(df.queued_us).to_string())
+    print()
+    print('Gap since runnable per lane (us):')
+    print(df.groupby('laneId').gap_us.describe(percentiles=[.5, .99]).to_string())
+
+
+if __name__ == '__main__':
+    if len(sys.argv) < 2:
+        print(__doc__)
+        sys.exit(1)
+    main(sys.argv[1:])
@@ -35,6 +35,7 @@ ResourceContext::ResourceContext(const ResourceContext &other, const DeviceSpec
     , m_hasStaging(false)
     , m_listeners(other.m_listeners)
 {
+    resMon.retainTicket(m_ticket);
 }
 
 ResourceContext::ResourceContext(ResourceMonitor &resMon, uint64_t graphId, const DeviceSpec &spec,
@@ -60,11 +61,12 @@ void ResourceContext::releaseStaging()
 ResourceContext::~ResourceContext()
 {
     releaseStaging();
+    resMon.releaseTicket(m_ticket);
 }
 
 ResourceContext::OperationScope ResourceContext::alloc(ResourceType type) const
 {
-    OperationScope scope(*this, resMon.lock());
+    OperationScope scope(*this, resMon.lock(m_ticket));
 
     auto staging = scope.proxy.queryStaging(m_ticket);
     auto num = sstl::optionalGet(staging, {type, m_spec});
@@ -80,7 +82,7 @@ ResourceContext::OperationScope ResourceContext::alloc(ResourceType type) const
 
 ResourceContext::OperationScope ResourceContext::alloc(ResourceType type, size_t num) const
 {
-    OperationScope scope(*this, resMon.lock());
+    OperationScope scope(*this, resMon.lock(m_ticket));
 
     scope.res[{type, m_spec}] = num;
     scope.valid = scope.proxy.allocate(m_ticket, scope.res);
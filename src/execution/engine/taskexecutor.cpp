@@ -34,6 +34,7 @@ using std::chrono::microseconds;
 using std::chrono::milliseconds;
 using std::chrono::nanoseconds;
 using std::chrono::seconds;
+using std::chrono::steady_clock;
 using std::chrono::system_clock;
 using FpSeconds = std::chrono::duration<double, seconds::period>;
 using namespace std::chrono_literals;
@@ -79,6 +80,13 @@ TaskExecutor::TaskExecutor(ThreadPool &pool, ResourceMonitor &resMonitor, Schedu
     , m_pool(pool)
     , m_schedParam(param)
 {
+    // sessions blocked on resources may proceed
+    m_resMonitor.setReleaseCallback([this]() {
+        m_resourcesReleased = true;
+        m_note_has_work.notify();
+    });
+    // sessions parked on the full thread pool may proceed
+    m_pool.setDrainCallback([this]() { m_note_has_work.notify(); });
 }
 
 void TaskExecutor::startExecution()
@@ -97,6 +105,13 @@ void TaskExecutor::stopExecution()
     if (m_schedThread->joinable()) {
         m_schedThread->join();
     }
+
+    auto stats = m_pool.queueStats();
+    CLOG(INFO, logging::kPerfTag) << "event: threadpool_stats "
+                                  << nlohmann::json({
+                                         {"overflowed", stats.overflowed},
+                                         {"spilled", stats.spilled},
+                                     });
 }
 
 void TaskExecutor::insertSession(PSessionItem sess)
@@ -130,6 +145,15 @@ void TaskExecutor::queueTask(POpItem &&opItem)
     }
 
     item->queueTask(std::move(opItem));
+    markReady(item);
+}
+
+void TaskExecutor::markReady(const PSessionItem &sess)
+{
+    if (!sess->inReadySet.exchange(true)) {
+        auto g = sstl::with_guard(m_readyMu);
+        m_readySessions.emplace_back(sess);
+    }
     m_note_has_work.notify();
 }
 
@@ -145,12 +169,23 @@ void TaskExecutor::scheduleLoop()
     m_nRunningTasks = 0;
     m_nNoPagingRunningTasks = 0;
 
+    // how long to wait before trying sessions blocked on resources again, even if nothing was released
+    constexpr auto kBlockedRecheck = 100ms;
+
     size_t schedIterCount = 0;
     boost::container::small_vector<PSessionItem, 5> candidates;
+    // sessions to examine in this pass
+    boost::container::small_vector<PSessionItem, 16> ready;
+    std::vector<PSessionItem> incoming;
+    // sessions with pending tasks that couldn't be scheduled, waiting for resources
+    SessionSet blocked;
+    // sessions with pending tasks, waiting for workers to drain the full thread pool
+    SessionSet parked;
     bool interrupted = false;
 
     while (!m_shouldExit) {
         SessionChangeSet changeset;
+        ready.clear();
         // First accept and append any new sessions
         {
             auto g = sstl::with_guard(m_newMu);
@@ -170,6 +205,13 @@ void TaskExecutor::scheduleLoop()
             }
             DCHECK(m_newSessions.empty());
         }
+        for (auto sit = changeset.addedSessionBegin; sit != changeset.addedSessionEnd; ++sit) {
+            // tasks may be queued before the session is accepted, in which case
+            // it's already in m_readySessions and gets collected below
+            if (!(*sit)->inReadySet.exchange(true)) {
+                ready.emplace_back(*sit);
+            }
+        }
 
         // then check if there's any pending deletions.
         // NOTE: this must happen after adding new sessions.
@@ -192,9 +234,25 @@ void TaskExecutor::scheduleLoop()
             }
         }
 
+        // Sessions with paging in progress are deleted once it finishes, as paging callbacks
+        // may still be called.
+        SessionSet deferred;
+        for (const auto &sess : changeset.deletedSessions) {
+            if (sess->pagingInFlight) {
+                deferred.emplace(sess);
+            }
+        }
+        if (!deferred.empty()) {
+            for (const auto &sess : deferred) {
+                changeset.deletedSessions.erase(sess);
+            }
+            auto g = sstl::with_guard(m_delMu);
+            m_deletedSessions.insert(deferred.begin(), deferred.end());
+        }
+
         // Delete sessions as requested
         // NOTE: don't clear del yet, we need that in changeset for scheduling
-        m_sessions.remove_if([&changeset](auto sess) {
+        m_sessions.remove_if([&changeset, &blocked, &parked](const auto &sess) {
             bool deleted = changeset.deletedSessions.count(sess) > 0;
             if (deleted) {
                 LOG(INFO) << "Deleting session " << sess->sessHandle << "@" << as_hex(sess);
@@ -209,6 +267,9 @@ void TaskExecutor::scheduleLoop()
                 // So it's legit for tickets to be nonempty
                 // DCHECK(item->tickets.empty());
 
+                blocked.erase(sess);
+                parked.erase(sess);
+
                 // Fix the addedSessionBegin iterator if we are to delete it
                 if (changeset.addedSessionBegin != changeset.addedSessionEnd && *changeset.addedSessionBegin == sess) {
                     ++changeset.addedSessionBegin;
@@ -219,24 +280,57 @@ void TaskExecutor::scheduleLoop()
 
         if (m_interrupting && !interrupted) {
             interrupted = true;
-            // Request interrupt on any existing sessions
+            // Request interrupt on any existing sessions, and cancel their pending tasks below
             for (const auto &sess : m_sessions) {
                 sess->interrupt();
+                markReady(sess);
+            }
+        }
+
+        // Collect sessions to examine in this pass
+        {
+            auto g = sstl::with_guard(m_readyMu);
+            incoming.swap(m_readySessions);
+        }
+        for (auto &sess : incoming) {
+            ready.emplace_back(std::move(sess));
+        }
+        incoming.clear();
+        for (auto &sess : ready) {
+            blocked.erase(sess);
+            parked.erase(sess);
+        }
+        if (m_resourcesReleased.exchange(false)) {
+            for (auto &sess : blocked) {
+                sess->inReadySet = true;
+                ready.emplace_back(sess);
             }
+            blocked.clear();
         }
+        // Don't retry while the thread pool is full, wait for the drain notification instead
+        const bool saturated = m_pool.saturated();
+        if (!saturated) {
+            for (auto &sess : parked) {
+                sess->inReadySet = true;
+                ready.emplace_back(sess);
+            }
+            parked.clear();
+        }
+        // Clear the mark before looking at the queue, so tasks queued from now on mark it again
+        ready.erase(std::remove_if(ready.begin(), ready.end(),
+                                   [&changeset](const auto &sess) {
+                                       sess->inReadySet = false;
+                                       return changeset.deletedSessions.count(sess) > 0;
+                                   }),
+                    ready.end());
 
         // Prepare session ready for this iter of schedule:
         // - move from front end queue to backing storage
         // - reset lastScheduled
-        size_t totalRemainingCount = 0;
-
         // since iteration based execution, we can enable this
         const bool enableOOMProtect = true;
-        for (auto &item : m_sessions) {
-            {
-                auto g = sstl::with_guard(item->mu);
-                item->bgQueue.splice(item->bgQueue.end(), item->queue);
-            }
+        for (auto &item : ready) {
+            item->drainInbox();
 
             if (item->forceEvicted) {
                 VLOG(2) << "Canceling pending tasks in forced evicted seesion: " << item->sessHandle;
@@ -247,8 +341,6 @@ void TaskExecutor::scheduleLoop()
                 item->bgQueue.clear();
             }
 
-            totalRemainingCount += item->bgQueue.size();
-
             item->protectOOM = enableOOMProtect;
             item->lastScheduled = 0;
         }
@@ -261,11 +353,22 @@ void TaskExecutor::scheduleLoop()
             } else {
                 LOG(INFO) << "Waiting for " << m_sessions.size() << " sessions to finish";
             }
+            m_note_has_work.wait();
             continue;
         }
 
+        if (saturated) {
+            for (auto &item : ready) {
+                if (!item->bgQueue.empty()) {
+                    parked.emplace(item);
+                }
+            }
+            ready.clear();
+        }
+
         // Select and sort candidates.
-        scheduler->notifyPreSchedulingIteration(m_sessions, changeset, &candidates);
+        // NOTE: this is still called when parking everything, to keep the scheduler updated on session changes.
+        scheduler->notifyPreSchedulingIteration(ready, changeset, &candidates);
 
         // Deleted sessions are no longer needed, release them.
         changeset.deletedSessions.clear();
@@ -274,6 +377,7 @@ void TaskExecutor::scheduleLoop()
         // NOTE: remainingCount only counts for candidate sessions in this sched iter.
         size_t remainingCount = 0;
         size_t scheduled = 0;
+        size_t visited = 0;
         for (auto &item : candidates) {
             VLOG(3) << "Scheduling all opItem in session " << item->sessHandle << ": queue size "
                     << item->bgQueue.size();
@@ -281,6 +385,7 @@ void TaskExecutor::scheduleLoop()
             // Try schedule from this session
             auto [count, shouldContinue] = scheduler->maybeScheduleFrom(item);
             item->lastScheduled = count;
+            ++visited;
 
             remainingCount += item->bgQueue.size();
             scheduled += item->lastScheduled;
@@ -290,51 +395,62 @@ void TaskExecutor::scheduleLoop()
             }
         }
 
+        // Sessions that were not tried, or made progress, may schedule more right away.
+        // Others wait until some resources are released, or the thread pool drains.
+        const bool nowSaturated = m_pool.saturated();
+        for (size_t i = 0; i != candidates.size(); ++i) {
+            auto &item = candidates[i];
+            if (item->bgQueue.empty()) {
+                continue;
+            }
+            if (nowSaturated) {
+                parked.emplace(item);
+            } else if (i >= visited || item->lastScheduled > 0) {
+                markReady(item);
+            } else {
+                blocked.emplace(item);
+            }
+        }
+
         // Log performance counters
         CLOG(INFO, logging::kPerfTag)
             << "Scheduler iter stat: " << schedIterCount << " running: " << m_nRunningTasks
-            << " noPageRunning: " << m_nNoPagingRunningTasks;
-        for (auto &item : m_sessions) {
+            << " noPageRunning: " << m_nNoPagingRunningTasks << " ready: " << ready.size()
+            << " blocked: " << blocked.size() << " parked: " << parked.size();
+        for (size_t i = 0; i != visited; ++i) {
+            auto &item = candidates[i];
             CLOG(INFO, logging::kPerfTag)
                 << "Sched iter " << schedIterCount << " session: " << item->sessHandle
                 << " pending: " << item->bgQueue.size() << " scheduled: " << item->lastScheduled << " "
                 << scheduler->debugString(item);
         }
+        candidates.clear();
 
         // Update conditions and check if we need paging
         bool noProgress = remainingCount > 0 && scheduled == 0 && m_nNoPagingRunningTasks == 0;
         reportNoProgress(noProgress);
 
-        /*
-        bool didPaging = false;
-        // TODO: we currently assume we are paging GPU memory to CPU
-        for (const auto &dev : {devices::GPU0}) {
-            if (noProgress && scheduler->insufficientMemory(dev)) {
-                if (m_sessions.size() > 1) {
-                    didPaging = doPaging(dev, devices::CPU0);
-                } else if (m_sessions.size() == 1) {
-                    LOG(ERROR) << "OOM on device " << dev
-                               << " for single session happened: " << m_sessions.front()->sessHandle;
-                    {
-                        auto g = sstl::with_guard(m_sessions.front()->tickets_mu);
-                        auto usage = m_resMonitor.queryUsages(m_sessions.front()->tickets);
-                        LOG(ERROR) << "This session usage:" << resources::DebugString(usage);
-                    }
-                    LOG(ERROR) << m_resMonitor.DebugString();
+        // Nothing can make progress because device memory is used up. Page out some other session's
+        // data to make room. This is asynchronous, released memory wakes up the loop again.
+        if (noProgress && m_schedParam.enablePaging) {
+            // TODO: we currently assume we are paging GPU memory to CPU
+            for (const auto &dev : {devices::GPU0}) {
+                if (scheduler->insufficientMemory(dev)) {
+                    doPaging(dev, devices::CPU0);
                 }
             }
         }
-        // succeed, retry another sched iter immediately
-        if (didPaging) {
-            continue;
-        }
-        */
 
         maybeWaitForAWhile(scheduled);
 
-        if (!totalRemainingCount) {
-            VLOG(2) << "TaskExecutor wait on m_note_has_work";
+        // The notification is sticky, so anything marked ready during this pass is not lost.
+        // Blocked sessions are retried once in a while, so no progress is still reported,
+        // but not while the thread pool is full.
+        VLOG(2) << "TaskExecutor wait on m_note_has_work";
+        if (blocked.empty() || m_pool.saturated()) {
             m_note_has_work.wait();
+        } else if (!m_note_has_work.wait_until(steady_clock::now() + kBlockedRecheck)) {
+            m_resourcesReleased = true;
         }
     }
 
@@ -360,60 +476,176 @@ bool TaskExecutor::maybeWaitForAWhile(size_t scheduled)
     return false;
 }
 
-POpItem TaskExecutor::runTask(POpItem &&opItem)
+namespace {
+// Points to the slot for the next task to run, while a pool worker is running a chain of tasks
+thread_local POpItem *t_chainNext = nullptr;
+} // namespace
+
+ThreadPool::Closure TaskExecutor::makeRunClosure(POpItem opItem)
+{
+    return [opItem = std::move(opItem), this]() mutable {
+        DCHECK(opItem);
+        runChain(std::move(opItem));
+    };
+}
+
+void TaskExecutor::runChain(POpItem &&opItem)
+{
+    POpItem next;
+    auto prev = std::exchange(t_chainNext, &next);
+    while (opItem) {
+        startTask(std::move(opItem));
+        // set if the task finished synchronously and its session has more admitted tasks
+        opItem = std::move(next);
+    }
+    t_chainNext = prev;
+}
+
+void TaskExecutor::startTask(POpItem &&opItem)
 {
     auto item = opItem->sess.lock();
     if (!item) {
-        // discard
-        return nullptr;
+        return;
     }
 
-    // NOTE: this is waited by schedule thread, so we can't afford running
-    // the operation inline. If the thread pool is full, simply consider the
-    // opItem as not scheduled.
+    OperationTask::Callbacks cbs;
+
+    // capture an session item untile done
+    cbs.done = [item, opItem, this]() {
+        // succeed
+        taskStopped(*opItem, false);
+        continueChain(*item);
+    };
+    cbs.memFailure = [opItem, this]() mutable {
+        auto item = opItem->sess.lock();
+        if (!item) {
+            VLOG(2) << "Found expired session during handling of memory failure of opItem: " << opItem->op;
+            return false;
+        }
+        if (opItem->op->hasExactEstimation(opItem->op->resourceContext().spec()) && !item->protectOOM) {
+            VLOG(2) << "Pass through OOM failed task back to client: " << opItem->op;
+            return false;
+        }
 
-    // opItem has to be captured by value, we need it in case the thread pool is full
-    auto c = m_pool.tryRun([opItem, this]() mutable {
-        DCHECK(opItem);
+        taskStopped(*opItem, true);
+        continueChain(*item);
+        // failed due to OOM. Push back to queue and retry later
+        VLOG(2) << "Putting back OOM failed task: " << opItem->op;
+        queueTask(std::move(opItem));
+        return true;
+    };
 
-        if (auto item = opItem->sess.lock()) {
-            OperationTask::Callbacks cbs;
-
-            // capture an session item untile done
-            cbs.done = [item, opItem, this]() {
-                // succeed
-                taskStopped(*opItem, false);
-            };
-            cbs.memFailure = [opItem, this]() mutable {
-                auto item = opItem->sess.lock();
-                if (!item) {
-                    VLOG(2) << "Found expired session during handling of memory failure of opItem: "
-                            << opItem->op;
-                    return false;
-                }
-                if (opItem->op->hasExactEstimation(opItem->op->resourceContext().spec())
-                    && !item->protectOOM) {
-                    VLOG(2) << "Pass through OOM failed task back to client: " << opItem->op;
-                    return false;
-                }
+    VLOG(2) << "Running opItem in session " << item->sessHandle << ": " << opItem->op;
+    taskRunning(*opItem);
+    opItem->op->run(std::move(cbs));
+}
 
-                taskStopped(*opItem, true);
-                // failed due to OOM. Push back to queue and retry later
-                VLOG(2) << "Putting back OOM failed task: " << opItem->op;
-                queueTask(std::move(opItem));
-                return true;
-            };
+void TaskExecutor::continueChain(SessionItem &item)
+{
+    if (!m_schedParam.chainTasks) {
+        return;
+    }
 
-            VLOG(2) << "Running opItem in session " << item->sessHandle << ": " << opItem->op;
-            taskRunning(*opItem);
-            opItem->op->run(std::move(cbs));
+    POpItem next;
+    {
+        auto g = sstl::with_guard(item.chainMu);
+        if (item.chained.empty()) {
+            --item.numChainRunning;
+            return;
         }
-    });
-    if (!c) {
+        next = std::move(item.chained.front());
+        item.chained.pop_front();
+    }
+
+    if (t_chainNext && !*t_chainNext) {
+        // on a worker running a chain, the next task is run once the current one returns
+        *t_chainNext = std::move(next);
+    } else {
+        // finished elsewhere, e.g. on a completion thread, or nested in another chain
+        m_pool.run(makeRunClosure(std::move(next)));
+    }
+}
+
+POpItem TaskExecutor::runTask(POpItem &&opItem)
+{
+    std::vector<POpItem> batch;
+    batch.emplace_back(std::move(opItem));
+    runTasks(batch);
+    return std::move(batch.front());
+}
+
+size_t TaskExecutor::runTasks(std::vector<POpItem> &opItems)
+{
+    // NOTE: this is waited by schedule thread, so we can't afford running
+    // the operation inline. If the thread pool is full, tasks wait in its
+    // overflow queue, and the pool is saturated until it drains, so the
+    // scheduling loop holds back more tasks meanwhile.
+
+    const auto chaining = m_schedParam.chainTasks;
+    const auto maxChains = m_pool.numThreads();
+
+    size_t sent = 0;
+    std::vector<ThreadPool::Closure> closures;
+    std::vector<size_t> indices;
+    closures.reserve(opItems.size());
+    indices.reserve(opItems.size());
+    for (size_t i = 0; i != opItems.size(); ++i) {
+        auto &opItem = opItems[i];
+        if (!opItem) {
+            continue;
+        }
+        auto item = opItem->sess.lock();
+        if (!item) {
+            // discard
+            opItem.reset();
+            ++sent;
+            continue;
+        }
+        if (chaining) {
+            auto g = sstl::with_guard(item->chainMu);
+            if (item->numChainRunning >= maxChains) {
+                // enough running tasks to pick this one up once they finish
+                item->chained.emplace_back(std::move(opItem));
+                ++sent;
+                continue;
+            }
+            ++item->numChainRunning;
+        }
+        // opItem has to be captured by value, we need it in case the thread pool is full
+        closures.emplace_back(makeRunClosure(opItem));
+        indices.emplace_back(i);
+    }
+
+    auto accepted = m_pool.tryRunBatch(closures);
+    for (size_t j = 0; j != accepted; ++j) {
         // successfully sent to thread pool, we can reset opItem
-        opItem.reset();
+        opItems[indices[j]].reset();
+    }
+    sent += accepted;
+
+    if (!chaining) {
+        return sent;
     }
-    return std::move(opItem);
+
+    // Give back the reserved chains. If this leaves a session without running tasks,
+    // nothing would pick up its admitted tasks, so put them back to queue.
+    for (auto j = accepted; j < indices.size(); ++j) {
+        auto item = opItems[indices[j]]->sess.lock();
+        if (!item) {
+            continue;
+        }
+        std::deque<POpItem> stranded;
+        {
+            auto g = sstl::with_guard(item->chainMu);
+            if (--item->numChainRunning == 0) {
+                stranded.swap(item->chained);
+            }
+        }
+        for (auto &opItem : stranded) {
+            queueTask(std::move(opItem));
+        }
+    }
+    return sent;
 }
 
 void TaskExecutor::taskRunning(OperationItem &opItem)
@@ -450,6 +682,11 @@ void TaskExecutor::taskStopped(OperationItem &opItem, bool failed)
 
 bool TaskExecutor::doPaging(const DeviceSpec &spec, const DeviceSpec &target)
 {
+    if (m_pageOutInFlight) {
+        // wait for it to release some memory first
+        return true;
+    }
+
     auto now = system_clock::now();
     size_t released = 0;
     std::string forceEvicitedSess;
@@ -492,51 +729,53 @@ bool TaskExecutor::doPaging(const DeviceSpec &spec, const DeviceSpec &target)
         }
     }
 
-    // Step 2: inform owner to do paging given suggestion
+    // Step 2: ask owner of the first possible session to page out its largest victim.
+    // The page out runs asynchronously, released memory wakes up the scheduling loop.
     for (size_t i = 1; i != candidates.size(); ++i) {
         auto &pSess = candidates[i].second.get();
-        std::vector<std::pair<size_t, uint64_t>> victims;
-        {
-            auto g = sstl::with_guard(pSess->tickets_mu);
-            if (pSess->tickets.empty()) {
-                // no need to go beyond
-                break;
-            }
-            victims = m_resMonitor.sortVictim(pSess->tickets);
+        if (pSess->pagingInFlight) {
+            continue;
         }
 
-        // we will be doing paging on this session. Lock it's input queue lock
-        // also prevents the executor from clearing the paging callbacks.
-        // This should not create deadlock as nothing could finish at this time,
-        // thus no new tasks could be submitted.
-        auto g = sstl::with_guard(pSess->mu);
-        if (!pSess->pagingCb) {
+        if (pSess->tickets.empty()) {
+            // no need to go beyond
+            break;
+        }
+        std::unordered_set<uint64_t> owned;
+        pSess->tickets.forEach([&owned](uint64_t t) { owned.insert(t); });
+        auto victims = m_resMonitor.sortVictim(owned);
+        if (victims.empty()) {
+            continue;
+        }
+
+        PagingCallbacks pcb;
+        {
+            auto g = sstl::with_guard(pSess->mu);
+            pcb = pSess->pagingCb;
+        }
+        if (!pcb) {
             continue;
         }
 
         VLOG(2) << "Visiting session: " << pSess->sessHandle;
 
-        for (auto [usage, victim] : victims) {
-            // preallocate some CPU memory for use.
-            Resources res{{dstTag, usage}};
+        auto [usage, victim] = victims.front();
+        // preallocate some CPU memory for use.
+        Resources res{{dstTag, usage}};
 
-            auto rctx = makeResourceContext(pSess, 0, target, res);
-            if (!rctx) {
-                LOG(ERROR) << "No enough CPU memory for paging. Required: " << res[dstTag] << " bytes";
-                return false;
-            }
-            LogAlloc() << "Pre allocated " << *rctx << " for session=" << pSess->sessHandle;
-
-            VLOG(2) << "    request to page out ticket " << victim << " of usage " << usage;
-            // request the session to do paging
-            released += pSess->pagingCb.volunteer(victim, std::move(rctx));
-            if (released > 0) {
-                // someone freed some memory on GPU, we are good to go.
-                VLOG(2) << "    released " << released << " bytes via paging";
-                return true;
-            }
-            VLOG(2) << "    failed";
+        auto rctx = makeResourceContext(pSess, 0, target, res);
+        if (!rctx) {
+            LOG(ERROR) << "No enough CPU memory for paging. Required: " << res[dstTag] << " bytes";
+            return false;
         }
+        LogAlloc() << "Pre allocated " << *rctx << " for session=" << pSess->sessHandle;
+
+        VLOG(2) << "    request to page out ticket " << victim << " of usage " << usage;
+        if (startPageOut(pSess, std::move(pcb), victim, std::move(rctx))) {
+            released = usage;
+            return true;
+        }
+        VLOG(2) << "    failed";
         // continue to next session
     }
 
@@ -546,8 +785,9 @@ bool TaskExecutor::doPaging(const DeviceSpec &spec, const DeviceSpec &target)
     }
     LOG(ERROR) << "Dump resource monitor status: " << m_resMonitor.DebugString();
 
-    // Forcely kill one session
-    for (auto [usage, pSess] : candidates) {
+    // Forcely kill one session, keeping the one with largest memory usage as in step 1.2
+    for (auto it = std::next(candidates.begin()); it != candidates.end(); ++it) {
+        auto [usage, pSess] = *it;
         // for logging
         forceEvicitedSess = pSess.get()->sessHandle;
 
@@ -563,6 +803,84 @@ bool TaskExecutor::doPaging(const DeviceSpec &spec, const DeviceSpec &target)
     return false;
 }
 
+bool TaskExecutor::startPageOut(const PSessionItem &sess, PagingCallbacks pcb, uint64_t victim,
+                                std::unique_ptr<ResourceContext> &&rctx)
+{
+    if (sess->pagingInFlight.exchange(true)) {
+        return false;
+    }
+    m_pageOutInFlight = true;
+
+    m_pool.run([this, sess, volunteer = std::move(pcb.volunteer), victim,
+                            rctx = std::move(rctx)]() mutable {
+        auto start = steady_clock::now();
+        auto released = volunteer(victim, std::move(rctx));
+        sess->pagedOut += released;
+
+        CLOG(INFO, logging::kPerfTag) << "event: page_out "
+                                      << nlohmann::json({
+                                             {"sess", sess->sessHandle},
+                                             {"ticket", victim},
+                                             {"released", released},
+                                             {"duration_us", duration_cast<microseconds>(steady_clock::now() - start).count()},
+                                         });
+
+        sess->pagingInFlight = false;
+        m_pageOutInFlight = false;
+        // released memory already wakes us up, but deferred session deletion may also proceed now
+        m_note_has_work.notify();
+    });
+    return true;
+}
+
+bool TaskExecutor::prefetch(const PSessionItem &sess, const DeviceSpec &spec, std::function<void()> done)
+{
+    if (!m_schedParam.enablePaging) {
+        return false;
+    }
+    auto bytes = sess->pagedOut.load();
+    if (bytes == 0 || sess->pagingInFlight.exchange(true)) {
+        return false;
+    }
+
+    PagingCallbacks pcb;
+    {
+        auto g = sstl::with_guard(sess->mu);
+        pcb = sess->pagingCb;
+    }
+
+    std::unique_ptr<ResourceContext> rctx;
+    if (pcb.prefetch) {
+        rctx = makeResourceContext(sess, 0, spec, Resources{{{ResourceType::MEMORY, spec}, bytes}});
+    }
+    if (!rctx) {
+        VLOG(2) << "Can't prefetch " << bytes << " bytes for session " << sess->sessHandle;
+        sess->pagingInFlight = false;
+        return false;
+    }
+
+    m_pool.run([this, sess, prefetch = std::move(pcb.prefetch), rctx = std::move(rctx),
+                            done = std::move(done)]() mutable {
+        auto start = steady_clock::now();
+        auto restored = prefetch(std::move(rctx));
+        sess->pagedOut -= std::min(restored, sess->pagedOut.load());
+
+        CLOG(INFO, logging::kPerfTag) << "event: page_in "
+                                      << nlohmann::json({
+                                             {"sess", sess->sessHandle},
+                                             {"restored", restored},
+                                             {"duration_us", duration_cast<microseconds>(steady_clock::now() - start).count()},
+                                         });
+
+        sess->pagingInFlight = false;
+        m_note_has_work.notify();
+        if (done) {
+            done();
+        }
+    });
+    return true;
+}
+
 std::unique_ptr<ResourceContext> TaskExecutor::makeResourceContext(PSessionItem sess, uint64_t graphId,
                                                                    const DeviceSpec &spec,
                                                                    const Resources &res, Resources *missing)
@@ -573,7 +891,13 @@ std::unique_ptr<ResourceContext> TaskExecutor::makeResourceContext(PSessionItem
         return nullptr;
     }
 
-    auto rctx = std::make_unique<ResourceContext>(m_resMonitor, graphId, spec, *maybeTicket);
+    return makeResourceContext(std::move(sess), graphId, spec, *maybeTicket);
+}
+
+std::unique_ptr<ResourceContext> TaskExecutor::makeResourceContext(PSessionItem sess, uint64_t graphId,
+                                                                   const DeviceSpec &spec, uint64_t ticket)
+{
+    auto rctx = std::make_unique<ResourceContext>(m_resMonitor, graphId, spec, ticket);
 
 #if defined(SALUS_ENABLE_STATIC_STREAM)
     rctx->sessHandle = sess->sessHandle;
@@ -21,6 +21,7 @@
 #define SALUS_EXEC_TASKEXECUTOR_H
 
 #include "execution/scheduler/schedulingparam.h"
+#include "execution/threadpool/threadpool.h"
 #include "resources/resources.h"
 #include "utils/threadutils.h"
 
@@ -28,9 +29,9 @@
 #include <thread>
 #include <list>
 #include <memory>
+#include <vector>
 
 class ResourceMonitor;
-class ThreadPool;
 struct SessionItem;
 using PSessionItem = std::shared_ptr<SessionItem>;
 struct OperationItem;
@@ -39,10 +40,26 @@ namespace salus {
 
 class ResourceContext;
 class IterationContext;
+/**
+ * @brief Callbacks of a session's owner to move its data between device and host memory.
+ *
+ * They are called on a thread pool worker and may block until the transfer is done.
+ * The session is not removed from the executor while a call is in progress.
+ */
 struct PagingCallbacks
 {
+    /**
+     * @brief Page out data allocated under a ticket to host memory pre-reserved in the context.
+     * @returns bytes released on device
+     */
     std::function<size_t(uint64_t, std::unique_ptr<ResourceContext> &&)> volunteer;
 
+    /**
+     * @brief Page back previously paged out data, into device memory pre-reserved in the context.
+     * @returns bytes moved back to device
+     */
+    std::function<size_t(std::unique_ptr<ResourceContext> &&)> prefetch;
+
     operator bool() const // NOLINT
     {
         return volunteer != nullptr;
@@ -62,8 +79,28 @@ public:
         return m_schedParam;
     }
 
+    ThreadPool &pool() const
+    {
+        return m_pool;
+    }
+
+    ResourceMonitor &resourceMonitor() const
+    {
+        return m_resMonitor;
+    }
+
     void insertSession(PSessionItem sess);
 
+    /**
+     * @brief Asynchronously bring back data of `sess` paged out to host, into memory on device `spec`.
+     *
+     * Only has effect when paging is enabled and the session has paged out data.
+     *
+     * @param done called after the data is back, not called if nothing was started
+     * @returns whether the prefetch was started
+     */
+    bool prefetch(const PSessionItem &sess, const DeviceSpec &spec, std::function<void()> done);
+
     /**
      * @brief Make a resource context that first allocate from session's resources
      * @param spec
@@ -76,12 +113,28 @@ public:
                                                          const DeviceSpec &spec,
                                                          const Resources &res, Resources *missing = nullptr);
 
+    /**
+     * @brief Make a resource context from an already pre-allocated ticket
+     */
+    std::unique_ptr<ResourceContext> makeResourceContext(PSessionItem sess,
+                                                         uint64_t graphId,
+                                                         const DeviceSpec &spec,
+                                                         uint64_t ticket);
+
     // Incoming kernels
     void queueTask(POpItem &&opItem);
 
     // actually run task
     POpItem runTask(POpItem &&opItem);
 
+    /**
+     * @brief Run a batch of tasks, in order.
+     *
+     * Tasks sent to the thread pool are reset in `opItems`, the rest are left as is.
+     * @returns number of tasks sent
+     */
+    size_t runTasks(std::vector<POpItem> &opItems);
+
     void deleteSession(PSessionItem item);
 
 private:
@@ -98,8 +151,19 @@ private:
     sstl::notification m_note_has_work;
 
     void scheduleLoop();
+
+    // Task dispatching, with optional chaining of tasks from the same session
+    ThreadPool::Closure makeRunClosure(POpItem opItem);
+    void runChain(POpItem &&opItem);
+    void startTask(POpItem &&opItem);
+    void continueChain(SessionItem &item);
     bool maybeWaitForAWhile(size_t scheduled);
 
+    /**
+     * @brief Mark `sess` to be examined in the next scheduling pass
+     */
+    void markReady(const PSessionItem &sess);
+
     // Sessions
     std::list<PSessionItem> m_newSessions GUARDED_BY(m_newMu);
     std::mutex m_newMu;
@@ -113,6 +177,17 @@ private:
      */
     std::list<PSessionItem> m_sessions;
 
+    /**
+     * @brief Sessions that may schedule something in the next pass, because
+     * new tasks arrived or not all of them were tried in the last pass.
+     * Each session is added at most once, as guarded by SessionItem::inReadySet.
+     */
+    std::vector<PSessionItem> m_readySessions GUARDED_BY(m_readyMu);
+    std::mutex m_readyMu;
+
+    // Set whenever resources are released, so sessions blocked on them are examined again
+    std::atomic<bool> m_resourcesReleased{false};
+
     // Task life cycle
     void taskStopped(OperationItem &opItem, bool failed);
     void taskRunning(OperationItem &opItem);
@@ -127,6 +202,16 @@ private:
      * @return
      */
     bool doPaging(const DeviceSpec &spec, const DeviceSpec &target);
+
+    /**
+     * @brief Start paging out `victim` of `sess` on the thread pool
+     * @return whether started
+     */
+    bool startPageOut(const PSessionItem &sess, PagingCallbacks pcb, uint64_t victim,
+                      std::unique_ptr<ResourceContext> &&rctx);
+
+    // At most one page out is in progress
+    std::atomic<bool> m_pageOutInFlight{false};
 };
 
 } // namespace salus
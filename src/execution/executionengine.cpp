@@ -17,8 +17,6 @@
  * limitations under the License.
  */
 
-#include "oplibraries/tensorflow/device/gpu/lane/lanemgr.h"
-
 #include "execution/executionengine.h"
 
 #include "execution/engine/iterationcontext.h"
@@ -44,6 +42,7 @@ using std::chrono::microseconds;
 using std::chrono::milliseconds;
 using std::chrono::nanoseconds;
 using std::chrono::seconds;
+using std::chrono::steady_clock;
 using std::chrono::system_clock;
 using FpSeconds = std::chrono::duration<double, seconds::period>;
 using namespace std::chrono_literals;
@@ -51,6 +50,11 @@ using namespace date;
 
 namespace salus {
 
+namespace {
+// how long to wait before trying again to prefetch paged out data that didn't fit on device
+constexpr auto kPrefetchRetry = 100ms;
+} // namespace
+
 ExecutionEngine &ExecutionEngine::instance()
 {
     static ExecutionEngine eng;
@@ -64,21 +68,43 @@ ExecutionEngine::ExecutionEngine()
 
 void ExecutionEngine::startScheduler()
 {
+    m_policyFactory = IterationPolicyRegistary::instance().find(m_schedParam.scheduler);
+    CHECK(m_policyFactory) << "Unknown scheduler selected: " << m_schedParam.scheduler;
+
     m_resMonitor.initializeLimits();
+    m_allocReg.initializeLimits();
     m_taskExecutor.startExecution();
 
-    m_schedThread = std::make_unique<std::thread>(std::bind(&ExecutionEngine::scheduleLoop, this));
+    auto numWorkers = m_schedParam.numSchedWorkers;
+    if (numWorkers == 0) {
+        numWorkers = std::clamp(std::thread::hardware_concurrency() / 8, 1u, 4u);
+    }
+    LOG(INFO) << "ExecutionEngine using " << numWorkers << " scheduling threads";
+
+    m_workers.reserve(numWorkers);
+    for (size_t i = 0; i != numWorkers; ++i) {
+        auto &worker = m_workers.emplace_back(std::make_unique<SchedWorker>());
+        worker->index = i;
+        // lanes are recreated on demand, reserve some for the common case
+        worker->lanes.reserve(15);
+    }
+    // only start threads after m_workers is fully populated, as workers may look up each other
+    for (auto &worker : m_workers) {
+        worker->thread = std::make_unique<std::thread>(&ExecutionEngine::scheduleLoop, this, std::ref(*worker));
+    }
 }
 
 void ExecutionEngine::stopScheduler()
 {
     m_interrupting = true;
 
-    // unblock scheduling thread
-    m_note_has_work.notify();
+    // unblock scheduling threads
+    notifyHasWork();
 
-    if (m_schedThread->joinable()) {
-        m_schedThread->join();
+    for (auto &worker : m_workers) {
+        if (worker->thread && worker->thread->joinable()) {
+            worker->thread->join();
+        }
     }
 
     m_taskExecutor.stopExecution();
@@ -99,80 +125,148 @@ std::shared_ptr<ExecutionContext> ExecutionEngine::makeContext()
     return std::make_shared<ExecutionContext>(*this, ticket);
 }
 
-void ExecutionEngine::scheduleIteration(IterationItem &&item)
+void ExecutionEngine::notifyHasWork()
+{
+    for (auto &worker : m_workers) {
+        worker->noteHasWork.notify();
+    }
+}
+
+void ExecutionEngine::notifyHasWork(uint64_t laneId)
+{
+    if (m_workers.empty()) {
+        return;
+    }
+    workerFor(laneId).noteHasWork.notify();
+}
+
+void ExecutionEngine::scheduleIteration(uint64_t laneId, std::weak_ptr<ExecutionContext> &&wectx,
+                                        std::unique_ptr<IterationTask> &&iter)
 {
     if (m_interrupting) {
-        item.iter->cancel();
+        iter->cancel();
         return;
     }
 
+    auto &worker = workerFor(laneId);
     {
-        auto g = sstl::with_guard(m_mu);
-        m_iterQueue.emplace_back(std::move(item));
+        auto g = sstl::with_guard(worker.mu);
+        IterationItem *item;
+        if (worker.freeItems.empty()) {
+            item = &worker.itemStorage.emplace_back();
+        } else {
+            item = &worker.freeItems.front();
+            worker.freeItems.pop_front();
+        }
+        item->wectx = std::move(wectx);
+        item->iter = std::move(iter);
+        item->queuedAt = steady_clock::now();
+        item->firstPrepareFailed = {};
+        worker.inbox.push_back(*item);
     }
-    m_note_has_work.notify();
+    worker.noteHasWork.notify();
 }
 
-void ExecutionEngine::maybeWaitForWork(size_t pending, size_t scheduled)
+void ExecutionEngine::recycleItem(IterationItem &item, IterQueue &recycled)
 {
-    maybeWaitForAWhile(scheduled);
+    item.wectx.reset();
+    item.iter.reset();
+    recycled.push_back(item);
+}
 
-    if (pending == 0) {
-        VLOG(2) << "ExecutionEngine wait on m_note_has_work";
-        m_note_has_work.wait();
+void ExecutionEngine::dropItem(IterationItem &item, IterQueue &recycled)
+{
+    // only a failed prepare can leave a request waiting. If the context is gone, finishJob took care of it
+    if (item.firstPrepareFailed != steady_clock::time_point{}) {
+        if (auto ectx = item.wectx.lock(); ectx && ectx->m_ticket) {
+            ectx->m_ticket.cancelWaiting();
+        }
     }
+    recycleItem(item, recycled);
 }
 
-void ExecutionEngine::scheduleLoop()
+void ExecutionEngine::scheduleLoop(SchedWorker &worker)
 {
-    LOG(INFO) << "ExecutionEngine scheduling thread started";
-    threading::set_thread_name("ExecutionEngine");
+    LOG(INFO) << "ExecutionEngine scheduling thread " << worker.index << " started";
+    threading::set_thread_name("ExecEngine-" + std::to_string(worker.index));
 
     // a map of lane id to thread local queues.
-    std::unordered_map<uint64_t, LaneQueue> queues;
-    queues.reserve(15);
+    auto &queues = worker.lanes;
 
     // staging queue
     IterQueue staging;
+    // items done with in this pass, given back to the worker in next pass
+    IterQueue recycled;
 
     while (true) {
         DCHECK(staging.empty());
         // accept new iters
         {
-            auto g = sstl::with_guard(m_mu);
-            staging.swap(m_iterQueue);
+            auto g = sstl::with_guard(worker.mu);
+            staging.swap(worker.inbox);
+            worker.freeItems.splice(worker.freeItems.end(), recycled);
         }
 
         // record the timestamp
         auto currStamp = system_clock::now();
 
         // move things to aproriate queue
-        for (auto &iter : staging) {
+        while (!staging.empty()) {
+            auto &iter = staging.front();
+            staging.pop_front();
+
+            // this is the only place the session is resolved before the iteration is tried
             auto ectx = iter.wectx.lock();
-            if (!ectx) {
+            if (!ectx || !ectx->m_item) {
+                recycleItem(iter, recycled);
                 continue;
             }
+            DCHECK_EQ(&workerFor(ectx->laneId()), &worker);
             auto &lane = queues[ectx->laneId()];
-            lane.queue.emplace_back(std::move(iter));
-            lane.lastSeen = currStamp;
-            if (lane.sessions.emplace(ectx->m_item).second) {
+            if (!lane.policy) {
                 lane.id = ectx->laneId();
+                lane.policy = m_policyFactory(lane.id);
+                lane.latency = laneLatency(lane.id);
+            }
+            if (ectx->laneMemory()) {
+                lane.memory = ectx->laneMemory();
+            }
+            lane.lastSeen = currStamp;
+
+            auto &sessItem = ectx->m_item;
+            auto known = std::any_of(lane.sessions.begin(), lane.sessions.end(),
+                                     [raw = sessItem.get()](const auto &ls) { return ls.raw == raw; });
+            if (!known) {
                 // new session to lane and remove old one
+                boost::container::small_vector<PSessionItem, 8> alive;
                 auto it = lane.sessions.begin();
-                auto ed = lane.sessions.end();
-                while (it != ed) {
-                    if (auto s = it->lock()) {
-                        s->numFinishedIters = 0;
+                while (it != lane.sessions.end()) {
+                    if (auto s = it->weak.lock()) {
+                        alive.emplace_back(std::move(s));
                         ++it;
                     } else {
                         it = lane.sessions.erase(it);
                     }
                 }
-                // put session to the back of fifo
-                lane.fifoQueue.emplace_back(ectx->m_item);
+                lane.sessions.push_back({sessItem, sessItem.get(), ectx->persistentMemory()});
+                alive.emplace_back(sessItem);
+                lane.policy->notifySessionJoined(sessItem, alive);
+
+                // the session may have been on the lane before it was released
+                auto g = sstl::with_guard(lane.latency->mu);
+                auto &latencySessions = lane.latency->sessions;
+                sstl::erase_if(latencySessions, [](const auto &weak) { return weak.expired(); });
+                if (std::none_of(latencySessions.begin(), latencySessions.end(),
+                                 [&sessItem](const auto &weak) { return weak.lock() == sessItem; })) {
+                    latencySessions.emplace_back(sessItem);
+                }
+            }
+            if (iter.iter->isExpensive()) {
+                lane.policy->push(iter, *sessItem);
+            } else {
+                lane.queue.push_back(iter);
             }
         }
-        staging.clear();
 
         // break if interrupting, after accepting every thing
         if (m_interrupting) {
@@ -183,230 +277,205 @@ void ExecutionEngine::scheduleLoop()
         // it doesn't matter if later that lane has iter comes, just recreate it.
 
         size_t scheduled = 0;
-        size_t pending = 0;
 
         constexpr const auto MaxInactiveTime = 10s;
         for (auto it = queues.begin(); it != queues.end();) {
             auto &lctx = it->second;
-            if (lctx.queue.empty()
+            if (lctx.queue.empty() && lctx.policy->empty()
                 && currStamp - lctx.lastSeen > MaxInactiveTime
                 && lctx.numExpensiveIterRunning.load(std::memory_order_acquire) == 0) {
                 it = queues.erase(it);
             } else {
-                scheduled += scheduleOnQueue(lctx, staging);
-                staging.clear();
-                pending += lctx.queue.size();
+                scheduled += scheduleOnQueue(lctx, recycled);
                 ++it;
             }
         }
 
-        maybeWaitForWork(pending, scheduled);
+        // If anything was started, the state changed and another pass may start more.
+        // Otherwise every event that could unblock a pending iteration notifies us,
+        // and the notification is sticky, so events during this pass are not lost.
+        if (scheduled == 0) {
+            // some policy may hold back iterations until a certain time
+            std::optional<steady_clock::time_point> wakeup;
+            for (auto &[laneId, lctx] : queues) {
+                UNUSED(laneId);
+                if (auto t = lctx.policy->wakeupAt(); t && (!wakeup || *t < *wakeup)) {
+                    wakeup = t;
+                }
+                if (auto t = std::exchange(lctx.prefetchRetry, std::nullopt); t && (!wakeup || *t < *wakeup)) {
+                    wakeup = t;
+                }
+            }
+            VLOG(2) << "ExecutionEngine thread " << worker.index << " wait on noteHasWork";
+            if (wakeup) {
+                worker.noteHasWork.wait_until(*wakeup);
+            } else {
+                worker.noteHasWork.wait();
+            }
+        }
     }
 
     // Cleanup
     {
         // make sure no more new iters are pending
-        auto g = sstl::with_guard(m_mu);
-        staging.splice(staging.end(), m_iterQueue);
+        auto g = sstl::with_guard(worker.mu);
+        staging.swap(worker.inbox);
+        worker.freeItems.splice(worker.freeItems.end(), recycled);
     }
 
     for (const auto &iterItem : staging) {
         iterItem.iter->cancel();
     }
-    LOG(INFO) << "ExecutionEngine stopped";
+    staging.clear();
+    LOG(INFO) << "ExecutionEngine scheduling thread " << worker.index << " stopped";
 }
 
-int ExecutionEngine::scheduleOnQueue(LaneQueue &lctx, IterQueue &staging)
+int ExecutionEngine::scheduleOnQueue(LaneQueue &lctx, IterQueue &recycled)
 {
-    lctx.queue.swap(staging);
-    CHECK(lctx.queue.empty());
-
     int scheduled = 0;
 
     // First let go every mainIter=false
-    for (auto &iterItem : staging) {
-        if (iterItem.iter->isCanceled()) {
-            continue;
-        }
-        auto ectx = iterItem.wectx.lock();
-        if (!ectx) {
-            continue;
-        }
-
-        if (!iterItem.iter->isExpensive()) {
-            if (runIter(iterItem, *ectx, lctx)) {
+    auto it = lctx.queue.begin();
+    while (it != lctx.queue.end()) {
+        auto &iterItem = *it;
+        if (!iterItem.iter->isCanceled()) {
+            if (auto ectx = iterItem.wectx.lock()) {
+                if (!runIter(iterItem, *ectx, lctx)) {
+                    ++it;
+                    continue;
+                }
                 scheduled += 1;
+                it = lctx.queue.erase(it);
+                recycleItem(iterItem, recycled);
                 continue;
             }
         }
-        // put back all mainIter=true
-        lctx.queue.emplace_back(std::move(iterItem));
+        it = lctx.queue.erase(it);
+        dropItem(iterItem, recycled);
     }
-    staging.clear();
-
-    // For all main iters
-    lctx.queue.swap(staging);
 
-    auto rrSorter = [](const auto &iterItemA, const auto &iterItemB) {
-        std::shared_ptr<ExecutionContext> ectxA = iterItemA.wectx.lock();
-        std::shared_ptr<ExecutionContext> ectxB = iterItemB.wectx.lock();
-        if (!ectxB) {
-            return true; // A goes first
-        }
-        if (!ectxA) {
-            return false; // B goes first
+    // Then main iters in the order decided by the policy.
+    struct LaneRunner : IterationPolicy::Runner
+    {
+        using Visit = IterationPolicy::Visit;
+
+        ExecutionEngine &engine;
+        LaneQueue &lctx;
+        IterQueue &recycled;
+        // If work conservation is disabled we will only schedule one iter
+        bool done = false;
+
+        LaneRunner(ExecutionEngine &engine, LaneQueue &lctx, IterQueue &recycled)
+            : engine(engine)
+            , lctx(lctx)
+            , recycled(recycled)
+        {
         }
 
-        return ectxA->m_item->numFinishedIters < ectxB->m_item->numFinishedIters;
-    };
+        Visit tryRun(IterationItem &iterItem) override
+        {
+            if (iterItem.iter->isCanceled()) {
+                dropItem(iterItem, recycled);
+                return Visit::Dropped;
+            }
 
-    auto fairSorter = [](const auto &iterItemA, const auto &iterItemB) {
-        std::shared_ptr<ExecutionContext> ectxA = iterItemA.wectx.lock();
-        std::shared_ptr<ExecutionContext> ectxB = iterItemB.wectx.lock();
-        if (!ectxB) {
-            return true; // A goes first
-        }
-        if (!ectxA) {
-            return false; // B goes first
-        }
+            if (done || !engine.mayAdmitMore(lctx)) {
+                return Visit::Stop;
+            }
 
-        // fairness (equalize time)
-        auto reA = ectxA->m_item->usedRunningTime.load();
-        auto reB = ectxB->m_item->usedRunningTime.load();
-        return reA < reB;
-    };
-
-    if (m_schedParam.scheduler == "fair") {
-        staging.sort(fairSorter);
-    } else if (m_schedParam.scheduler == "rr") {
-        staging.sort(rrSorter);
-    } else if (m_schedParam.scheduler == "pack") {
-        // do nothing
-    } else if (m_schedParam.scheduler == "fifo") {
-        PSessionItem sessItem = nullptr;
-        auto it = lctx.fifoQueue.begin();
-        auto ed = lctx.fifoQueue.end();
-        while (it != ed && !(sessItem = it->lock())) {
-            it = lctx.fifoQueue.erase(it);
-        }
-        if (sessItem) {
-            if (lctx.lastSessionItem != sessItem.get()) {
-                lctx.lastSessionItem = sessItem.get();
-                LOG(INFO) << "event: fifo_select_sess "
-                          << nlohmann::json({
-                                                {"sess", sessItem->sessHandle},
-                                                {"laneId", lctx.id},
-                                            });
+            auto ectx = iterItem.wectx.lock();
+            if (!ectx) {
+                dropItem(iterItem, recycled);
+                return Visit::Dropped;
             }
-            for (auto &iterItem : staging) {
-                if (iterItem.iter->isCanceled()) {
-                    continue;
-                }
-                auto ectx = iterItem.wectx.lock();
-                if (!ectx) {
-                    continue;
-                }
-                if (ectx->m_item != sessItem) {
-                    lctx.queue.emplace_back(std::move(iterItem));
-                    continue;
-                }
 
-                if (runIter(iterItem, *ectx, lctx)) {
-                    scheduled += 1;
-                } else {
-                    lctx.queue.emplace_back(std::move(iterItem));
-                }
+            if (!engine.runIter(iterItem, *ectx, lctx)) {
+                return Visit::Skipped;
             }
-        }
-        staging.clear();
-    } else {
-        CHECK_EQ(m_schedParam.scheduler, "preempt") << "Unknown scheduler selected: " << m_schedParam.scheduler;
-        // find the sessItem with least remaining time
-        int64_t minRemainingTime = std::numeric_limits<int64_t>::max();
-        PSessionItem sessItem = nullptr;
-        for (auto &ws : lctx.sessions) {
-            if (auto s = ws.lock()) {
-                auto remain = static_cast<int64_t>(s->totalRunningTime) - static_cast<int64_t>(s->usedRunningTime);
-                if (remain <= minRemainingTime) {
-                    minRemainingTime = remain;
-                    sessItem = std::move(s);
-                }
+            if (!engine.m_schedParam.workConservative) {
+                done = true;
             }
+            recycleItem(iterItem, recycled);
+            return Visit::Started;
         }
-        if (sessItem) {
-            if (lctx.lastSessionItem != sessItem.get()) {
-                lctx.lastSessionItem = sessItem.get();
-                LOG(INFO) << "event: preempt_select_sess "
-                          << nlohmann::json({
-                                                {"sess", sessItem->sessHandle},
-                                                {"totalRunningTime", sessItem->totalRunningTime},
-                                                {"usedRunningTime", sessItem->usedRunningTime.load()},
-                                                {"laneId", lctx.id},
-                                            });
-            }
-            for (auto &iterItem : staging) {
-                if (iterItem.iter->isCanceled()) {
-                    continue;
-                }
-                auto ectx = iterItem.wectx.lock();
-                if (!ectx) {
-                    continue;
-                }
-                if (ectx->m_item != sessItem) {
-                    lctx.queue.emplace_back(std::move(iterItem));
-                    continue;
-                }
 
-                if (runIter(iterItem, *ectx, lctx)) {
-                    scheduled += 1;
-                } else {
-                    lctx.queue.emplace_back(std::move(iterItem));
-                }
-            }
+        void drop(IterationItem &iterItem) override
+        {
+            dropItem(iterItem, recycled);
         }
-        staging.clear();
+    } runner(*this, lctx, recycled);
+
+    scheduled += lctx.policy->schedule(runner);
+
+    return scheduled;
+}
+
+bool ExecutionEngine::mayAdmitMore(const LaneQueue &lctx) const
+{
+    auto running = lctx.numExpensiveIterRunning.load(std::memory_order_acquire);
+    if (running == 0) {
+        return true;
     }
+    return running < static_cast<int64_t>(m_schedParam.maxConcurrentIters)
+        && lctx.numExclusiveIterRunning.load(std::memory_order_acquire) == 0;
+}
 
-    // If work conservation is disabled we will only schedule one iter
-    bool done = false;
-    for (auto &iterItem : staging) {
-        if (iterItem.iter->isCanceled()) {
-            continue;
-        }
+bool ExecutionEngine::checkIter(IterationItem &iterItem, ExecutionContext &ectx, LaneQueue &lctx, size_t &reserved,
+                                bool &exclusive)
+{
+    reserved = 0;
+    exclusive = false;
+    if (!iterItem.iter->isExpensive()) {
+        return true;
+    }
 
-        auto ectx = iterItem.wectx.lock();
-        if (!ectx) {
-            continue;
-        }
+    // NOTE: only the scheduling thread owning the lane starts iterations on it, others only
+    // decrease the counters when iterations finish, so checking and then adding is safe.
+    auto predicted = m_schedParam.maxConcurrentIters > 1 && lctx.memory > 0
+                         ? ectx.m_item->predictedTemporary(iterItem.iter->graphId())
+                         : std::nullopt;
 
-        if (!m_schedParam.workConservative && done) {
-            lctx.queue.emplace_back(std::move(iterItem));
-            continue;
+    auto running = lctx.numExpensiveIterRunning.load(std::memory_order_acquire);
+    if (running == 0) {
+        // the first one can always start, and runs alone unless we know how much it uses
+        exclusive = !predicted;
+    } else {
+        if (!mayAdmitMore(lctx) || !predicted) {
+            return false;
         }
 
-        if (runIter(iterItem, *ectx, lctx)) {
-            scheduled += 1;
-            if (!m_schedParam.workConservative) {
-                done = true;
+        // the lane holds persistent memory of every session on it, plus temporary memory
+        // of running iterations
+        size_t persistent = 0;
+        for (auto &ls : lctx.sessions) {
+            if (!ls.weak.expired()) {
+                persistent += ls.persistent;
             }
-        } else {
-            lctx.queue.emplace_back(std::move(iterItem));
         }
-    } // for (auto &iterItem : staging)
-    staging.clear();
+        auto available = lctx.memory > persistent ? lctx.memory - persistent : 0;
+        if (lctx.runningTemporary.load(std::memory_order_acquire) + *predicted > available) {
+            return false;
+        }
+    }
 
-    return scheduled;
+    if (!exclusive) {
+        reserved = *predicted;
+        lctx.runningTemporary += reserved;
+    } else {
+        lctx.numExclusiveIterRunning++;
+    }
+    lctx.numExpensiveIterRunning++;
+    return true;
 }
 
-bool ExecutionEngine::checkIter(IterationItem &iterItem, ExecutionContext &, LaneQueue &lctx)
+void ExecutionEngine::releaseIter(LaneQueue &lctx, size_t reserved, bool exclusive)
 {
-    if (!iterItem.iter->isExpensive()) {
-        return true;
+    if (exclusive) {
+        lctx.numExclusiveIterRunning--;
+    } else {
+        lctx.runningTemporary -= reserved;
     }
-
-    // only allow one expensive iteration to run
-    int64_t zero = 0;
-    return lctx.numExpensiveIterRunning.compare_exchange_weak(zero, 1);
+    lctx.numExpensiveIterRunning--;
 }
 
 bool ExecutionEngine::runIter(IterationItem &iterItem, ExecutionContext &ectx, LaneQueue &lctx)
@@ -414,7 +483,24 @@ bool ExecutionEngine::runIter(IterationItem &iterItem, ExecutionContext &ectx, L
     DCHECK(ectx.m_item);
 
     VLOG(2) << "Try iteration " << ectx.m_item->sessHandle << ":" << iterItem.iter->graphId();
-    if (!checkIter(iterItem, ectx, lctx)) {
+
+    // bring back anything paged out before the next iteration
+    if (ectx.m_item->pagedOut.load() > 0) {
+        if (!m_taskExecutor.prefetch(ectx.m_item, devices::GPU0,
+                                     [this, laneId = lctx.id]() { notifyHasWork(laneId); })) {
+            // no room on device yet, or already in progress
+            lctx.prefetchRetry = steady_clock::now() + kPrefetchRetry;
+        }
+        VLOG(2) << "event: skip_iter "
+                << nlohmann::json({{"sess", ectx.m_item->sessHandle},
+                                   {"graphId", iterItem.iter->graphId()},
+                                   {"reason", "paged out"}});
+        return false;
+    }
+
+    size_t reserved;
+    bool exclusive;
+    if (!checkIter(iterItem, ectx, lctx, reserved, exclusive)) {
         VLOG(2) << "event: skip_iter "
                 << nlohmann::json({{"sess", ectx.m_item->sessHandle},
                                    {"graphId", iterItem.iter->graphId()},
@@ -422,23 +508,50 @@ bool ExecutionEngine::runIter(IterationItem &iterItem, ExecutionContext &ectx, L
         return false;
     }
 
+    bool expensive = iterItem.iter->isExpensive();
+
     // FUTURE: support other devices
+    auto prepareStart = steady_clock::now();
     if (!iterItem.iter->prepare()) {
         VLOG(2) << "event: skip_iter "
                 << nlohmann::json({{"sess", ectx.m_item->sessHandle},
                                    {"graphId", iterItem.iter->graphId()},
                                    {"reason", "failed prepare"}});
+        // give back the admission, or the lane would be blocked forever
+        if (expensive) {
+            releaseIter(lctx, reserved, exclusive);
+        }
+        if (iterItem.firstPrepareFailed == steady_clock::time_point{}) {
+            iterItem.firstPrepareFailed = prepareStart;
+        }
         return false;
     }
 
-    bool expensive = iterItem.iter->isExpensive();
+    if (expensive) {
+        recordIterStart(iterItem, *ectx.m_item, lctx, prepareStart);
+        logIterStart(iterItem, ectx, lctx);
+        if (!exclusive && lctx.numExpensiveIterRunning.load() > 1) {
+            VLOG(2) << "event: iter_concurrent "
+                    << nlohmann::json({{"sess", ectx.m_item->sessHandle},
+                                       {"graphId", iterItem.iter->graphId()},
+                                       {"laneId", lctx.id},
+                                       {"reserved", reserved},
+                                       {"running", lctx.numExpensiveIterRunning.load()}});
+        }
+    }
 
     auto iCtx = std::make_shared<IterationContext>(m_taskExecutor, ectx.m_item,
-                                                   [&lctx, expensive, start = system_clock::now()](auto &sessItem) {
+                                                   [this, &lctx, laneId = lctx.id, expensive, reserved, exclusive,
+                                                    graphId = iterItem.iter->graphId(), queuedAt = iterItem.queuedAt,
+                                                    start = steady_clock::now()](auto &sessItem) {
                                                        if (expensive) {
-                                                           auto usedTime =
-                                                               duration_cast<milliseconds>(system_clock::now() - start).count();
+                                                           auto iterTime = steady_clock::now() - start;
+                                                           auto usedTime = duration_cast<milliseconds>(iterTime).count();
+                                                           auto iterTimeUs = duration_cast<microseconds>(iterTime).count();
                                                            sessItem.usedRunningTime += usedTime;
+                                                           updateAvgIterTime(sessItem, iterTimeUs);
+                                                           sessItem.iterLatency.running.record(iterTimeUs);
+                                                           lctx.latency->latency.running.record(iterTimeUs);
                                                            ++sessItem.numFinishedIters;
                                                            if (VLOG_IS_ON(1)) {
                                                                LogOpTracing() << "event: sess_add_time " << nlohmann::json({
@@ -447,45 +560,128 @@ bool ExecutionEngine::runIter(IterationItem &iterItem, ExecutionContext &ectx, L
                                                                    {"totalRunningTime", sessItem.totalRunningTime},
                                                                });
                                                            }
+                                                           recordIterDeadline(sessItem, graphId, laneId, queuedAt);
                                                            // NOTE: lctx must be alive when any iters on it finishes.
-                                                           lctx.numExpensiveIterRunning--;
+                                                           lctx.lastExpensiveIterFinished = steady_clock::now().time_since_epoch().count();
+                                                           releaseIter(lctx, reserved, exclusive);
+                                                           // the next iteration on this lane may start now.
+                                                           // lctx may be removed once released, don't touch it.
+                                                           notifyHasWork(laneId);
                                                        }
                                                    });
     iterItem.iter->runAsync(std::move(iCtx));
     return true;
 }
 
-bool ExecutionEngine::maybeWaitForAWhile(size_t scheduled)
+void ExecutionEngine::logIterStart(const IterationItem &iterItem, const ExecutionContext &ectx,
+                                   const LaneQueue &lctx) const
+{
+    auto now = steady_clock::now();
+    // the iteration can't start before the previous expensive one on the same lane finishes,
+    // so the scheduling gap is measured from whichever happens later.
+    auto runnable = std::max(iterItem.queuedAt,
+                             steady_clock::time_point{steady_clock::duration{lctx.lastExpensiveIterFinished.load()}});
+    CLOG(INFO, logging::kPerfTag) << "event: iter_start "
+                                  << nlohmann::json({
+                                         {"sess", ectx.m_item->sessHandle},
+                                         {"graphId", iterItem.iter->graphId()},
+                                         {"laneId", lctx.id},
+                                         {"queued_us", duration_cast<microseconds>(now - iterItem.queuedAt).count()},
+                                         {"gap_us", duration_cast<microseconds>(now - runnable).count()},
+                                     });
+}
+
+void ExecutionEngine::recordIterStart(const IterationItem &iterItem, SessionItem &sessItem, LaneQueue &lctx,
+                                      steady_clock::time_point prepareStart)
 {
-    static constexpr auto initialSleep = 10ms;
-    static constexpr auto getBored = 1s;
+    auto now = steady_clock::now();
+    auto queued = duration_cast<microseconds>(now - iterItem.queuedAt).count();
+    auto prepare = duration_cast<microseconds>(now - prepareStart).count();
+
+    for (auto latency : {&sessItem.iterLatency, &lctx.latency->latency}) {
+        latency->queued.record(queued);
+        latency->prepare.record(prepare);
+        if (iterItem.firstPrepareFailed != steady_clock::time_point{}) {
+            latency->blocked.record(duration_cast<microseconds>(prepareStart - iterItem.firstPrepareFailed).count());
+        }
+    }
+}
 
-    static auto last = system_clock::now();
-    static auto sleep = initialSleep;
+std::shared_ptr<ExecutionEngine::LaneLatency> ExecutionEngine::laneLatency(uint64_t laneId)
+{
+    auto g = sstl::with_guard(m_latencyMu);
+    auto &latency = m_laneLatency[laneId];
+    if (!latency) {
+        latency = std::make_shared<LaneLatency>();
+    }
+    return latency;
+}
 
-    auto now = system_clock::now();
+nlohmann::json ExecutionEngine::iterLatencySnapshot()
+{
+    std::vector<std::pair<uint64_t, std::shared_ptr<LaneLatency>>> lanes;
+    {
+        auto g = sstl::with_guard(m_latencyMu);
+        lanes.assign(m_laneLatency.begin(), m_laneLatency.end());
+    }
 
-    if (scheduled > 0) {
-        last = now;
-        sleep = initialSleep;
+    auto res = nlohmann::json::array();
+    for (auto &[laneId, lane] : lanes) {
+        auto sessions = nlohmann::json::array();
+        {
+            auto g = sstl::with_guard(lane->mu);
+            sstl::erase_if(lane->sessions, [](const auto &weak) { return weak.expired(); });
+            for (auto &weak : lane->sessions) {
+                if (auto sess = weak.lock()) {
+                    sessions.push_back({{"sess", sess->sessHandle}, {"latency", sess->iterLatency.summary()}});
+                }
+            }
+        }
+        res.push_back({{"laneId", laneId}, {"latency", lane->latency.summary()}, {"sessions", std::move(sessions)}});
     }
+    return res;
+}
 
-    auto idle = now - last;
-    if (idle <= getBored) {
-        return false;
+void ExecutionEngine::logIterLatency()
+{
+    CLOG(INFO, logging::kPerfTag) << "event: iter_latency " << iterLatencySnapshot();
+}
+
+void ExecutionEngine::updateAvgIterTime(SessionItem &sessItem, uint64_t iterTime)
+{
+    // exponential moving average with weight 1/5 for the new sample
+    auto prev = sessItem.avgIterTime.load();
+    sessItem.avgIterTime = prev == 0 ? iterTime : (prev * 4 + iterTime) / 5;
+}
+
+void ExecutionEngine::recordIterDeadline(SessionItem &sessItem, uint64_t graphId, uint64_t laneId,
+                                         steady_clock::time_point queuedAt) const
+{
+    if (!sessItem.iterDeadline) {
+        return;
     }
 
-    if (sleep > 1s) {
-        LOG(WARNING) << "No progress for " << duration_cast<milliseconds>(idle).count() << "ms, sleep for "
-                     << duration_cast<milliseconds>(sleep).count() << "ms";
+    auto latency = steady_clock::now() - queuedAt;
+    auto lateness = duration_cast<microseconds>(latency - milliseconds{sessItem.iterDeadline}).count();
+    if (lateness <= 0) {
+        ++sessItem.numDeadlineMet;
+        return;
     }
 
-    // no progress for a long time.
-    // give out our time slice to avoid using too much cycles
-    //             std::this_thread::yield();
-    std::this_thread::sleep_for(sleep);
+    ++sessItem.numDeadlineMissed;
+    auto late = static_cast<uint64_t>(lateness);
+    auto prev = sessItem.maxLateness.load();
+    while (prev < late && !sessItem.maxLateness.compare_exchange_weak(prev, late)) {
+    }
 
-    return true;
+    CLOG(INFO, logging::kPerfTag) << "event: iter_deadline_miss "
+                                  << nlohmann::json({
+                                         {"sess", sessItem.sessHandle},
+                                         {"graphId", graphId},
+                                         {"laneId", laneId},
+                                         {"deadline_ms", sessItem.iterDeadline},
+                                         {"lateness_us", lateness},
+                                     });
 }
 
 ExecutionContext::ExecutionContext(ExecutionEngine &engine, AllocationRegulator::Ticket ticket)
@@ -493,6 +689,16 @@ ExecutionContext::ExecutionContext(ExecutionEngine &engine, AllocationRegulator:
     , m_ticket(ticket)
     , m_item(std::make_shared<SessionItem>(""))
 {
+    setLaneId(m_laneId);
+}
+
+void ExecutionContext::setLaneId(uint64_t id)
+{
+    m_laneId = id;
+    // iterations delayed by the regulator start once their hold is granted
+    if (m_ticket) {
+        m_ticket.setWaker([&engine = m_engine, id]() { engine.notifyHasWork(id); });
+    }
 }
 
 void ExecutionContext::registerPagingCallbacks(PagingCallbacks &&pcb)
@@ -531,6 +737,8 @@ void ExecutionContext::removeFromEngine()
         m_ticket.finishJob();
         m_ticket = 0;
     }
+    // policies waiting on this session can move on
+    m_engine.notifyHasWork(m_laneId);
 }
 
 void ExecutionContext::setSessionHandle(const std::string &h)
@@ -545,14 +753,19 @@ void ExecutionContext::setSessionHandle(const std::string &h)
 
 void ExecutionContext::scheduleIteartion(std::unique_ptr<IterationTask> &&iterTask)
 {
-    m_engine.scheduleIteration({shared_from_this(), std::move(iterTask)});
+    m_engine.scheduleIteration(m_laneId, weak_from_this(), std::move(iterTask));
 }
 
 void ExecutionContext::dropExlusiveMode()
 {
     DCHECK(m_item);
     m_item->setExclusiveMode(false);
-    m_engine.m_note_has_work.notify();
+    m_engine.notifyHasWork(m_laneId);
+}
+
+void ExecutionContext::notifyIterationCanceled()
+{
+    m_engine.notifyHasWork(m_laneId);
 }
 
 void ExecutionContext::setExpectedRunningTime(uint64_t time)
@@ -560,4 +773,10 @@ void ExecutionContext::setExpectedRunningTime(uint64_t time)
     DCHECK(m_item);
     m_item->totalRunningTime = time;
 }
+
+void ExecutionContext::setIterationDeadline(uint64_t ms)
+{
+    DCHECK(m_item);
+    m_item->iterDeadline = ms;
+}
 } // namespace salus
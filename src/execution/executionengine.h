@@ -22,6 +22,8 @@
 
 #include "execution/devices.h"
 #include "execution/engine/taskexecutor.h"
+#include "execution/scheduler/iterlatency.h"
+#include "execution/scheduler/iterationpolicy.h"
 #include "execution/scheduler/schedulingparam.h"
 #include "execution/threadpool/threadpool.h"
 #include "platform/logging.h"
@@ -32,16 +34,17 @@
 
 #include <concurrentqueue.h>
 
-#include <boost/circular_buffer.hpp>
+#include <boost/container/small_vector.hpp>
+#include <boost/intrusive/list.hpp>
 
 #include <atomic>
 #include <any>
 #include <chrono>
+#include <deque>
 #include <future>
-#include <list>
 #include <memory>
 #include <unordered_map>
-#include <set>
+#include <vector>
 
 namespace salus {
 class IterationTask;
@@ -75,6 +78,17 @@ public:
 
     std::shared_ptr<ExecutionContext> makeContext();
 
+    /**
+     * @brief Summary of iteration latency histograms of every lane and sessions on it.
+     * Doesn't block scheduling.
+     */
+    nlohmann::json iterLatencySnapshot();
+
+    /**
+     * @brief Log iterLatencySnapshot to the performance log
+     */
+    void logIterLatency();
+
 private:
     friend class ExecutionContext;
 
@@ -92,18 +106,25 @@ private:
     salus::TaskExecutor m_taskExecutor;
 
     // Iteration scheduling
-    std::mutex m_mu;
+    // Non-owning, items are owned by SchedWorker::itemStorage
+    using IterQueue = boost::intrusive::list<IterationItem>;
+
+    // resolved from m_schedParam.scheduler in startScheduler
+    IterationPolicyRegistary::PolicyFactory m_policyFactory;
 
-    struct IterationItem
+    struct LaneLatency
     {
-        std::weak_ptr<ExecutionContext> wectx;
-        std::unique_ptr<IterationTask> iter;
-    };
+        IterLatency latency;
 
+        std::mutex mu;
+        // sessions ever joined the lane, for snapshots
+        std::vector<std::weak_ptr<SessionItem>> sessions GUARDED_BY(mu);
+    };
+    // kept after lanes are released, so stats survive lane recreation
+    std::mutex m_latencyMu;
+    std::unordered_map<uint64_t, std::shared_ptr<LaneLatency>> m_laneLatency GUARDED_BY(m_latencyMu);
 
-    using IterQueue = std::list<IterationItem>;
-    using BlockingQueues =
-        boost::circular_buffer<std::pair<PSessionItem, boost::circular_buffer<IterationItem>>>;
+    std::shared_ptr<LaneLatency> laneLatency(uint64_t laneId);
 
     struct LaneQueue
     {
@@ -111,24 +132,119 @@ private:
         IterQueue queue;
         std::chrono::system_clock::time_point lastSeen;
         std::atomic_int_fast64_t numExpensiveIterRunning {0};
-        std::set<std::weak_ptr<SessionItem>, std::owner_less<std::weak_ptr<SessionItem>>> sessions;
-        SessionItem *lastSessionItem = nullptr;
-        std::list<std::weak_ptr<SessionItem>> fifoQueue;
+        // running expensive iterations that must run alone, because there was no prediction
+        // of their memory usage or concurrency is disabled
+        std::atomic_int_fast64_t numExclusiveIterRunning {0};
+        // sum of predicted temporary memory of the other running expensive iterations
+        std::atomic<size_t> runningTemporary {0};
+        // total memory of the lane, 0 if unknown
+        size_t memory = 0;
+        // steady_clock timestamp of when the last expensive iteration finished, used for perf logging
+        std::atomic<std::chrono::steady_clock::rep> lastExpensiveIterFinished {0};
+        struct LaneSession
+        {
+            std::weak_ptr<SessionItem> weak;
+            // NOTE: session items are created by make_shared, so the address is not reused
+            // while we hold the weak_ptr, and can be compared without touching the control block.
+            SessionItem *raw;
+            // memory persistently used by the session on this lane
+            size_t persistent;
+        };
+        boost::container::small_vector<LaneSession, 8> sessions;
+        // orders expensive iterations, other iterations are kept in queue
+        std::unique_ptr<IterationPolicy> policy;
+
+        std::shared_ptr<LaneLatency> latency;
+
+        // when to try again iterations of sessions whose paged out data couldn't be prefetched yet
+        std::optional<std::chrono::steady_clock::time_point> prefetchRetry;
     };
 
-    IterQueue m_iterQueue GUARDED_BY(m_mu);
-    void scheduleIteration(IterationItem &&item);
+    /**
+     * @brief A scheduling thread that owns a disjoint set of lanes.
+     * Lanes are assigned to workers by lane id, so a busy lane only delays
+     * other lanes on the same worker.
+     */
+    struct SchedWorker
+    {
+        size_t index;
+
+        std::mutex mu;
+        // Every iteration item ever used by this worker, recycled through freeItems
+        // so the steady state doesn't allocate. Declared before the queues linking into it.
+        std::deque<IterationItem> itemStorage GUARDED_BY(mu);
+        IterQueue freeItems GUARDED_BY(mu);
+        // new iterations for lanes owned by this worker
+        IterQueue inbox GUARDED_BY(mu);
+
+        sstl::notification noteHasWork;
+        std::unique_ptr<std::thread> thread;
+
+        // only accessed from the worker thread
+        std::unordered_map<uint64_t, LaneQueue> lanes;
+    };
+
+    // created in startScheduler, and not modified afterwards
+    std::vector<std::unique_ptr<SchedWorker>> m_workers;
+
+    SchedWorker &workerFor(uint64_t laneId)
+    {
+        DCHECK(!m_workers.empty());
+        return *m_workers[laneId % m_workers.size()];
+    }
+
+    void scheduleIteration(uint64_t laneId, std::weak_ptr<ExecutionContext> &&wectx,
+                           std::unique_ptr<IterationTask> &&iter);
 
-    std::unique_ptr<std::thread> m_schedThread;
     std::atomic<bool> m_interrupting{false};
-    sstl::notification m_note_has_work;
 
-    void scheduleLoop();
-    int scheduleOnQueue(LaneQueue &lctx, IterQueue &staging);
-    bool checkIter(IterationItem &iterItem, ExecutionContext &ectx, LaneQueue &lctx);
+    void scheduleLoop(SchedWorker &worker);
+    int scheduleOnQueue(LaneQueue &lctx, IterQueue &recycled);
+    /**
+     * @brief Release what `item` holds, and put it to `recycled`, which is returned to
+     * the worker's free list in the next pass.
+     */
+    static void recycleItem(IterationItem &item, IterQueue &recycled);
+    /**
+     * @brief Recycle `item` that is dropped without running, withdrawing the allocation
+     * request it may have left waiting in the regulator.
+     */
+    static void dropItem(IterationItem &item, IterQueue &recycled);
+    /**
+     * @brief Admission of expensive iterations on the lane
+     * @param reserved set to the predicted temporary memory reserved for the iteration
+     * @param exclusive set to whether the iteration runs alone on the lane
+     * @returns whether the iteration may start. If true, releaseIter must be called once it finishes.
+     */
+    bool checkIter(IterationItem &iterItem, ExecutionContext &ectx, LaneQueue &lctx, size_t &reserved, bool &exclusive);
+    static void releaseIter(LaneQueue &lctx, size_t reserved, bool exclusive);
+    /**
+     * @brief Whether the lane may admit another expensive iteration, without looking at the iteration.
+     */
+    bool mayAdmitMore(const LaneQueue &lctx) const;
     bool runIter(IterationItem &iterItem, ExecutionContext &ectx, LaneQueue &lctx);
-    bool maybeWaitForAWhile(size_t scheduled);
-    void maybeWaitForWork(size_t pending, size_t scheduled);
+    void logIterStart(const IterationItem &iterItem, const ExecutionContext &ectx, const LaneQueue &lctx) const;
+
+    static void recordIterStart(const IterationItem &iterItem, SessionItem &sessItem, LaneQueue &lctx,
+                                std::chrono::steady_clock::time_point prepareStart);
+    static void updateAvgIterTime(SessionItem &sessItem, uint64_t iterTime);
+    /**
+     * @brief Update deadline statistics of `sessItem` for a finished iteration queued at `queuedAt`
+     */
+    void recordIterDeadline(SessionItem &sessItem, uint64_t graphId, uint64_t laneId,
+                            std::chrono::steady_clock::time_point queuedAt) const;
+
+    /**
+     * @brief Wake up all scheduling workers. Called whenever something happens that may
+     * allow pending iterations on any lane to start.
+     */
+    void notifyHasWork();
+
+    /**
+     * @brief Wake up the scheduling worker owning lane `laneId`. Called on new iterations,
+     * iteration completion, cancellation, session removal and granted allocation holds on that lane.
+     */
+    void notifyHasWork(uint64_t laneId);
 };
 
 /**
@@ -138,7 +254,9 @@ class ExecutionContext : public std::enable_shared_from_this<ExecutionContext>
 {
     ExecutionEngine &m_engine;
     std::any m_userData;
-    uint64_t m_laneId;
+    uint64_t m_laneId = 0;
+    size_t m_laneMemory = 0;
+    size_t m_persistentMemory = 0;
 
     friend class ExecutionEngine;
     /**
@@ -176,18 +294,47 @@ public:
 
     void dropExlusiveMode();
 
+    /**
+     * @brief Notify the engine that a pending iteration of this context was canceled,
+     * so it can be removed from the queue right away.
+     */
+    void notifyIterationCanceled();
+
     uint64_t laneId() const
     {
         return m_laneId;
     }
 
-    void setLaneId(uint64_t id)
+    void setLaneId(uint64_t id);
+
+    /**
+     * @brief Set the total memory of the lane, and the part persistently used by this session.
+     * Used to decide whether iterations from sessions sharing the lane can run together.
+     */
+    void setLaneMemory(size_t total, size_t persistent)
+    {
+        m_laneMemory = total;
+        m_persistentMemory = persistent;
+    }
+
+    size_t laneMemory() const
     {
-        m_laneId = id;
+        return m_laneMemory;
+    }
+
+    size_t persistentMemory() const
+    {
+        return m_persistentMemory;
     }
 
     void setExpectedRunningTime(uint64_t time);
 
+    /**
+     * @brief Set the relative deadline of each iteration in milliseconds, counted from
+     * when the iteration is queued. 0 means no deadline.
+     */
+    void setIterationDeadline(uint64_t ms);
+
     /**
      * @brief Make a resource context that first allocate from session's resources
      * @param spec
@@ -24,12 +24,17 @@
 #include "execution/engine/resourcecontext.h"
 #include "execution/operationtask.h"
 #include "execution/scheduler/operationitem.h"
+#include "execution/threadpool/threadpool.h"
 #include "platform/logging.h"
 #include "utils/debugging.h"
 #include "utils/envutils.h"
 #include "utils/macros.h"
 #include "utils/threadutils.h"
 
+#include <algorithm>
+#include <future>
+#include <vector>
+
 using std::chrono::duration_cast;
 using FpMS = std::chrono::duration<double, std::chrono::milliseconds::period>;
 using namespace std::chrono_literals;
@@ -85,14 +90,17 @@ BaseScheduler::BaseScheduler(TaskExecutor &engine)
 
 BaseScheduler::~BaseScheduler() = default;
 
-void BaseScheduler::notifyPreSchedulingIteration(const SessionList &sessions,
+void BaseScheduler::notifyPreSchedulingIteration(const CandidateList &sessions,
                                                  const SessionChangeSet &changeset,
                                                  sstl::not_null<CandidateList *> candidates)
 {
     UNUSED(sessions);
-    UNUSED(changeset);
     UNUSED(candidates);
 
+    for (const auto &sess : changeset.deletedSessions) {
+        releaseShadow(*sess, true);
+    }
+
     auto g = sstl::with_guard(m_muRes);
     m_missingRes.clear();
 }
@@ -120,7 +128,6 @@ bool BaseScheduler::maybePreAllocateFor(OperationItem &opItem, const DeviceSpec
         return false;
     }
 
-    auto g = sstl::with_guard(item->tickets_mu);
     item->tickets.insert(ticket);
     return true;
 }
@@ -197,71 +204,316 @@ POpItem BaseScheduler::submitTask(POpItem &&opItem)
     return opItem;
 }
 
+namespace {
+/**
+ * @brief Minimum batch size to split per task work across the thread pool.
+ * Smaller batches are cheaper to handle inline. 0 disables splitting.
+ */
+size_t parallelAdmissionThreshold()
+{
+    static auto threshold = sstl::fromEnvVar("SALUS_SCHED_PARALLEL_ADMISSION", size_t{64});
+    return threshold;
+}
+
+/**
+ * @brief Call fn(i) for i in [0, n), in chunks on the thread pool if n is large enough
+ */
+template<typename Fn>
+void forEachInBatch(ThreadPool &pool, size_t n, Fn &&fn)
+{
+    const auto threshold = parallelAdmissionThreshold();
+    const auto numChunks = std::min(pool.numThreads(), n / std::max<size_t>(threshold, 1));
+    if (threshold == 0 || numChunks < 2) {
+        for (size_t i = 0; i != n; ++i) {
+            fn(i);
+        }
+        return;
+    }
+
+    const auto chunkSize = (n + numChunks - 1) / numChunks;
+    std::vector<std::future<void>> futures;
+    futures.reserve(numChunks);
+    // the last chunk is handled on this thread
+    for (size_t begin = 0; begin + chunkSize < n; begin += chunkSize) {
+        futures.emplace_back(pool.post([&fn, begin, end = begin + chunkSize]() {
+            for (auto i = begin; i != end; ++i) {
+                fn(i);
+            }
+        }));
+    }
+    for (auto i = futures.size() * chunkSize; i != n; ++i) {
+        fn(i);
+    }
+    for (auto &fu : futures) {
+        fu.get();
+    }
+}
+
+struct AdmissionSlot
+{
+    POpItem opItem;
+    boost::container::small_vector<DeviceSpec, 2> specs;
+    size_t nextSpec = 0;
+    Resources usage;
+    uint64_t ticket = 0;
+};
+} // namespace
+
+void BaseScheduler::submitBatch(const PSessionItem &item, SessionItem::UnsafeQueue &stage,
+                                SessionItem::UnsafeQueue &queue)
+{
+    auto &pool = m_taskExec.pool();
+    auto &resMonitor = m_taskExec.resourceMonitor();
+
+    std::vector<AdmissionSlot> slots;
+    slots.reserve(stage.size());
+    for (auto &opItem : stage) {
+        DCHECK(opItem);
+        auto &slot = slots.emplace_back();
+        slot.opItem = std::move(opItem);
+        LogOpTracing() << "OpItem Event " << slot.opItem->op << " event: inspected";
+        for (auto dt : slot.opItem->op->supportedDeviceTypes()) {
+            if (dt == DeviceType::GPU && !useGPU()) {
+                continue;
+            }
+            slot.specs.push_back(DeviceSpec{dt, 0});
+        }
+    }
+    stage.clear();
+
+    // Stage 1: estimate usages on the first device of each task
+    forEachInBatch(pool, slots.size(), [&slots](size_t i) {
+        auto &slot = slots[i];
+        if (!slot.specs.empty()) {
+            slot.usage = slot.opItem->op->estimatedUsage(slot.specs[0]);
+        }
+    });
+
+    // Stage 2: reserve resources. Each round reserves for all remaining tasks on their next device
+    // in one pass over the resource monitor. Tasks failed in a round move to their next device.
+    std::vector<size_t> pending;
+    pending.reserve(slots.size());
+    for (size_t i = 0; i != slots.size(); ++i) {
+        if (!slots[i].specs.empty()) {
+            pending.push_back(i);
+        }
+    }
+    std::vector<ResourceMonitor::PreAllocRequest> reqs;
+    while (!pending.empty()) {
+        reqs.clear();
+        for (auto i : pending) {
+            reqs.push_back({&slots[i].usage, std::nullopt, {}});
+        }
+        resMonitor.preAllocateBatch(reqs);
+
+        size_t stillPending = 0;
+        for (size_t j = 0; j != pending.size(); ++j) {
+            auto &slot = slots[pending[j]];
+            if (reqs[j].ticket) {
+                slot.ticket = *reqs[j].ticket;
+                VLOG(3) << "Task scheduled on " << slot.specs[slot.nextSpec];
+                continue;
+            }
+            {
+                auto g = sstl::with_guard(m_muRes);
+                m_missingRes.emplace(slot.opItem.get(), std::move(reqs[j].missing));
+            }
+            if (++slot.nextSpec < slot.specs.size()) {
+                slot.usage = slot.opItem->op->estimatedUsage(slot.specs[slot.nextSpec]);
+                pending[stillPending++] = pending[j];
+            }
+        }
+        pending.resize(stillPending);
+    }
+
+    // Stage 3: prepare admitted tasks
+    std::vector<uint8_t> prepared(slots.size(), 0);
+    forEachInBatch(pool, slots.size(), [&slots, &prepared, &item, this](size_t i) {
+        auto &slot = slots[i];
+        if (!slot.ticket) {
+            return;
+        }
+        auto rctx = m_taskExec.makeResourceContext(item, slot.opItem->op->graphId(),
+                                                   slot.specs[slot.nextSpec], slot.ticket);
+        prepared[i] = slot.opItem->op->prepare(std::move(rctx));
+        LogOpTracing() << "OpItem Event " << slot.opItem->op << " event: prealloced";
+    });
+
+    // Stage 4: dispatch prepared tasks together
+    std::vector<POpItem> batch;
+    batch.reserve(slots.size());
+    for (size_t i = 0; i != slots.size(); ++i) {
+        if (prepared[i]) {
+            item->tickets.insert(slots[i].ticket);
+            batch.emplace_back(slots[i].opItem);
+        }
+    }
+    m_taskExec.runTasks(batch);
+
+    // Put back anything not sent, keeping the original order
+    size_t j = 0;
+    for (size_t i = 0; i != slots.size(); ++i) {
+        auto &slot = slots[i];
+        if (prepared[i] && !batch[j++]) {
+            continue;
+        }
+        VLOG(2) << "Failed to schedule opItem in session " << item->sessHandle << ": "
+                << slot.opItem->op->DebugString();
+        queue.emplace_back(std::move(slot.opItem));
+    }
+}
+
+bool BaseScheduler::maybeStartShadow(const PSessionItem &item)
+{
+    auto &head = item->bgQueue.front();
+    // disabled, or this head already had its reservation
+    if (m_taskExec.schedulingParam().maxShadowHold == 0 || item->shadowHead == head) {
+        return false;
+    }
+
+    if (auto owner = m_shadowOwner.lock(); owner && owner != item) {
+        return false;
+    }
+
+    {
+        auto g = sstl::with_guard(m_muRes);
+        if (m_missingRes.count(head.get()) == 0) {
+            // not blocked on resources
+            return false;
+        }
+    }
+
+    std::optional<DeviceSpec> spec;
+    for (auto dt : head->op->supportedDeviceTypes()) {
+        if (dt == DeviceType::GPU && !useGPU()) {
+            continue;
+        }
+        spec = DeviceSpec{dt, 0};
+        break;
+    }
+    if (!spec) {
+        return false;
+    }
+
+    item->shadowHead = head;
+    item->shadowSpec = *spec;
+    item->shadowUsage = head->op->estimatedUsage(*spec);
+    item->shadowSince = std::chrono::steady_clock::now();
+    m_shadowOwner = item;
+
+    VLOG(2) << "In session " << item->sessHandle << ": start shadow reservation on " << *spec
+            << " for queue head " << head->op;
+    return topUpShadow(item);
+}
+
+bool BaseScheduler::topUpShadow(const PSessionItem &item)
+{
+    auto maxHold = std::chrono::milliseconds(m_taskExec.schedulingParam().maxShadowHold);
+    if (std::chrono::steady_clock::now() - item->shadowSince > maxHold) {
+        // Sessions holding what the head waits for may need more to finish, give them a chance
+        VLOG(2) << "In session " << item->sessHandle << ": shadow reservation held for more than "
+                << maxHold.count() << "ms, releasing";
+        releaseShadow(*item, false);
+        return false;
+    }
+
+    Resources missing;
+    if (m_taskExec.resourceMonitor().reserveUpTo(item->shadowTicket, item->shadowUsage, &missing)) {
+        return true;
+    }
+
+    auto g = sstl::with_guard(m_muRes);
+    m_missingRes.emplace(item->shadowHead.get(), std::move(missing));
+    return false;
+}
+
+bool BaseScheduler::admitShadowHead(const PSessionItem &item)
+{
+    auto opItem = item->shadowHead;
+    auto ticket = item->shadowTicket;
+    // the resource context owns the ticket from now on
+    item->shadowTicket = 0;
+    releaseShadow(*item, true);
+
+    auto rctx = m_taskExec.makeResourceContext(item, opItem->op->graphId(), item->shadowSpec, ticket);
+    if (!opItem->op->prepare(std::move(rctx))) {
+        return false;
+    }
+    LogOpTracing() << "OpItem Event " << opItem->op << " event: prealloced";
+
+    item->tickets.insert(ticket);
+    opItem = m_taskExec.runTask(std::move(opItem));
+    return !opItem;
+}
+
+void BaseScheduler::releaseShadow(SessionItem &item, bool forget)
+{
+    if (item.shadowTicket) {
+        m_taskExec.resourceMonitor().freeStaging(item.shadowTicket);
+        m_taskExec.resourceMonitor().releaseTicket(item.shadowTicket);
+        item.shadowTicket = 0;
+    }
+    if (forget) {
+        item.shadowHead.reset();
+    }
+    if (auto owner = m_shadowOwner.lock(); !owner || owner.get() == &item) {
+        m_shadowOwner.reset();
+    }
+}
+
 size_t BaseScheduler::submitAllTaskFromQueue(const PSessionItem &item)
 {
     auto &queue = item->bgQueue;
     size_t scheduled = 0;
 
+    // the shadowed head may be gone, e.g. cancelled on interruption
+    if (item->shadowHead && (queue.empty() || queue.front() != item->shadowHead)) {
+        releaseShadow(*item, true);
+    }
+
     if (queue.empty()) {
         return scheduled;
     }
 
-    // Exam if queue front has been waiting for a long time
-    if (item->holWaiting > m_taskExec.schedulingParam().maxHolWaiting) {
-        VLOG(2) << "In session " << item->sessHandle << ": HOL waiting exceeds maximum: " << item->holWaiting
-                << " (max=" << m_taskExec.schedulingParam().maxHolWaiting << ")";
-        // Only try to schedule head in this case
-        auto &head = queue.front();
-        head = submitTask(std::move(head));
-        if (!head) {
+    // A shadowed head goes first once its reservation is complete
+    if (item->shadowTicket && topUpShadow(item)) {
+        VLOG(2) << "In session " << item->sessHandle << ": shadow reservation complete, admitting queue head";
+        if (admitShadowHead(item)) {
             queue.pop_front();
             scheduled += 1;
         }
-    } else {
-        auto size = queue.size();
-        SessionItem::UnsafeQueue stage;
-        stage.swap(queue);
-
-#if defined(SALUS_ENABLE_PARALLEL_SCHED)
-        // Do all schedule in queue in parallel
-        std::vector<std::future<std::shared_ptr<OperationItem>>> futures;
-        futures.reserve(stage.size());
-        for (auto &opItem : stage) {
-            auto fu = m_taskExec.pool().post([opItem = std::move(opItem), this]() mutable {
-                DCHECK(opItem);
-                return submitTask(std::move(opItem));
-            });
-            futures.emplace_back(std::move(fu));
-        }
-
-        for (auto &fu : futures) {
-            auto poi = fu.get();
-            if (poi) {
-                queue.emplace_back(std::move(poi));
-            }
-        }
-#else
-        for (auto &opItem : stage) {
-            auto poi = submitTask(std::move(opItem));
-            if (poi) {
-                queue.emplace_back(std::move(poi));
-            }
-        }
-#endif
-        VLOG(2) << "All opItem in session " << item->sessHandle << " examined";
-
-        scheduled = size - queue.size();
     }
 
-    // update queue head waiting
     if (queue.empty()) {
-        item->queueHeadHash = 0;
-        item->holWaiting = 0;
-    } else if (queue.front()->hash() == item->queueHeadHash) {
-        item->holWaiting += scheduled;
+        return scheduled;
+    }
+
+    // Backfill tasks behind a shadowed head, or try the whole queue otherwise
+    const bool shadowed = item->shadowTicket != 0;
+    SessionItem::UnsafeQueue stage;
+    stage.swap(queue);
+    POpItem head;
+    if (shadowed) {
+        queue.emplace_back(std::move(stage.front()));
+        stage.pop_front();
     } else {
-        item->queueHeadHash = queue.front()->hash();
-        item->holWaiting = 0;
+        head = stage.front();
+    }
+
+    if (!stage.empty()) {
+        auto size = stage.size();
+        auto kept = queue.size();
+        submitBatch(item, stage, queue);
+        scheduled += size - (queue.size() - kept);
+    }
+    VLOG(2) << "All opItem in session " << item->sessHandle << " examined";
+
+    // The head failed to get resources, reserve for it from now on
+    if (!shadowed && !queue.empty() && queue.front() == head && maybeStartShadow(item)) {
+        if (admitShadowHead(item)) {
+            queue.pop_front();
+            scheduled += 1;
+        }
     }
 
     return scheduled;
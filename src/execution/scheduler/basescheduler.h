@@ -50,8 +50,8 @@ class TaskExecutor;
  * @brief Scheduler interface used in the execution engine.
  *
  * The life time of a scheduler within the scheduling loop:
- * 1. selectCandidateSessions - beginning of a new scheduling iteration,
- *                              get notified about any session addition and removal
+ * 1. notifyPreSchedulingIteration - beginning of a new scheduling iteration,
+ *                                   get notified about ready sessions, and any session addition and removal
  * 2. maybeScheduleFrom - called for each candidate session
  */
 class BaseScheduler
@@ -67,7 +67,15 @@ public:
     virtual std::string name() const = 0;
 
     using CandidateList = boost::container::small_vector_base<PSessionItem>;
-    virtual void notifyPreSchedulingIteration(const SessionList &sessions,
+    /**
+     * @brief Select and order candidates for this scheduling iteration.
+     *
+     * @param sessions sessions whose queue or resources changed since they were last looked at.
+     *                 Sessions not in it have nothing new to schedule.
+     * @param changeset session additions and removals
+     * @param candidates output, sessions to try in order
+     */
+    virtual void notifyPreSchedulingIteration(const CandidateList &sessions,
                                               const SessionChangeSet &changeset,
                                               sstl::not_null<CandidateList *> candidates);
     /**
@@ -123,6 +131,10 @@ protected:
     /**
      * @brief a convenient helper function to submit all tasks in queue from session, with HOL blocking handled.
      *
+     * A queue head blocked on resources gets a shadow reservation, which collects resources as they are
+     * freed until the head fits. Tasks behind it are backfilled using only resources not needed by the
+     * head, so they never delay it. See SchedulingParam::maxShadowHold.
+     *
      * The queue is modified to contain any tasks left. Ordering is not changed.
      *
      * @param item The session to schedule from
@@ -130,6 +142,46 @@ protected:
      */
     size_t submitAllTaskFromQueue(const PSessionItem &item);
 
+    /**
+     * @brief Admit tasks as a batch.
+     *
+     * Usages are estimated, resources for all tasks are reserved in one pass over the resource monitor,
+     * and admitted tasks are prepared and sent to the thread pool together. Per task work is split
+     * across the thread pool for large batches, see `SALUS_SCHED_PARALLEL_ADMISSION`.
+     *
+     * @param item The session tasks belong to
+     * @param stage Tasks to admit, emptied on return
+     * @param queue Tasks not admitted are appended to it. Ordering is not changed.
+     */
+    void submitBatch(const PSessionItem &item, SessionItem::UnsafeQueue &stage, SessionItem::UnsafeQueue &queue);
+
+    /**
+     * @brief Start a shadow reservation for the queue head of `item`, which just failed to get resources.
+     * At most one session holds a shadow reservation at a time, so they never wait on each other.
+     * @returns whether the reservation already covers the head
+     */
+    bool maybeStartShadow(const PSessionItem &item);
+
+    /**
+     * @brief Grow the shadow reservation of `item`, releasing it if held for too long
+     * @returns whether the reservation covers the head
+     */
+    bool topUpShadow(const PSessionItem &item);
+
+    /**
+     * @brief Admit the queue head of `item` using its complete shadow reservation
+     * @returns whether the head was sent for execution
+     */
+    bool admitShadowHead(const PSessionItem &item);
+
+    /**
+     * @brief Release the shadow reservation of `item`, if any
+     * @param forget also forget the shadowed head, so it may be shadowed again
+     */
+    void releaseShadow(SessionItem &item, bool forget);
+
+    // Session currently holding a shadow reservation. Only accessed by the scheduling thread.
+    std::weak_ptr<SessionItem> m_shadowOwner;
 
     /**
      * @brief Missing resources per operation in this iteration.
@@ -0,0 +1,48 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "edfpolicy.h"
+
+#include <chrono>
+#include <limits>
+
+using std::chrono::duration_cast;
+using std::chrono::milliseconds;
+using std::chrono::nanoseconds;
+using namespace salus;
+
+namespace {
+IterationPolicyRegistary::Register edf("edf", [](auto laneId) {
+    return std::make_unique<EDFPolicy>(laneId);
+});
+} // namespace
+
+std::string_view EDFPolicy::name() const
+{
+    return "edf";
+}
+
+HeapIterationPolicy::Key EDFPolicy::keyOf(const IterationItem &item, SessionItem &sess) const
+{
+    if (sess.iterDeadline == 0) {
+        return std::numeric_limits<Key>::max();
+    }
+    auto deadline = item.queuedAt + milliseconds{sess.iterDeadline};
+    return duration_cast<nanoseconds>(deadline.time_since_epoch()).count();
+}
@@ -0,0 +1,46 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SALUS_EXEC_SCHED_EDFPOLICY_H
+#define SALUS_EXEC_SCHED_EDFPOLICY_H
+
+#include "execution/scheduler/impl/iterationpolicies.h"
+
+namespace salus {
+
+/**
+ * @brief Earliest deadline first.
+ *
+ * The deadline of an iteration is the time it is queued plus the session's iteration deadline.
+ * Iterations from sessions without a deadline go after all others, in arrival order.
+ */
+class EDFPolicy : public HeapIterationPolicy
+{
+public:
+    using HeapIterationPolicy::HeapIterationPolicy;
+
+    std::string_view name() const override;
+
+protected:
+    Key keyOf(const IterationItem &item, SessionItem &sess) const override;
+};
+
+} // namespace salus
+
+#endif // SALUS_EXEC_SCHED_EDFPOLICY_H
@@ -44,6 +44,13 @@ namespace {
 SchedulerRegistary::Register reg("fair", [](auto &engine) {
     return std::make_unique<FairScheduler>(engine);
 });
+// iteration-only policies, operations are still shared fairly
+SchedulerRegistary::Register reg2("edf", [](auto &engine) {
+    return std::make_unique<FairScheduler>(engine);
+});
+SchedulerRegistary::Register reg3("timeslice", [](auto &engine) {
+    return std::make_unique<FairScheduler>(engine);
+});
 
 } // namespace
 
@@ -56,12 +63,10 @@ std::string FairScheduler::name() const
     return "fair";
 }
 
-void FairScheduler::notifyPreSchedulingIteration(const SessionList &sessions,
+void FairScheduler::notifyPreSchedulingIteration(const CandidateList &sessions,
                                                  const SessionChangeSet &changeset,
                                                  sstl::not_null<CandidateList *> candidates)
 {
-    static auto lastSnapshotTime = system_clock::now();
-
     BaseScheduler::notifyPreSchedulingIteration(sessions, changeset, candidates);
 
     candidates->clear();
@@ -71,38 +76,38 @@ void FairScheduler::notifyPreSchedulingIteration(const SessionList &sessions,
         aggResUsages.erase(sess->sessHandle);
     }
 
-    // Sort sessions if needed. When there is addition, counters are reset thus no need to sort.
-    // Snapshot resource usage counter first, or reset them
-    if (changeset.numAddedSessions == 0) {
-        auto now = system_clock::now();
-        auto sSinceLastSnapshot = FpSeconds(now - lastSnapshotTime).count();
-        lastSnapshotTime = now;
-        for (auto &sess : sessions) {
-            candidates->emplace_back(sess);
-            // calculate progress counter increase since last snapshot
-            size_t mem = sess->resourceUsage(resources::GPU0Memory);
-            aggResUsages[sess->sessHandle] += mem * sSinceLastSnapshot;
-        }
+    auto now = system_clock::now();
 
-        // We assume m_sessions.size() is always no more than a few,
-        // therefore sorting in every iteration is acceptable.
-        using std::sort;
-        sort(candidates->begin(), candidates->end(), [this](const auto &lhs, const auto &rhs) {
-            return aggResUsages.at(lhs->sessHandle) < aggResUsages.at(rhs->sessHandle);
-        });
-    } else {
+    // When there is addition, counters of all sessions are reset.
+    if (changeset.numAddedSessions != 0) {
         for (auto it = changeset.addedSessionBegin; it != changeset.addedSessionEnd; ++it) {
             LOG(DEBUG) << "Adding session " << (*it)->sessHandle;
         }
-        // clear to reset everything to zero.
-        aggResUsages.clear();
-        aggResUsages.reserve(sessions.size());
-        for (auto &sess : sessions) {
-            candidates->emplace_back(sess);
-            // touch each item once to ensure it's in the map
-            aggResUsages[sess->sessHandle] = 0;
+        for (auto &[handle, usage] : aggResUsages) {
+            UNUSED(handle);
+            usage = {0, now};
+        }
+    }
+
+    // Only sessions that are ready are brought up to date. The counter of a session only matters
+    // relative to other candidates, so catching up lazily when it shows up is enough.
+    for (auto &sess : sessions) {
+        candidates->emplace_back(sess);
+        auto [it, inserted] = aggResUsages.try_emplace(sess->sessHandle, AggUsage{0, now});
+        if (!inserted) {
+            // calculate progress counter increase since last update
+            size_t mem = sess->resourceUsage(resources::GPU0Memory);
+            it->second.counter += mem * FpSeconds(now - it->second.lastUpdate).count();
+            it->second.lastUpdate = now;
         }
     }
+
+    // We assume the number of ready sessions is always no more than a few,
+    // therefore sorting in every iteration is acceptable.
+    using std::sort;
+    sort(candidates->begin(), candidates->end(), [this](const auto &lhs, const auto &rhs) {
+        return aggResUsages.at(lhs->sessHandle).counter < aggResUsages.at(rhs->sessHandle).counter;
+    });
 }
 
 std::pair<size_t, bool> FairScheduler::maybeScheduleFrom(PSessionItem item)
@@ -124,6 +129,6 @@ std::pair<size_t, bool> FairScheduler::reportScheduleResult(size_t scheduled) co
 std::string FairScheduler::debugString(const PSessionItem &item) const
 {
     std::ostringstream oss;
-    oss << "counter: " << aggResUsages.at(item->sessHandle);
+    oss << "counter: " << aggResUsages.at(item->sessHandle).counter;
     return oss.str();
 }
@@ -36,7 +36,7 @@ public:
 
     std::string name() const override;
 
-    void notifyPreSchedulingIteration(const SessionList &sessions,
+    void notifyPreSchedulingIteration(const CandidateList &sessions,
                                       const SessionChangeSet &changeset,
                                       sstl::not_null<CandidateList *> candidates) override;
     std::pair<size_t, bool> maybeScheduleFrom(PSessionItem item) override;
@@ -47,7 +47,12 @@ public:
 private:
     std::pair<size_t, bool> reportScheduleResult(size_t scheduled) const;
 
-    std::unordered_map<std::string, double> aggResUsages;
+    struct AggUsage
+    {
+        double counter;
+        std::chrono::system_clock::time_point lastUpdate;
+    };
+    std::unordered_map<std::string, AggUsage> aggResUsages;
 };
 
 #endif // SALUS_EXEC_SCHED_FAIR_H
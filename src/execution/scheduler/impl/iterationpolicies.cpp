@@ -0,0 +1,278 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "iterationpolicies.h"
+
+#include "execution/iterationtask.h"
+#include "platform/logging.h"
+#include "utils/macros.h"
+
+#include <algorithm>
+#include <limits>
+
+using namespace salus;
+
+namespace {
+IterationPolicyRegistary::Register fair("fair", [](auto laneId) {
+    return std::make_unique<FairPolicy>(laneId);
+});
+IterationPolicyRegistary::Register rr("rr", [](auto laneId) {
+    return std::make_unique<RRPolicy>(laneId);
+});
+IterationPolicyRegistary::Register pack("pack", [](auto laneId) {
+    return std::make_unique<PackPolicy>(laneId);
+});
+IterationPolicyRegistary::Register fifo("fifo", [](auto laneId) {
+    return std::make_unique<FifoPolicy>(laneId);
+});
+IterationPolicyRegistary::Register preempt("preempt", [](auto laneId) {
+    return std::make_unique<PreemptPolicy>(laneId);
+});
+} // namespace
+
+HeapIterationPolicy::~HeapIterationPolicy() = default;
+
+void HeapIterationPolicy::push(IterationItem &item, SessionItem &sess)
+{
+    m_heap.push_back({keyOf(item, sess), m_nextSeq++, &item});
+    std::push_heap(m_heap.begin(), m_heap.end(), Later{});
+}
+
+size_t HeapIterationPolicy::schedule(Runner &runner)
+{
+    DCHECK(m_kept.empty());
+
+    size_t started = 0;
+    while (!m_heap.empty()) {
+        std::pop_heap(m_heap.begin(), m_heap.end(), Later{});
+        auto &entry = m_heap.back();
+
+        auto visit = runner.tryRun(*entry.item);
+        switch (visit) {
+        case Visit::Started:
+            ++started;
+            break;
+        case Visit::Dropped:
+            break;
+        case Visit::Skipped:
+        case Visit::Stop:
+            m_kept.emplace_back(entry);
+            break;
+        }
+        m_heap.pop_back();
+
+        if (visit == Visit::Stop) {
+            break;
+        }
+    }
+
+    // put back those not started, their keys are unchanged
+    for (auto &entry : m_kept) {
+        m_heap.emplace_back(entry);
+        std::push_heap(m_heap.begin(), m_heap.end(), Later{});
+    }
+    m_kept.clear();
+
+    return started;
+}
+
+void HeapIterationPolicy::resetKeys(Key key)
+{
+    for (auto &entry : m_heap) {
+        entry.key = key;
+    }
+    std::make_heap(m_heap.begin(), m_heap.end(), Later{});
+}
+
+std::string_view FairPolicy::name() const
+{
+    return "fair";
+}
+
+HeapIterationPolicy::Key FairPolicy::keyOf(const IterationItem &, SessionItem &sess) const
+{
+    // fairness (equalize time)
+    return static_cast<Key>(sess.usedRunningTime.load());
+}
+
+std::string_view RRPolicy::name() const
+{
+    return "rr";
+}
+
+void RRPolicy::notifySessionJoined(const PSessionItem &sess, const SessionList &laneSessions)
+{
+    UNUSED(sess);
+    // start a new round with the new session
+    for (auto &s : laneSessions) {
+        s->numFinishedIters = 0;
+    }
+    resetKeys(0);
+}
+
+HeapIterationPolicy::Key RRPolicy::keyOf(const IterationItem &, SessionItem &sess) const
+{
+    return static_cast<Key>(sess.numFinishedIters.load());
+}
+
+std::string_view PackPolicy::name() const
+{
+    return "pack";
+}
+
+HeapIterationPolicy::Key PackPolicy::keyOf(const IterationItem &, SessionItem &) const
+{
+    return 0;
+}
+
+SelectedSessionPolicy::~SelectedSessionPolicy() = default;
+
+void SelectedSessionPolicy::notifySessionJoined(const PSessionItem &sess, const SessionList &)
+{
+    m_sessions.push_back({sess, sess.get()});
+}
+
+void SelectedSessionPolicy::push(IterationItem &item, SessionItem &sess)
+{
+    m_queue.push_back({&sess, &item});
+}
+
+void SelectedSessionPolicy::pruneSessions(Runner &runner)
+{
+    m_alive.clear();
+    auto it = m_sessions.begin();
+    while (it != m_sessions.end()) {
+        if (auto s = it->weak.lock()) {
+            m_alive.emplace_back(std::move(s));
+            ++it;
+            continue;
+        }
+        auto raw = it->raw;
+        m_queue.erase(std::remove_if(m_queue.begin(), m_queue.end(), [raw, &runner](const auto &entry) {
+                          if (entry.sess != raw) {
+                              return false;
+                          }
+                          runner.drop(*entry.item);
+                          return true;
+                      }),
+                      m_queue.end());
+        if (m_lastSession == raw) {
+            m_lastSession = nullptr;
+        }
+        it = m_sessions.erase(it);
+    }
+}
+
+size_t SelectedSessionPolicy::schedule(Runner &runner)
+{
+    pruneSessions(runner);
+    auto sess = selectSession(m_alive);
+    if (!sess) {
+        m_alive.clear();
+        return 0;
+    }
+
+    size_t started = 0;
+    auto it = m_queue.begin();
+    while (it != m_queue.end()) {
+        if (it->sess != sess) {
+            ++it;
+            continue;
+        }
+
+        auto visit = runner.tryRun(*it->item);
+        if (visit == Visit::Started) {
+            ++started;
+            notifyStarted(sess);
+        }
+        if (visit == Visit::Started || visit == Visit::Dropped) {
+            it = m_queue.erase(it);
+            continue;
+        }
+        if (visit == Visit::Stop) {
+            break;
+        }
+        ++it;
+    }
+
+    // don't keep sessions alive between passes
+    m_alive.clear();
+    return started;
+}
+
+void SelectedSessionPolicy::notifyStarted(SessionItem *)
+{
+}
+
+bool SelectedSessionPolicy::hasPending(const SessionItem *sess) const
+{
+    return std::any_of(m_queue.begin(), m_queue.end(), [sess](const auto &entry) { return entry.sess == sess; });
+}
+
+std::string_view FifoPolicy::name() const
+{
+    return "fifo";
+}
+
+SessionItem *FifoPolicy::selectSession(const std::vector<PSessionItem> &sessions)
+{
+    if (sessions.empty()) {
+        return nullptr;
+    }
+    auto &sessItem = sessions.front();
+    if (m_lastSession != sessItem.get()) {
+        m_lastSession = sessItem.get();
+        LOG(INFO) << "event: fifo_select_sess "
+                  << nlohmann::json({
+                                        {"sess", sessItem->sessHandle},
+                                        {"laneId", m_laneId},
+                                    });
+    }
+    return sessItem.get();
+}
+
+std::string_view PreemptPolicy::name() const
+{
+    return "preempt";
+}
+
+SessionItem *PreemptPolicy::selectSession(const std::vector<PSessionItem> &sessions)
+{
+    // find the sessItem with least remaining time
+    int64_t minRemainingTime = std::numeric_limits<int64_t>::max();
+    SessionItem *sessItem = nullptr;
+    for (auto &s : sessions) {
+        auto remain = static_cast<int64_t>(s->totalRunningTime) - static_cast<int64_t>(s->usedRunningTime);
+        if (remain <= minRemainingTime) {
+            minRemainingTime = remain;
+            sessItem = s.get();
+        }
+    }
+    if (sessItem && m_lastSession != sessItem) {
+        m_lastSession = sessItem;
+        LOG(INFO) << "event: preempt_select_sess "
+                  << nlohmann::json({
+                                        {"sess", sessItem->sessHandle},
+                                        {"totalRunningTime", sessItem->totalRunningTime},
+                                        {"usedRunningTime", sessItem->usedRunningTime.load()},
+                                        {"laneId", m_laneId},
+                                    });
+    }
+    return sessItem;
+}
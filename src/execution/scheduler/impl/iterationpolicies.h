@@ -0,0 +1,221 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SALUS_EXEC_SCHED_ITERATIONPOLICIES_H
+#define SALUS_EXEC_SCHED_ITERATIONPOLICIES_H
+
+#include "execution/scheduler/iterationpolicy.h"
+
+#include <vector>
+
+namespace salus {
+
+/**
+ * @brief Base class for policies that start iterations in the order of a per session key.
+ *
+ * The key is computed once when the iteration is pushed and kept in a binary heap,
+ * so picking the next iteration is O(log n). Ties are broken by arrival order.
+ */
+class HeapIterationPolicy : public IterationPolicy
+{
+public:
+    using IterationPolicy::IterationPolicy;
+    ~HeapIterationPolicy() override;
+
+    void push(IterationItem &item, SessionItem &sess) override;
+    size_t schedule(Runner &runner) override;
+
+    size_t size() const override
+    {
+        return m_heap.size();
+    }
+
+protected:
+    using Key = int64_t;
+
+    /**
+     * @brief Ordering key of `item` from `sess`. Smaller keys start first.
+     */
+    virtual Key keyOf(const IterationItem &item, SessionItem &sess) const = 0;
+
+    /**
+     * @brief Set the key of every queued iteration to `key`, and restore the heap
+     */
+    void resetKeys(Key key);
+
+private:
+    struct Entry
+    {
+        Key key;
+        uint64_t seq;
+        IterationItem *item;
+    };
+
+    struct Later
+    {
+        bool operator()(const Entry &a, const Entry &b) const
+        {
+            return a.key != b.key ? a.key > b.key : a.seq > b.seq;
+        }
+    };
+
+    std::vector<Entry> m_heap;
+    // iterations visited but not started in a pass, kept as member to reuse the storage
+    std::vector<Entry> m_kept;
+    uint64_t m_nextSeq = 0;
+};
+
+/**
+ * @brief Equalize the running time used by each session
+ */
+class FairPolicy : public HeapIterationPolicy
+{
+public:
+    using HeapIterationPolicy::HeapIterationPolicy;
+
+    std::string_view name() const override;
+
+protected:
+    Key keyOf(const IterationItem &item, SessionItem &sess) const override;
+};
+
+/**
+ * @brief Round robin by the number of iterations finished since the last session joined
+ */
+class RRPolicy : public HeapIterationPolicy
+{
+public:
+    using HeapIterationPolicy::HeapIterationPolicy;
+
+    std::string_view name() const override;
+
+    void notifySessionJoined(const PSessionItem &sess, const SessionList &laneSessions) override;
+
+protected:
+    Key keyOf(const IterationItem &item, SessionItem &sess) const override;
+};
+
+/**
+ * @brief Start iterations in arrival order
+ */
+class PackPolicy : public HeapIterationPolicy
+{
+public:
+    using HeapIterationPolicy::HeapIterationPolicy;
+
+    std::string_view name() const override;
+
+protected:
+    Key keyOf(const IterationItem &item, SessionItem &sess) const override;
+};
+
+/**
+ * @brief Base class for policies that select one session in each pass,
+ * and only start iterations from that session.
+ */
+class SelectedSessionPolicy : public IterationPolicy
+{
+public:
+    using IterationPolicy::IterationPolicy;
+    ~SelectedSessionPolicy() override;
+
+    void notifySessionJoined(const PSessionItem &sess, const SessionList &laneSessions) override;
+    void push(IterationItem &item, SessionItem &sess) override;
+    size_t schedule(Runner &runner) override;
+
+    size_t size() const override
+    {
+        return m_queue.size();
+    }
+
+protected:
+    /**
+     * @brief Select the session to run from `sessions`, which are all alive, in join order.
+     */
+    virtual SessionItem *selectSession(const std::vector<PSessionItem> &sessions) = 0;
+
+    /**
+     * @brief Called after an iteration from `sess` is started
+     */
+    virtual void notifyStarted(SessionItem *sess);
+
+    /**
+     * @brief Whether there is any queued iteration from `sess`
+     */
+    bool hasPending(const SessionItem *sess) const;
+
+    SessionItem *m_lastSession = nullptr;
+
+private:
+    /**
+     * @brief Drop expired sessions and their iterations, and lock the rest into m_alive
+     */
+    void pruneSessions(Runner &runner);
+
+    struct Entry
+    {
+        // only used for identity
+        SessionItem *sess;
+        IterationItem *item;
+    };
+
+    struct SessionRef
+    {
+        std::weak_ptr<SessionItem> weak;
+        // NOTE: session items are created by make_shared, so the address is not reused
+        // while we hold the weak_ptr, and can be used to find its iterations after it expires.
+        SessionItem *raw;
+    };
+
+    std::vector<SessionRef> m_sessions;
+    std::vector<PSessionItem> m_alive;
+    std::vector<Entry> m_queue;
+};
+
+/**
+ * @brief Only run the session that joined the lane first
+ */
+class FifoPolicy : public SelectedSessionPolicy
+{
+public:
+    using SelectedSessionPolicy::SelectedSessionPolicy;
+
+    std::string_view name() const override;
+
+protected:
+    SessionItem *selectSession(const std::vector<PSessionItem> &sessions) override;
+};
+
+/**
+ * @brief Only run the session with least remaining running time
+ */
+class PreemptPolicy : public SelectedSessionPolicy
+{
+public:
+    using SelectedSessionPolicy::SelectedSessionPolicy;
+
+    std::string_view name() const override;
+
+protected:
+    SessionItem *selectSession(const std::vector<PSessionItem> &sessions) override;
+};
+
+} // namespace salus
+
+#endif // SALUS_EXEC_SCHED_ITERATIONPOLICIES_H
@@ -54,7 +54,7 @@ std::string PackScheduler::name() const
     return "pack";
 }
 
-void PackScheduler::notifyPreSchedulingIteration(const SessionList &sessions,
+void PackScheduler::notifyPreSchedulingIteration(const CandidateList &sessions,
                                                  const SessionChangeSet &changeset,
                                                  sstl::not_null<CandidateList *> candidates)
 {
@@ -35,7 +35,7 @@ public:
 
     std::string name() const override;
 
-    void notifyPreSchedulingIteration(const SessionList &sessions, const SessionChangeSet &changeset,
+    void notifyPreSchedulingIteration(const CandidateList &sessions, const SessionChangeSet &changeset,
                                       sstl::not_null<CandidateList *> candidates) override;
     std::pair<size_t, bool> maybeScheduleFrom(PSessionItem item) override;
 
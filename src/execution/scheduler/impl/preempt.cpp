@@ -61,7 +61,7 @@ std::string PreemptScheduler::name() const
     return "preempt";
 }
 
-void PreemptScheduler::notifyPreSchedulingIteration(const SessionList &sessions,
+void PreemptScheduler::notifyPreSchedulingIteration(const CandidateList &sessions,
                                                     const SessionChangeSet &changeset,
                                                     sstl::not_null<CandidateList *> candidates)
 {
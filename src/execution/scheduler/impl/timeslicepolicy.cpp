@@ -0,0 +1,200 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "timeslicepolicy.h"
+
+#include "platform/logging.h"
+#include "utils/envutils.h"
+
+#include <algorithm>
+
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+using namespace salus;
+
+namespace {
+IterationPolicyRegistary::Register timeslice("timeslice", [](auto laneId) {
+    return std::make_unique<TimeSlicePolicy>(laneId);
+});
+} // namespace
+
+TimeSlicePolicy::TimeSlicePolicy(uint64_t laneId)
+    : SelectedSessionPolicy(laneId)
+    , m_quantumMs(sstl::fromEnvVar("SALUS_TIMESLICE_MS", uint64_t{100}))
+    , m_quantumIters(sstl::fromEnvVar("SALUS_TIMESLICE_ITERS", uint64_t{0}))
+    , m_grace(sstl::fromEnvVar("SALUS_TIMESLICE_GRACE_US", int64_t{2000}))
+{
+    VLOG(2) << "TimeSlicePolicy on lane " << laneId << ": quantumMs=" << m_quantumMs
+            << ", quantumIters=" << m_quantumIters << ", graceUs=" << m_grace.count();
+}
+
+TimeSlicePolicy::~TimeSlicePolicy()
+{
+    if (m_numSwitches) {
+        CLOG(INFO, logging::kPerfTag) << "event: timeslice_stats "
+                                      << nlohmann::json({
+                                             {"laneId", m_laneId},
+                                             {"switches", m_numSwitches},
+                                             {"avg_switch_us", m_totalSwitchCost / m_numSwitches},
+                                         });
+    }
+}
+
+std::string_view TimeSlicePolicy::name() const
+{
+    return "timeslice";
+}
+
+std::optional<std::chrono::steady_clock::time_point> TimeSlicePolicy::wakeupAt() const
+{
+    return m_wakeup;
+}
+
+size_t TimeSlicePolicy::quotaFor(const SessionItem &sess) const
+{
+    if (m_quantumIters) {
+        return m_quantumIters;
+    }
+    auto avg = sess.avgIterTime.load();
+    if (avg == 0) {
+        return 1;
+    }
+    return std::max<size_t>(1, m_quantumMs * 1000 / avg);
+}
+
+void TimeSlicePolicy::beginSlice(SessionItem *sess, Clock::time_point now)
+{
+    m_current = sess;
+    m_quota = quotaFor(*sess);
+    m_started = 0;
+    m_finishedAtStart = sess->numFinishedIters;
+    m_sliceStart = now;
+    m_idleSince.reset();
+}
+
+SessionItem *TimeSlicePolicy::nextPending(const std::vector<PSessionItem> &sessions) const
+{
+    auto cur = std::find_if(sessions.begin(), sessions.end(), [this](auto &s) { return s.get() == m_current; });
+    auto start = cur == sessions.end() ? sessions.begin() : std::next(cur);
+    for (size_t i = 0; i != sessions.size(); ++i, ++start) {
+        if (start == sessions.end()) {
+            start = sessions.begin();
+        }
+        if (start->get() != m_current && hasPending(start->get())) {
+            return start->get();
+        }
+    }
+    return nullptr;
+}
+
+SessionItem *TimeSlicePolicy::switchTo(SessionItem *sess, Clock::time_point now, const char *reason)
+{
+    if (m_current) {
+        m_switch = Switch{
+            m_idleSince.value_or(now),
+            m_current->sessHandle,
+            sess->sessHandle,
+            reason,
+            m_started,
+            duration_cast<milliseconds>(now - m_sliceStart).count(),
+        };
+    }
+    beginSlice(sess, now);
+    return sess;
+}
+
+SessionItem *TimeSlicePolicy::selectSession(const std::vector<PSessionItem> &sessions)
+{
+    auto now = Clock::now();
+    m_wakeup.reset();
+
+    auto alive = std::any_of(sessions.begin(), sessions.end(), [this](auto &s) { return s.get() == m_current; });
+    if (!alive) {
+        m_current = nullptr;
+        auto next = nextPending(sessions);
+        if (next) {
+            beginSlice(next, now);
+        }
+        return next;
+    }
+
+    // iterations of the current slice that are still running
+    auto finished = m_current->numFinishedIters - m_finishedAtStart;
+    auto inflight = m_started > finished ? m_started - finished : 0;
+
+    if (m_started >= m_quota) {
+        if (inflight > 0) {
+            // hold the lane until the slice drains
+            return nullptr;
+        }
+        if (auto next = nextPending(sessions)) {
+            return switchTo(next, now, "quantum");
+        }
+        // nobody else is waiting, renew the slice
+        beginSlice(m_current, now);
+        return m_current;
+    }
+
+    if (inflight > 0 || hasPending(m_current)) {
+        m_idleSince.reset();
+        return m_current;
+    }
+
+    // the lane is idle and the current session has nothing queued
+    auto next = nextPending(sessions);
+    if (!next) {
+        return m_current;
+    }
+    if (!m_idleSince) {
+        m_idleSince = now;
+    }
+    if (now - *m_idleSince < m_grace) {
+        m_wakeup = *m_idleSince + m_grace;
+        return m_current;
+    }
+    return switchTo(next, now, "idle");
+}
+
+void TimeSlicePolicy::notifyStarted(SessionItem *sess)
+{
+    if (sess != m_current) {
+        return;
+    }
+    ++m_started;
+    m_idleSince.reset();
+
+    if (!m_switch) {
+        return;
+    }
+    auto cost = duration_cast<microseconds>(Clock::now() - m_switch->idleSince).count();
+    ++m_numSwitches;
+    m_totalSwitchCost += static_cast<uint64_t>(cost);
+    CLOG(INFO, logging::kPerfTag) << "event: timeslice_switch "
+                                  << nlohmann::json({
+                                         {"laneId", m_laneId},
+                                         {"from", m_switch->from},
+                                         {"to", m_switch->to},
+                                         {"reason", m_switch->reason},
+                                         {"slice_iters", m_switch->sliceIters},
+                                         {"slice_ms", m_switch->sliceMs},
+                                         {"switch_us", cost},
+                                     });
+    m_switch.reset();
+}
@@ -0,0 +1,100 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SALUS_EXEC_SCHED_TIMESLICEPOLICY_H
+#define SALUS_EXEC_SCHED_TIMESLICEPOLICY_H
+
+#include "execution/scheduler/impl/iterationpolicies.h"
+
+#include <chrono>
+#include <optional>
+#include <string>
+
+namespace salus {
+
+/**
+ * @brief Give each session on the lane a time slice in turn, enforced at iteration boundaries.
+ *
+ * The quantum is either a fixed number of iterations (SALUS_TIMESLICE_ITERS), or a time
+ * (SALUS_TIMESLICE_MS) converted to iterations using each session's average iteration time.
+ * When a session has nothing queued in its slice, the lane is held for it for a short grace
+ * period (SALUS_TIMESLICE_GRACE_US), so the gap between its iterations doesn't end the slice.
+ *
+ * The lane idle time around every switch is reported as the switch cost.
+ */
+class TimeSlicePolicy : public SelectedSessionPolicy
+{
+public:
+    explicit TimeSlicePolicy(uint64_t laneId);
+    ~TimeSlicePolicy() override;
+
+    std::string_view name() const override;
+
+    std::optional<std::chrono::steady_clock::time_point> wakeupAt() const override;
+
+protected:
+    SessionItem *selectSession(const std::vector<PSessionItem> &sessions) override;
+    void notifyStarted(SessionItem *sess) override;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @brief The first session after the current one in join order that has queued iterations
+     */
+    SessionItem *nextPending(const std::vector<PSessionItem> &sessions) const;
+
+    SessionItem *switchTo(SessionItem *sess, Clock::time_point now, const char *reason);
+    void beginSlice(SessionItem *sess, Clock::time_point now);
+    size_t quotaFor(const SessionItem &sess) const;
+
+    // knobs
+    uint64_t m_quantumMs;
+    uint64_t m_quantumIters;
+    std::chrono::microseconds m_grace;
+
+    // current slice
+    SessionItem *m_current = nullptr;
+    size_t m_quota = 0;
+    size_t m_started = 0;
+    uint64_t m_finishedAtStart = 0;
+    Clock::time_point m_sliceStart;
+    // when the lane was first seen idle with nothing queued from the current session
+    std::optional<Clock::time_point> m_idleSince;
+    std::optional<Clock::time_point> m_wakeup;
+
+    // pending switch, reported once the first iteration of the new slice starts
+    struct Switch
+    {
+        Clock::time_point idleSince;
+        std::string from;
+        std::string to;
+        const char *reason;
+        size_t sliceIters;
+        int64_t sliceMs;
+    };
+    std::optional<Switch> m_switch;
+
+    uint64_t m_numSwitches = 0;
+    uint64_t m_totalSwitchCost = 0;
+};
+
+} // namespace salus
+
+#endif // SALUS_EXEC_SCHED_TIMESLICEPOLICY_H
@@ -0,0 +1,78 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "execution/scheduler/iterationpolicy.h"
+
+#include "platform/logging.h"
+#include "utils/macros.h"
+#include "utils/threadutils.h"
+
+namespace salus {
+
+IterationPolicyRegistary &IterationPolicyRegistary::instance()
+{
+    static IterationPolicyRegistary registary;
+    return registary;
+}
+
+IterationPolicyRegistary::IterationPolicyRegistary() = default;
+
+IterationPolicyRegistary::~IterationPolicyRegistary() = default;
+
+IterationPolicyRegistary::Register::Register(std::string_view name, PolicyFactory factory)
+{
+    auto &registary = IterationPolicyRegistary::instance();
+    auto guard = sstl::with_guard(registary.m_mu);
+    auto [iter, inserted] = registary.m_policies.try_emplace(std::string(name), std::move(factory));
+    UNUSED(iter);
+    if (!inserted) {
+        LOG(FATAL) << "Duplicate registration of iteration policy under name " << name;
+    }
+}
+
+IterationPolicyRegistary::PolicyFactory IterationPolicyRegistary::find(std::string_view name) const
+{
+    auto guard = sstl::with_guard(m_mu);
+    auto iter = m_policies.find(name);
+    if (iter == m_policies.end()) {
+        LOG(ERROR) << "No iteration policy registered under name: " << name;
+        return {};
+    }
+    return iter->second;
+}
+
+IterationPolicy::IterationPolicy(uint64_t laneId)
+    : m_laneId(laneId)
+{
+}
+
+IterationPolicy::~IterationPolicy() = default;
+
+void IterationPolicy::notifySessionJoined(const PSessionItem &sess, const SessionList &laneSessions)
+{
+    UNUSED(sess);
+    UNUSED(laneSessions);
+}
+
+std::optional<std::chrono::steady_clock::time_point> IterationPolicy::wakeupAt() const
+{
+    return std::nullopt;
+}
+
+} // namespace salus
@@ -0,0 +1,171 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SALUS_EXEC_SCHED_ITERATIONPOLICY_H
+#define SALUS_EXEC_SCHED_ITERATIONPOLICY_H
+
+#include "execution/scheduler/sessionitem.h"
+
+#include <boost/container/small_vector.hpp>
+#include <boost/intrusive/list.hpp>
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace salus {
+class ExecutionContext;
+class IterationTask;
+
+/**
+ * @brief A queued iteration. Items are pooled and owned by the execution engine,
+ * the hook links them in the engine's queues.
+ */
+struct IterationItem : public boost::intrusive::list_base_hook<>
+{
+    std::weak_ptr<ExecutionContext> wectx;
+    std::unique_ptr<IterationTask> iter;
+    std::chrono::steady_clock::time_point queuedAt;
+    // when prepare first failed, or default constructed if it never did
+    std::chrono::steady_clock::time_point firstPrepareFailed;
+};
+
+/**
+ * @brief Decides the order in which expensive iterations on a lane are started.
+ *
+ * One instance is created for each lane, and is only accessed from the scheduling
+ * thread owning that lane. Iterations are pushed when they arrive, with the session
+ * they belong to, so policies can compute and cache any ordering key at that time.
+ *
+ * Policies only keep pointers to items, which are handed back to the engine through
+ * Runner when they are started or dropped.
+ */
+class IterationPolicy
+{
+public:
+    explicit IterationPolicy(uint64_t laneId);
+    virtual ~IterationPolicy();
+
+    /**
+     * @brief Name of the policy
+     * @return name
+     */
+    virtual std::string_view name() const = 0;
+
+    using SessionList = boost::container::small_vector_base<PSessionItem>;
+    /**
+     * @brief A new session starts to have iterations on this lane.
+     * @param sess the new session
+     * @param laneSessions all alive sessions on this lane, including `sess`
+     */
+    virtual void notifySessionJoined(const PSessionItem &sess, const SessionList &laneSessions);
+
+    /**
+     * @brief Queue an iteration.
+     * @param item the iteration
+     * @param sess the session `item` belongs to
+     */
+    virtual void push(IterationItem &item, SessionItem &sess) = 0;
+
+    enum class Visit
+    {
+        Started, // the iteration started, forget about it
+        Dropped, // the iteration is canceled or its session is gone, forget about it
+        Skipped, // the iteration can't start now, keep it and try the next one
+        Stop,    // the iteration can't start now, keep it and stop this pass
+    };
+
+    /**
+     * @brief Provided by the engine for each pass
+     */
+    class Runner
+    {
+    public:
+        virtual ~Runner() = default;
+
+        /**
+         * @brief Try to start `item`. The engine takes the item back if the result is Started or Dropped.
+         */
+        virtual Visit tryRun(IterationItem &item) = 0;
+
+        /**
+         * @brief Give `item` back to the engine without trying it, e.g. when its session is gone.
+         */
+        virtual void drop(IterationItem &item) = 0;
+    };
+
+    /**
+     * @brief Offer queued iterations to `runner` in policy order, until it returns Stop
+     * or every iteration is visited.
+     * @returns number of iterations started
+     */
+    virtual size_t schedule(Runner &runner) = 0;
+
+    /**
+     * @brief If the policy is holding back queued iterations until some time, the time
+     * the engine should schedule again, even if nothing else happens.
+     */
+    virtual std::optional<std::chrono::steady_clock::time_point> wakeupAt() const;
+
+    virtual size_t size() const = 0;
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+protected:
+    uint64_t m_laneId;
+};
+
+class IterationPolicyRegistary final
+{
+public:
+    IterationPolicyRegistary();
+
+    ~IterationPolicyRegistary();
+
+    using PolicyFactory = std::function<std::unique_ptr<IterationPolicy>(uint64_t laneId)>;
+    struct Register
+    {
+        explicit Register(std::string_view name, PolicyFactory factory);
+    };
+
+    /**
+     * @brief Find the factory for policy `name`
+     * @returns the factory, or an empty function if no policy is registered under `name`
+     */
+    PolicyFactory find(std::string_view name) const;
+
+    static IterationPolicyRegistary &instance();
+
+private:
+    mutable std::mutex m_mu;
+    // NOTE: std::unordered_map doesn't support lookup using std::string_view
+    std::map<std::string, PolicyFactory, std::less<>> m_policies;
+};
+
+} // namespace salus
+
+#endif // SALUS_EXEC_SCHED_ITERATIONPOLICY_H
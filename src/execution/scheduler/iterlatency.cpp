@@ -0,0 +1,50 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "iterlatency.h"
+
+namespace salus {
+
+namespace {
+nlohmann::json summarize(const sstl::Histogram &hist)
+{
+    auto snap = hist.snapshot();
+    return {
+        {"count", snap.count},
+        {"mean", snap.mean()},
+        {"p50", snap.percentile(50)},
+        {"p90", snap.percentile(90)},
+        {"p99", snap.percentile(99)},
+        {"p999", snap.percentile(99.9)},
+        {"max", snap.max},
+    };
+}
+} // namespace
+
+nlohmann::json IterLatency::summary() const
+{
+    return {
+        {"queued_us", summarize(queued)},
+        {"prepare_us", summarize(prepare)},
+        {"blocked_us", summarize(blocked)},
+        {"running_us", summarize(running)},
+    };
+}
+
+} // namespace salus
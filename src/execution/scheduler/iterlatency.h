@@ -0,0 +1,52 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SALUS_EXEC_ITERLATENCY_H
+#define SALUS_EXEC_ITERLATENCY_H
+
+#include "platform/logging.h"
+#include "utils/histogram.h"
+
+namespace salus {
+
+/**
+ * @brief Latency histograms of the lifecycle of expensive iterations, in microseconds
+ * measured by steady_clock. Safe to record and snapshot concurrently.
+ */
+struct IterLatency
+{
+    // from queued to started, including time blocked in prepare
+    sstl::Histogram queued;
+    // of the successful prepare call
+    sstl::Histogram prepare;
+    // from the first failed prepare call to the successful one, i.e. blocked in beginIteration.
+    // Only recorded for iterations that were blocked.
+    sstl::Histogram blocked;
+    // from started to finished
+    sstl::Histogram running;
+
+    /**
+     * @brief Count, mean and percentiles of each histogram
+     */
+    nlohmann::json summary() const;
+};
+
+} // namespace salus
+
+#endif // SALUS_EXEC_ITERLATENCY_H
@@ -33,10 +33,9 @@ struct OperationItem
     std::weak_ptr<SessionItem> sess;
     std::unique_ptr<salus::OperationTask> op;
 
-    size_t hash() const
-    {
-        return reinterpret_cast<size_t>(this);
-    }
+    // Link in SessionItem's inbox. While queued there, the item keeps itself alive through inboxRef.
+    OperationItem *inboxNext = nullptr;
+    std::shared_ptr<OperationItem> inboxRef;
 };
 using POpItem = std::shared_ptr<OperationItem>;
 
@@ -27,10 +27,12 @@ namespace salus {
 struct SchedulingParam
 {
     /**
-     * Maximum head-of-line waiting tasks allowed before refuse to schedule
-     * later tasks in the same queue.
+     * Maximum time in milliseconds a queue head blocked on resources keeps its shadow reservation.
+     * Later tasks in the same queue are backfilled meanwhile. The reservation is released after that,
+     * so sessions holding what the head waits for can get more to finish. Use 0 to disable shadow
+     * reservations, which backfills without protecting the head.
      */
-    uint64_t maxHolWaiting = 50;
+    uint64_t maxShadowHold = 1000;
     /**
      * Whether to be work conservative. This has no effect when using scheduler 'pack'
      */
@@ -39,6 +41,26 @@ struct SchedulingParam
      * The scheduler to use
      */
     std::string scheduler = "fair";
+    /**
+     * Number of threads scheduling iterations, lanes are sharded among them by lane id.
+     * Use 0 for default value, which is one per 8 hardware threads, at most 4.
+     */
+    uint64_t numSchedWorkers = 0;
+    /**
+     * Maximum number of expensive iterations allowed to run together on one lane.
+     * More than one is only allowed when their predicted peak memory usage fits in the lane.
+     */
+    uint64_t maxConcurrentIters = 1;
+    /**
+     * Whether a worker finishing a task runs the next admitted task from the same session inline,
+     * instead of sending every admitted task through the thread pool queues.
+     */
+    bool chainTasks = false;
+    /**
+     * Whether to oversubscribe GPU memory by paging data of other sessions out to host memory
+     * when no task can be scheduled, instead of force evicting them.
+     */
+    bool enablePaging = false;
 };
 
 } // namespace salus
@@ -19,15 +19,37 @@
 
 #include "sessionitem.h"
 
+#include "platform/logging.h"
+
 using namespace salus;
 
 SessionItem::~SessionItem()
 {
     bgQueue.clear();
-    queue.clear();
+    // release the references held by tasks still in inbox
+    drainInbox();
+    bgQueue.clear();
+    chained.clear();
 
     // output stats
     VLOG(2) << "Stats for Session " << sessHandle << ": totalExecutedOp=" << totalExecutedOp;
+    if (iterDeadline) {
+        CLOG(INFO, logging::kPerfTag) << "event: sess_deadline_stats "
+                                      << nlohmann::json({
+                                             {"sess", sessHandle},
+                                             {"deadline_ms", iterDeadline},
+                                             {"met", numDeadlineMet.load()},
+                                             {"missed", numDeadlineMissed.load()},
+                                             {"maxLateness_us", maxLateness.load()},
+                                         });
+    }
+    if (numFinishedIters) {
+        CLOG(INFO, logging::kPerfTag) << "event: sess_iter_latency "
+                                      << nlohmann::json({
+                                             {"sess", sessHandle},
+                                             {"latency", iterLatency.summary()},
+                                         });
+    }
 }
 
 void SessionItem::setPagingCallbacks(PagingCallbacks pcb)
@@ -69,18 +91,21 @@ void SessionItem::interrupt()
 
 void SessionItem::queueTask(POpItem &&opItem)
 {
-    auto g = sstl::with_guard(mu);
-    queue.emplace_back(std::move(opItem));
+    auto node = opItem.get();
+    node->inboxRef = std::move(opItem);
+    inbox.push(node);
+}
+
+void SessionItem::drainInbox()
+{
+    inbox.drain([this](OperationItem *node) { bgQueue.emplace_back(std::move(node->inboxRef)); });
 }
 
 void SessionItem::notifyAlloc(const uint64_t graphId, uint64_t ticket, const ResourceTag &tag, size_t num)
 {
     resourceUsage(tag) += num;
 
-    {
-        auto g = sstl::with_guard(tickets_mu);
-        tickets.emplace(ticket);
-    }
+    tickets.insert(ticket);
 
     updateTracker(graphId, tag);
 }
@@ -90,21 +115,29 @@ void SessionItem::notifyDealloc(const uint64_t graphId, uint64_t ticket, const R
     resourceUsage(tag) -= num;
     if (last) {
         VLOG(2) << "Removing ticket " << ticket << " from session " << sessHandle;
-        auto g = sstl::with_guard(tickets_mu);
         tickets.erase(ticket);
     }
 
     updateTracker(graphId, tag);
 }
 
+SessionItem::GraphTracker *SessionItem::findTracker(const uint64_t graphId) const
+{
+    for (auto t = trackerHead.load(std::memory_order_acquire); t; t = t->next) {
+        if (t->graphId == graphId) {
+            return t;
+        }
+    }
+    return nullptr;
+}
+
 void SessionItem::updateTracker(const uint64_t graphId, const ResourceTag &tag)
 {
     if (tag == trackerTag) {
         VLOG(2) << "SessionItem::updateTracker graphid=" << graphId << ", sess=" << sessHandle;
-        auto g = sstl::with_guard(mu);
-        auto it = allocTrackers.find(graphId);
-        if (it != allocTrackers.end()) {
-            it->second.update(resourceUsage(tag));
+        if (auto t = findTracker(graphId)) {
+            auto g = sstl::with_guard(t->mu);
+            t->tracker.update(resourceUsage(tag));
         }
     }
 }
@@ -112,14 +145,36 @@ void SessionItem::updateTracker(const uint64_t graphId, const ResourceTag &tag)
 bool SessionItem::beginIteration(AllocationRegulator::Ticket t, ResStats newRm, const uint64_t graphId)
 {
     VLOG(2) << "SessionItem::beginIteration graphid=" << graphId << ", sess=" << sessHandle;
-    auto g = sstl::with_guard(mu);
-    auto it = allocTrackers.try_emplace(graphId, trackerTag).first;
-    return it->second.beginIter(t, newRm, resourceUsage(trackerTag));
+    auto tracker = findTracker(graphId);
+    if (!tracker) {
+        auto g = sstl::with_guard(mu);
+        // check again, in case another thread added it
+        tracker = findTracker(graphId);
+        if (!tracker) {
+            tracker = &allocTrackers.emplace_back(graphId, trackerTag);
+            tracker->next = trackerHead.load(std::memory_order_relaxed);
+            trackerHead.store(tracker, std::memory_order_release);
+        }
+    }
+    auto g = sstl::with_guard(tracker->mu);
+    return tracker->tracker.beginIter(t, newRm, resourceUsage(trackerTag));
 }
 
 void SessionItem::endIteration(const uint64_t graphId)
 {
     VLOG(2) << "SessionItem::endIteration graphid=" << graphId << ", sess=" << sessHandle;
-    auto g = sstl::with_guard(mu);
-    allocTrackers.at(graphId).endIter();
+    auto tracker = findTracker(graphId);
+    CHECK(tracker) << "endIteration without beginIteration for graph " << graphId;
+    auto g = sstl::with_guard(tracker->mu);
+    tracker->tracker.endIter();
+}
+
+std::optional<size_t> SessionItem::predictedTemporary(const uint64_t graphId)
+{
+    auto tracker = findTracker(graphId);
+    if (!tracker) {
+        return std::nullopt;
+    }
+    auto g = sstl::with_guard(tracker->mu);
+    return tracker->tracker.predictedTemporary();
 }
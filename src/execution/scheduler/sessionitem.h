@@ -20,14 +20,19 @@
 #ifndef SALUS_EXEC_SESSIONITEM_H
 #define SALUS_EXEC_SESSIONITEM_H
 
+#include "utils/concurrentidset.h"
 #include "utils/containerutils.h"
+#include "utils/mpscinbox.h"
 #include "resources/resources.h"
 #include "resources/iteralloctracker.h"
 #include "execution/devices.h"
 #include "execution/engine/taskexecutor.h"
 #include "execution/engine/allocationlistener.h"
+#include "execution/scheduler/iterlatency.h"
+#include "execution/scheduler/operationitem.h"
 #include "platform/thread_annotations.h"
 
+#include <deque>
 #include <list>
 #include <string>
 #include <functional>
@@ -36,11 +41,12 @@
 #include <unordered_map>
 #include <memory>
 #include <any>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <optional>
 #include <utility>
 
-struct OperationItem;
-using POpItem = std::shared_ptr<OperationItem>;
-
 namespace salus {
 class ExecutionEngine;
 }
@@ -49,8 +55,7 @@ class ExecutionEngine;
  */
 struct SessionItem : public salus::AllocationListener
 {
-    using KernelQueue = std::list<POpItem>;
-    using UnsafeQueue = std::list<POpItem>;
+    using UnsafeQueue = std::deque<POpItem>;
 private:
     // protected by mu (may be accessed both in schedule thread and close session thread)
     salus::PagingCallbacks pagingCb GUARDED_BY(mu);
@@ -59,25 +64,62 @@ private:
     // called if the execution engine requires to interrupt the session
     std::function<void()> interruptCb GUARDED_BY(mu);
 
-    KernelQueue queue GUARDED_BY(mu);
+    // Tasks queued from any thread, drained into bgQueue by the scheduling thread
+    sstl::MpscInbox<OperationItem, &OperationItem::inboxNext> inbox;
+
+    /**
+     * @brief Move everything in inbox to the end of bgQueue. Only called from the scheduling thread.
+     */
+    void drainInbox();
+
+    // Admitted tasks waiting for a running task of this session to finish and run them inline,
+    // and number of such running tasks. Only used when task chaining is enabled.
+    std::deque<POpItem> chained GUARDED_BY(chainMu);
+    size_t numChainRunning = 0 GUARDED_BY(chainMu);
+    std::mutex chainMu;
     // total number of executed op in this session
     uint64_t totalExecutedOp = 0 GUARDED_BY(mu);
 
     // rm for current iteration
     const static constexpr ResourceTag trackerTag = resources::GPU0Memory;
-    std::unordered_map<uint64_t, salus::IterAllocTracker> allocTrackers GUARDED_BY(mu);
-
+    struct GraphTracker
+    {
+        const uint64_t graphId;
+        std::mutex mu;
+        salus::IterAllocTracker tracker GUARDED_BY(mu);
+        GraphTracker *next = nullptr;
+
+        GraphTracker(uint64_t graphId, const ResourceTag &tag)
+            : graphId(graphId)
+            , tracker(tag)
+        {
+        }
+    };
+    // Trackers are only added, from beginIteration under mu, and never removed. Each is pushed
+    // to the front of the chain from trackerHead, so notifications find theirs without mu.
+    std::list<GraphTracker> allocTrackers GUARDED_BY(mu);
+    std::atomic<GraphTracker *> trackerHead{nullptr};
+
+    GraphTracker *findTracker(uint64_t graphId) const;
     void updateTracker(uint64_t graphId, const ResourceTag &tag);
 
     std::mutex mu;
 
     size_t lastScheduled = 0;
 
-    uint64_t holWaiting = 0;
-    size_t queueHeadHash = 0;
+    // Shadow reservation for the head of bgQueue while it's blocked on resources. Resources freed
+    // later go to shadowTicket first, and tasks behind the head are backfilled with what's left.
+    // shadowTicket is 0 once the reservation is released, while shadowHead is kept to not shadow
+    // the same head again. Only accessed by the scheduling thread.
+    POpItem shadowHead;
+    uint64_t shadowTicket = 0;
+    salus::DeviceSpec shadowSpec{};
+    Resources shadowUsage;
+    std::chrono::steady_clock::time_point shadowSince;
 
-    std::unordered_set<uint64_t> tickets;
-    std::mutex tickets_mu;
+    // Tickets the session has resources allocated from. Inserting an existing one is a few loads,
+    // so it's done on every allocation.
+    sstl::ConcurrentIdSet tickets;
 
     // Accessed by multiple scheduling thread
     std::atomic_bool protectOOM{true};
@@ -85,6 +127,13 @@ private:
     // Iters should goto blockingIters queue
     std::atomic_bool exlusiveMode{true};
 
+    // Whether in TaskExecutor's ready set, so it's added at most once per scheduling pass
+    std::atomic_bool inReadySet{false};
+
+    // Bytes paged out to host, and whether a page out or prefetch is in progress
+    std::atomic_size_t pagedOut{0};
+    std::atomic_bool pagingInFlight{false};
+
     friend class salus::TaskExecutor;
     friend class BaseScheduler;
     friend class salus::ExecutionEngine;
@@ -100,23 +149,32 @@ public:
     uint64_t totalRunningTime {0};
     std::atomic_uint_fast64_t usedRunningTime {0};
     std::atomic_uint_fast64_t numFinishedIters {0};
+    // moving average of the running time of expensive iterations in us
+    std::atomic_uint_fast64_t avgIterTime {0};
+
+    // relative deadline of each iteration in ms, counted from when it is queued. 0 means none.
+    uint64_t iterDeadline {0};
+    std::atomic_uint_fast64_t numDeadlineMet {0};
+    std::atomic_uint_fast64_t numDeadlineMissed {0};
+    // in us
+    std::atomic_uint_fast64_t maxLateness {0};
+
+    // lifecycle latency of expensive iterations
+    salus::IterLatency iterLatency;
 
     explicit SessionItem(std::string handle)
         : sessHandle(std::move(handle))
     {
-        // NOTE: add other devices
-        resUsage[resources::GPU0Memory].get() = 0;
-        resUsage[resources::GPU1Memory].get() = 0;
-        resUsage[resources::CPU0Memory].get() = 0;
-        resUsage[{ResourceType::GPU_STREAM, salus::devices::GPU0}].get() = 0;
-        resUsage[{ResourceType::GPU_STREAM, salus::devices::GPU1}].get() = 0;
     }
 
     ~SessionItem() override;
 
-    sstl::MutableAtom::value_type &resourceUsage(const ResourceTag &tag)
+    std::atomic_uint_fast64_t &resourceUsage(const ResourceTag &tag)
     {
-        return resUsage.at(tag).get();
+        if (SALUS_PREDICT_FALSE(!resources::hasSlot(tag))) {
+            resources::detail::unsupportedTag(tag);
+        }
+        return resUsage[resources::slotOf(tag)];
     }
 
     void setPagingCallbacks(salus::PagingCallbacks pcb);
@@ -132,6 +190,12 @@ public:
 
     void endIteration(uint64_t graphId);
 
+    /**
+     * @brief Predicted peak temporary memory usage of the next iteration of graph `graphId`
+     * @returns the prediction, or nullopt if there's not enough history
+     */
+    std::optional<size_t> predictedTemporary(uint64_t graphId);
+
     /**
      * @brief prepare to remove session from execution engine.
      * 
@@ -152,9 +216,8 @@ public:
     void interrupt();
 
 private:
-    using AtomicResUsages = std::unordered_map<ResourceTag, sstl::MutableAtom>;
-    // must be initialized in constructor
-    AtomicResUsages resUsage;
+    // Usage of each tag, in the slot of it in Resources
+    std::array<std::atomic_uint_fast64_t, resources::kNumSlots> resUsage{};
 };
 using PSessionItem = std::shared_ptr<SessionItem>;
 using SessionList = std::list<PSessionItem>;
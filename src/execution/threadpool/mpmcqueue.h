@@ -0,0 +1,151 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef EXECUTION_THREADPOOL_MPMCQUEUE_H
+#define EXECUTION_THREADPOOL_MPMCQUEUE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+/**
+ * @brief A bounded multi-producer multi-consumer FIFO queue.
+ *
+ * Each cell carries a sequence number telling whether it's ready for the producer or the consumer
+ * of a given lap, so producers and consumers each claim a cell with one CAS on their end of the
+ * queue and never wait for each other, unless the queue is full or empty.
+ * See Dmitry Vyukov's bounded MPMC queue.
+ */
+template<typename Work, size_t kSize>
+class MpmcQueue
+{
+    // require power-of-two for fast masking
+    static_assert((kSize & (kSize - 1)) == 0);
+    static_assert(kSize >= 2);
+
+public:
+    MpmcQueue()
+        : m_cells(new Cell[kSize])
+    {
+        for (size_t i = 0; i != kSize; ++i) {
+            m_cells[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpmcQueue(const MpmcQueue &) = delete;
+    MpmcQueue &operator=(const MpmcQueue &) = delete;
+
+    /**
+     * @brief Add w at the end of the queue.
+     * @returns w if the queue is full, otherwise a default constructed Work.
+     */
+    Work push(Work w)
+    {
+        auto pos = m_enqueuePos.load(std::memory_order_relaxed);
+        Cell *cell;
+        for (;;) {
+            cell = &m_cells[pos & kMask];
+            auto seq = cell->seq.load(std::memory_order_acquire);
+            auto diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                // the cell still holds the item from the last lap
+                return w;
+            } else {
+                pos = m_enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        cell->w = std::move(w);
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return {};
+    }
+
+    /**
+     * @brief Remove and return the first item in the queue.
+     * @returns a default constructed Work if the queue is empty.
+     */
+    Work pop()
+    {
+        auto pos = m_dequeuePos.load(std::memory_order_relaxed);
+        Cell *cell;
+        for (;;) {
+            cell = &m_cells[pos & kMask];
+            auto seq = cell->seq.load(std::memory_order_acquire);
+            auto diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (m_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return {};
+            } else {
+                pos = m_dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+        Work w = std::move(cell->w);
+        cell->seq.store(pos + kMask + 1, std::memory_order_release);
+        return w;
+    }
+
+    /**
+     * @returns approximate number of items in the queue, may be off during concurrent modifications
+     */
+    size_t size() const
+    {
+        auto deq = m_dequeuePos.load(std::memory_order_acquire);
+        auto enq = m_enqueuePos.load(std::memory_order_acquire);
+        return enq > deq ? std::min(enq - deq, kSize) : 0;
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+    /**
+     * @brief Delete all items in the queue.
+     */
+    void flush()
+    {
+        while (pop()) {
+        }
+    }
+
+private:
+    static constexpr size_t kMask = kSize - 1;
+
+    struct Cell
+    {
+        std::atomic<size_t> seq;
+        Work w;
+    };
+
+    std::unique_ptr<Cell[]> m_cells;
+    // producers and consumers on their own cache line
+    alignas(64) std::atomic<size_t> m_enqueuePos{0};
+    alignas(64) std::atomic<size_t> m_dequeuePos{0};
+};
+
+#endif // EXECUTION_THREADPOOL_MPMCQUEUE_H
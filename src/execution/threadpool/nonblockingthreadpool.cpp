@@ -26,10 +26,15 @@
 #include "EventCount.h"
 #include "utils/fixed_function.hpp"
 #include "RunQueue.h"
+#include "mpmcqueue.h"
 #include "platform/thread_annotations.h"
+#include "utils/threadutils.h"
 
+#include <algorithm>
 #include <atomic>
+#include <deque>
 #include <memory>
+#include <mutex>
 #include <thread>
 #include <vector>
 
@@ -77,7 +82,10 @@ class ThreadPoolPrivate
 {
     ThreadPool *const q; // NOLINT
 
-    using Queue = RunQueue<Task, 1024>;
+    static constexpr size_t kQueueCapacity = 1024;
+    using Queue = RunQueue<Task, kQueueCapacity>;
+
+    static constexpr size_t kOverflowCapacity = 4096;
 
     ThreadPoolPrivate(const ThreadPoolPrivate &) = delete;
     ThreadPoolPrivate &operator =(const ThreadPoolPrivate &) = delete;
@@ -89,6 +97,11 @@ public:
     ~ThreadPoolPrivate();
 
     Task tryRun(Task c);
+    size_t tryRunBatch(std::vector<Task> &ts);
+    size_t freeCapacity() const;
+    bool saturated() const;
+    ThreadPool::QueueStats queueStats() const;
+    void setDrainCallback(std::function<void()> cb);
     void stop();
     void join();
     size_t numThreads() const;
@@ -127,6 +140,29 @@ private:
 
     int nonEmptyQueueIndex();
 
+    /**
+     * Queue a task that doesn't fit in the worker queues. It goes to the overflow queue,
+     * or to the spill list if that is full too.
+     */
+    void pushOverflow(Task t);
+
+    /**
+     * Take the oldest task from the overflow queue, then from the spill list
+     */
+    Task popOverflow();
+
+    bool overflowEmpty() const;
+
+    /**
+     * Record an overflowed submission, and notify right away if the queues already drained
+     */
+    void markSaturated();
+
+    /**
+     * Called by workers after taking a task, notify if the pool was saturated and drained enough
+     */
+    void maybeNotifyDrained();
+
     static inline PerThread *getPerThread()
     {
         static thread_local PerThread per_thread;
@@ -152,6 +188,17 @@ private:
     std::atomic<bool> m_done;
     std::atomic<bool> m_cancelled;
     EventCount m_ec;
+
+    // Shared by all workers, for tasks submitted while worker queues are full
+    MpmcQueue<Task, kOverflowCapacity> m_overflow;
+    std::deque<Task> m_spill GUARDED_BY(m_spillMu);
+    std::mutex m_spillMu;
+    std::atomic<size_t> m_spillSize{0};
+    std::atomic<uint64_t> m_numOverflowed{0};
+    std::atomic<uint64_t> m_numSpilled{0};
+
+    std::atomic<bool> m_saturated{false};
+    std::function<void()> m_drainCb;
 };
 
 ThreadPool::ThreadPool(const ThreadPoolOptions &options)
@@ -167,6 +214,42 @@ ThreadPool::Closure ThreadPool::tryRun(Closure c)
     t = d->tryRun(std::move(t));
     return std::move(t.c);
 }
+
+size_t ThreadPool::tryRunBatch(std::vector<Closure> &cs)
+{
+    std::vector<Task> ts;
+    ts.reserve(cs.size());
+    for (auto &c : cs) {
+        ts.emplace_back(std::move(c));
+    }
+    auto accepted = d->tryRunBatch(ts);
+    // give back what's not accepted
+    for (auto i = accepted; i < ts.size(); ++i) {
+        cs[i] = std::move(ts[i].c);
+    }
+    return accepted;
+}
+
+size_t ThreadPool::freeCapacity() const
+{
+    return d->freeCapacity();
+}
+
+bool ThreadPool::saturated() const
+{
+    return d->saturated();
+}
+
+ThreadPool::QueueStats ThreadPool::queueStats() const
+{
+    return d->queueStats();
+}
+
+void ThreadPool::setDrainCallback(std::function<void()> cb)
+{
+    d->setDrainCallback(std::move(cb));
+}
+
 void ThreadPool::stop()
 {
     d->stop();
@@ -246,12 +329,130 @@ Task ThreadPoolPrivate::tryRun(Task t)
     // completes overall computations, which in turn leads to destruction of
     // this. We expect that such scenario is prevented by program, that is,
     // this is kept alive while any threads can potentially be in Schedule.
-    if (!t) {
+    const bool overflowed = static_cast<bool>(t);
+    if (overflowed) {
+        pushOverflow(std::move(t));
+    }
+    m_ec.Notify(false);
+    if (overflowed) {
+        markSaturated();
+    }
+    return {};
+}
+
+size_t ThreadPoolPrivate::tryRunBatch(std::vector<Task> &ts)
+{
+    auto pt = getPerThread();
+    const auto size = m_queues.size();
+    // Only the owner may push to the front of a queue, so always push to the back, and
+    // walk over queues so consecutive tasks go to different workers.
+    unsigned victim = pt->pool == this ? pt->thread_id : rand(&pt->rand) % size;
+
+    bool overflowed = false;
+    for (auto &t : ts) {
+        for (size_t i = 0; i != size && t && !overflowed; ++i) {
+            t = m_queues[victim].PushBack(std::move(t));
+            if (++victim == size) {
+                victim = 0;
+            }
+        }
+        if (t) {
+            // every queue is full, the rest of the batch goes to the overflow queue
+            overflowed = true;
+            pushOverflow(std::move(t));
+        }
+    }
+
+    // See the note in tryRun about touching this after making tasks available.
+    for (size_t i = 0; i != std::min(ts.size(), size); ++i) {
         m_ec.Notify(false);
     }
+    if (overflowed) {
+        markSaturated();
+    }
+    return ts.size();
+}
+
+size_t ThreadPoolPrivate::freeCapacity() const
+{
+    size_t used = 0;
+    for (const auto &q : m_queues) {
+        used += q.Size();
+    }
+    used += m_overflow.size() + m_spillSize.load(std::memory_order_relaxed);
+    return kQueueCapacity * m_queues.size() - std::min(used, kQueueCapacity * m_queues.size());
+}
+
+bool ThreadPoolPrivate::saturated() const
+{
+    return m_saturated;
+}
+
+ThreadPool::QueueStats ThreadPoolPrivate::queueStats() const
+{
+    return {m_numOverflowed.load(std::memory_order_relaxed), m_numSpilled.load(std::memory_order_relaxed)};
+}
+
+void ThreadPoolPrivate::pushOverflow(Task t)
+{
+    m_numOverflowed.fetch_add(1, std::memory_order_relaxed);
+    t = m_overflow.push(std::move(t));
+    if (!t) {
+        return;
+    }
+
+    m_numSpilled.fetch_add(1, std::memory_order_relaxed);
+    auto g = sstl::with_guard(m_spillMu);
+    m_spill.emplace_back(std::move(t));
+    m_spillSize.fetch_add(1, std::memory_order_release);
+}
+
+Task ThreadPoolPrivate::popOverflow()
+{
+    auto t = m_overflow.pop();
+    if (t || m_spillSize.load(std::memory_order_acquire) == 0) {
+        return t;
+    }
+
+    auto g = sstl::with_guard(m_spillMu);
+    if (!m_spill.empty()) {
+        t = std::move(m_spill.front());
+        m_spill.pop_front();
+        m_spillSize.fetch_sub(1, std::memory_order_relaxed);
+    }
     return t;
 }
 
+bool ThreadPoolPrivate::overflowEmpty() const
+{
+    return m_overflow.empty() && m_spillSize.load(std::memory_order_acquire) == 0;
+}
+
+void ThreadPoolPrivate::setDrainCallback(std::function<void()> cb)
+{
+    m_drainCb = std::move(cb);
+}
+
+void ThreadPoolPrivate::markSaturated()
+{
+    m_saturated = true;
+    // workers may have drained the queues before seeing the flag
+    maybeNotifyDrained();
+}
+
+void ThreadPoolPrivate::maybeNotifyDrained()
+{
+    if (!m_saturated.load(std::memory_order_relaxed)) {
+        return;
+    }
+    if (freeCapacity() * 2 < kQueueCapacity * m_queues.size()) {
+        return;
+    }
+    if (m_saturated.exchange(false) && m_drainCb) {
+        m_drainCb();
+    }
+}
+
 void ThreadPoolPrivate::stop()
 {
     m_cancelled = true;
@@ -300,6 +501,10 @@ ThreadPoolPrivate::~ThreadPoolPrivate()
         for (auto &q : m_queues) {
             q.Flush();
         }
+        m_overflow.flush();
+        auto g = sstl::with_guard(m_spillMu);
+        m_spill.clear();
+        m_spillSize = 0;
     }
 
     // Join threads explicitly to avoid destruction order issues.
@@ -356,9 +561,15 @@ void ThreadPoolPrivate::workerLoop(int thread_id)
         // pools tend to be used for.
         while (!m_cancelled) {
             auto t = q.PopFront();
+            if (!t) {
+                t = popOverflow();
+            }
             for (int i = 0; i < spinCount && !t; i++) {
                 if (!m_cancelled.load(std::memory_order_relaxed)) {
                     t = q.PopFront();
+                    if (!t) {
+                        t = popOverflow();
+                    }
                 }
             }
             if (!t) {
@@ -367,12 +578,17 @@ void ThreadPoolPrivate::workerLoop(int thread_id)
                 }
             }
             if (t) {
+                maybeNotifyDrained();
                 t();
             }
         }
     } else {
         while (!m_cancelled) {
             auto t = q.PopFront();
+            if (!t) {
+                // tasks in the overflow queue are older than what other workers have queued
+                t = popOverflow();
+            }
             if (!t) {
                 t = steal();
                 if (!t) {
@@ -380,7 +596,10 @@ void ThreadPoolPrivate::workerLoop(int thread_id)
                     if (allowSpinning && !m_spinning && !m_spinning.exchange(true)) {
                         for (int i = 0; i < spinCount && !t; i++) {
                             if (!m_cancelled.load(std::memory_order_relaxed)) {
-                                t = steal();
+                                t = popOverflow();
+                                if (!t) {
+                                    t = steal();
+                                }
                             } else {
                                 return;
                             }
@@ -395,6 +614,7 @@ void ThreadPoolPrivate::workerLoop(int thread_id)
                 }
             }
             if (t) {
+                maybeNotifyDrained();
                 t();
             }
         }
@@ -426,6 +646,14 @@ bool ThreadPoolPrivate::waitForWork(EventCount::Waiter *waiter, Task *t)
     // We already did best-effort emptiness check in Steal, so prepare for blocking.
     m_ec.Prewait(waiter);
     // Now do a reliable emptiness check.
+    if (!overflowEmpty()) {
+        m_ec.CancelWait(waiter);
+        if (m_cancelled) {
+            return false;
+        }
+        *t = popOverflow();
+        return true;
+    }
     int victim = nonEmptyQueueIndex();
     if (victim != -1) {
       m_ec.CancelWait(waiter);
@@ -447,7 +675,7 @@ bool ThreadPoolPrivate::waitForWork(EventCount::Waiter *waiter, Task *t)
       // right after incrementing blocked_ above. Now a free-standing thread
       // submits work and calls destructor (which sets done_). If we don't
       // re-check queues, we will exit leaving the work unexecuted.
-      if (nonEmptyQueueIndex() != -1) {
+      if (nonEmptyQueueIndex() != -1 || !overflowEmpty()) {
         // Note: we must not pop from queues before we decrement blocked_,
         // otherwise the following scenario is possible. Consider that instead
         // of checking for emptiness we popped the only element from queues.
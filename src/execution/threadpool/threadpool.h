@@ -22,8 +22,11 @@
 
 #include "utils/fixed_function.hpp"
 
+#include <cstdint>
+#include <functional>
 #include <future>
 #include <memory>
+#include <vector>
 
 struct ThreadPoolOptions
 {
@@ -99,28 +102,35 @@ public:
 
     /**
      * @brief Try run a closure c in thread pool.
-     * @returns c itself if queue is full. Otherwise a default constructed Closure.
+     *
+     * If the worker queues are full, c goes to a shared overflow queue, which workers drain
+     * after their own queue and before stealing from others, and the pool is marked saturated.
+     *
+     * @returns a default constructed Closure, as c is always accepted.
      */
     Closure tryRun(Closure c);
 
+    /**
+     * @brief Try run closures in thread pool, in order, spreading them over worker queues
+     * and waking up workers once for the whole batch.
+     * Closures that don't fit in any worker queue go to the overflow queue, see tryRun.
+     * @returns number of closures accepted, which is all of them. Accepted closures are reset in `cs`.
+     */
+    size_t tryRunBatch(std::vector<Closure> &cs);
+
     /**
      * @brief Run the Func f in thread pool, don't care about its completion.
      * This may be more efficient, because no wrapper task for future/promise is created.
-     * If the queue is full, then f is run on calling thread.
+     * f is never run on calling thread, even if the worker queues are full.
      */
     template<typename Func>
     void run(Func f)
     {
-        auto c = tryRun(std::move(f));
-        if (c) {
-            // enqueue failed, run on current thread
-            c();
-        }
+        tryRun(std::move(f));
     }
 
     /**
      * @brief Post the function f to thread pool, returns with a future holding the result.
-     * If the queue is full, then closure is executed on caller thread before return.
      * @returns future holding the return value of function f.
      */
     template<typename Func>
@@ -135,6 +145,38 @@ public:
         return fu;
     }
 
+    /**
+     * @returns approximate number of closures that can still be queued before the pool overflows
+     */
+    size_t freeCapacity() const;
+
+    /**
+     * @returns whether a submission overflowed the worker queues since the last time the pool drained
+     */
+    bool saturated() const;
+
+    struct QueueStats
+    {
+        // closures that didn't fit in worker queues
+        uint64_t overflowed = 0;
+        // of which also didn't fit in the bounded overflow queue, and were put to a locked list
+        uint64_t spilled = 0;
+    };
+
+    /**
+     * @returns number of queue-full events since the pool started
+     */
+    QueueStats queueStats() const;
+
+    /**
+     * @brief Set a callback called once after a submission overflows, when workers drained
+     * the queues to at least half of their capacity. It may be called on a worker thread or,
+     * if the queues drained before the overflow was noticed, on the submitting thread.
+     *
+     * This is not thread safe and must be called before any submission.
+     */
+    void setDrainCallback(std::function<void()> cb);
+
     /**
      * @brief Signal to stop the thread pool, currently running tasks will continue to run.
      */
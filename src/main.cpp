@@ -20,10 +20,12 @@
 #include "utils/macros.h"
 
 #ifdef SALUS_ENABLE_TENSORFLOW
+#include "oplibraries/tensorflow/device/gpu/lane/lanemgr.h"
 #include "oplibraries/tensorflow/v3/smblocker.h"
 #endif
 
 #include "execution/executionengine.h"
+#include "resources/memorymgr.h"
 #include "resources/resources.h"
 #include "platform/logging.h"
 #include "platform/signals.h"
@@ -47,11 +49,18 @@ namespace {
 
 namespace flags {
 const static auto listen = "--listen";
+const static auto maxShadowHold = "--max-shadow-hold";
 const static auto maxHolWaiting = "--max-hol-waiting";
 const static auto disableFairness = "--disable-fairness";
 const static auto disableWorkConservative = "--disable-wc";
 const static auto smFactor = "--sm-factor";
 const static auto scheduler = "--sched";
+const static auto schedThreads = "--sched-threads";
+const static auto maxConcurrentIters = "--max-concurrent-iters";
+const static auto chainTasks = "--chain-tasks";
+const static auto oversubscribe = "--oversubscribe";
+const static auto gpuMemLimit = "--gpu-mem-limit";
+const static auto resourceLimits = "--resource-limits";
 
 const static auto logConf = "--logconf";
 const static auto verbose = "--verbose";
@@ -77,12 +86,29 @@ Options:
                                 Listen on ZeroMQ endpoint <endpoint>.
                                 [default: tcp://*:5501]
     -s <policy>, --sched=<policy>
-                                Use <policy> for scheduling . Choices: fair, preempt, pack, rr, fifo.
+                                Use <policy> for scheduling . Choices: fair, preempt, pack, rr, fifo, edf, timeslice.
                                 [default: pack]
     --disable-wc                Disable work conservation. Only have effect when
                                 fairness is on.
-    --max-hol-waiting=<num>     Maximum number of task allowed go before queue head
-                                in scheduling. [default: 50]
+    --max-shadow-hold=<ms>      Maximum time a queue head blocked on resources reserves
+                                resources freed by others, while later tasks are
+                                backfilled around it. Use 0 to disable. [default: 1000]
+    --sched-threads=<num>       Number of threads scheduling iterations. Lanes are
+                                distributed among them. Use 0 to decide based on
+                                the number of CPU cores. [default: 0]
+    --max-concurrent-iters=<num>
+                                Maximum number of iterations running together on one lane,
+                                when their predicted memory usage fits in the lane. [default: 1]
+    --chain-tasks               Let a worker finishing a task run the next admitted task
+                                from the same session inline.
+    --oversubscribe             Page data of other sessions out to host memory when GPU
+                                memory is used up, instead of force evicting them.
+                                Only supported by the simulator, rejected here.
+    --gpu-mem-limit=<MB>        Only use this much GPU memory on each GPU, to simulate
+                                a smaller device. Use 0 for no limit. [default: 0]
+    --resource-limits=<file>    Override resource limits discovered from hardware with
+                                those in <file>. Each line is `<type>:<device> <amount>',
+                                e.g. `MEMORY:GPU:1 8G'. Use amount 0 to hide a device.
     --sm-factor=<num>           Scale factor for # of SMs. [default: 1]
     -c <file>, --logconf=<file> Path to log configuration file. Note that
                                 settings in this file takes precedence over
@@ -105,6 +131,8 @@ Options:
 Deprecated options:
     --disable-fairness          Disable fair sharing in scheduling, having the same effect
                                 as `--sched=pack'.
+    --max-hol-waiting=<num>     Ignored. Tasks behind a blocked queue head are backfilled,
+                                see `--max-shadow-hold'.
 )"s;
 
 static auto kVersion = R"(Salus: Fine-Grained GPU Sharing for DNN version 0.1.0)"s;
@@ -209,16 +237,51 @@ void initializeLogging(std::map<std::string, docopt::value> &args)
 void configureExecution(std::map<std::string, docopt::value> &args)
 {
     auto disableFairness = value_or<bool>(args[flags::disableFairness], false);
-    uint64_t maxQueueHeadWaiting = value_or<long>(args[flags::maxHolWaiting], 50u);
+    uint64_t maxShadowHold = value_or<long>(args[flags::maxShadowHold], 1000u);
     auto disableWorkConservative = value_or<bool>(args[flags::disableWorkConservative], false);
     auto sched = value_or<std::string>(args[flags::scheduler], "fair"s);
+    uint64_t schedThreads = value_or<long>(args[flags::schedThreads], 0u);
+    uint64_t maxConcurrentIters = value_or<long>(args[flags::maxConcurrentIters], 1u);
+    auto chainTasks = value_or<bool>(args[flags::chainTasks], false);
+    auto oversubscribe = value_or<bool>(args[flags::oversubscribe], false);
 
     // Handle deprecated arguments
     if (disableFairness) {
         sched = "pack";
     }
+    if (args[flags::maxHolWaiting]) {
+        LOG(WARNING) << flags::maxHolWaiting << " is deprecated and ignored, use " << flags::maxShadowHold;
+    }
+    if (oversubscribe) {
+        // no executor here registers paging callbacks, paging would only end up force evicting sessions
+        LOG(ERROR) << flags::oversubscribe << " is only supported by the simulator, ignoring";
+        oversubscribe = false;
+    }
 
-    salus::ExecutionEngine::instance().setSchedulingParam({maxQueueHeadWaiting, !disableWorkConservative, sched});
+    salus::ExecutionEngine::instance().setSchedulingParam(
+        {maxShadowHold, !disableWorkConservative, sched, schedThreads, maxConcurrentIters, chainTasks,
+         oversubscribe});
+}
+
+void configureResourceLimits(std::map<std::string, docopt::value> &args)
+{
+#ifdef SALUS_ENABLE_TENSORFLOW
+    resources::registerLimitsProbe(salus::oplib::tensorflow::LaneMgr::probeLimits);
+#endif
+
+    // before anything reads the limits, so every component sees the same capped GPUs
+    if (uint64_t gpuMemLimit = value_or<long>(args[flags::gpuMemLimit], 0u) * 1024 * 1024) {
+        resources::capPlatformLimits(ResourceType::MEMORY, salus::DeviceType::GPU, gpuMemLimit);
+    }
+
+    if (auto path = optional_arg<std::string>(args[flags::resourceLimits])) {
+        auto overrides = resources::loadLimitsFile(*path);
+        if (!overrides) {
+            LOG(ERROR) << "Ignoring invalid resource limits file " << *path << ", using discovered limits";
+            return;
+        }
+        resources::overridePlatformLimits(*overrides);
+    }
 }
 
 void configureSMBlocker(std::map<std::string, docopt::value> &args)
@@ -253,8 +316,12 @@ void printConfiguration(std::map<std::string, docopt::value> &)
     LOG(INFO) << "Scheduling parameters:";
     auto &param = salus::ExecutionEngine::instance().schedulingParam();
     LOG(INFO) << "    Policy: " << param.scheduler;
-    LOG(INFO) << "    MaxQueueHeadWaiting: " << param.maxHolWaiting;
+    LOG(INFO) << "    MaxShadowHold: " << param.maxShadowHold << "ms";
     LOG(INFO) << "    WorkConservative: " << (param.workConservative ? "on" : "off");
+    LOG(INFO) << "    SchedulingThreads: " << (param.numSchedWorkers ? std::to_string(param.numSchedWorkers) : "auto"s);
+    LOG(INFO) << "    MaxConcurrentIters: " << param.maxConcurrentIters;
+    LOG(INFO) << "    ChainTasks: " << (param.chainTasks ? "on" : "off");
+    LOG(INFO) << "    Oversubscribe: " << (param.enablePaging ? "on" : "off");
 
 #ifdef SALUS_ENABLE_TENSORFLOW
     LOG(INFO) << "GPU execution:";
@@ -273,6 +340,8 @@ int main(int argc, char **argv)
 
     configureExecution(args);
 
+    configureResourceLimits(args);
+
     configureSMBlocker(args);
 
     printConfiguration(args);
@@ -292,5 +361,7 @@ int main(int argc, char **argv)
 
     salus::ExecutionEngine::instance().stopScheduler();
 
+    MemoryMgr::instance().logStats();
+
     return 0;
 }
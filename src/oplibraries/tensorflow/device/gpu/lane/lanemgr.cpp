@@ -23,6 +23,8 @@
 #include "oplibraries/tensorflow/device/gpu/gpu.h"
 #include "oplibraries/tensorflow/tfexception.h"
 #include "oplibraries/tensorflow/tfinstance.h"
+#include "resources/resources.h"
+#include "utils/containerutils.h"
 #include "utils/envutils.h"
 #include "utils/threadutils.h"
 
@@ -43,7 +45,14 @@ LaneMgr::LaneMgr()
     CHECK(!validIds.empty()) << "At least 1 GPU should be present";
 
     // Initialize CUDA runtime on each GPU
+    const auto &limits = resources::platformLimits();
     for (auto gpuId : validIds) {
+        auto memoryLimit = sstl::optionalGet(limits, {ResourceType::MEMORY, {DeviceType::GPU, gpuId}});
+        if (!memoryLimit) {
+            LOG(INFO) << "Skipping GPU " << gpuId << " without memory limit";
+            continue;
+        }
+
         auto se = gpu_manager->ExecutorForDevice(gpuId).ValueOrDie();
 
         if (!m_cpuCudaHostAlloc) {
@@ -57,6 +66,8 @@ LaneMgr::LaneMgr()
             throw TFException(tf::errors::Unknown("Failed to query available memory for GPU ", gpuId));
         }
         availableMemory = availableMemory - 300 * 1024 * 1024;
+        // Use the same limit as the rest of the system
+        availableMemory = std::min(availableMemory, static_cast<tf::int64>(*memoryLimit));
 
         // We don't care about the theorical totalMemory, but what is available to us in maximum
         totalMemory = availableMemory;
@@ -66,6 +77,8 @@ LaneMgr::LaneMgr()
         CHECK_LE(gcb.availableMemory, gcb.totalMemory);
     }
 
+    CHECK(!m_gpus.empty()) << "At least 1 GPU should be usable";
+
     // Initialize CPU device
     auto name = tf::strings::StrCat(TFInstance::namePrefix(), "/device:CPU:0");
     // use tf::cpu_allocator to select from cpu allocatory registary
@@ -80,11 +93,39 @@ LaneMgr::LaneMgr()
 
 LaneMgr::~LaneMgr() = default;
 
-std::vector<int> LaneMgr::getValidGpuIds()
+/*static*/ std::vector<int> LaneMgr::getValidGpuIds()
 {
+    // NOTE: iteration tracking, fair sharing and paging only account for GPU0 yet
     return {0};
 }
 
+/*static*/ void LaneMgr::probeLimits(Resources &limits)
+{
+    SALUS_THROW_IF_ERROR(tf::ValidateGPUMachineManager());
+    auto gpu_manager = tf::GPUMachineManager();
+
+    auto count = gpu_manager->VisibleDeviceCount();
+    if (count > resources::kMaxGPUs) {
+        LOG(WARNING) << "Only the first " << resources::kMaxGPUs << " of " << count
+                     << " visible GPUs can be tracked, ignoring the rest";
+        count = resources::kMaxGPUs;
+    }
+
+    for (int gpuId = 0; gpuId < count; ++gpuId) {
+        auto se = gpu_manager->ExecutorForDevice(gpuId).ValueOrDie();
+
+        tf::int64 availableMemory, totalMemory;
+        if (!se->DeviceMemoryUsage(&availableMemory, &totalMemory)) {
+            LOG(ERROR) << "Failed to query available memory for GPU " << gpuId;
+            continue;
+        }
+        // Leave the same headroom as when creating lanes. The GPU may be busy with other processes,
+        // keep it with no memory rather than letting the size wrap around.
+        availableMemory = std::max<tf::int64>(availableMemory - 300 * 1024 * 1024, 0);
+        resources::addGPULimits(limits, gpuId, static_cast<size_t>(availableMemory));
+    }
+}
+
 tf::Device *LaneMgr::compatibleCPUDevice() const
 {
     return m_cpu.get();
@@ -23,6 +23,7 @@
 #include "oplibraries/tensorflow/tensorflow_headers.h"
 
 #include "oplibraries/tensorflow/tfutils.h"
+#include "resources/resources.h"
 #include "utils/fixed_function.hpp"
 #include "utils/pointerutils.h"
 #include "utils/threadutils.h"
@@ -44,6 +45,11 @@ public:
     LaneMgr();
     ~LaneMgr();
 
+    /**
+     * @brief Fill in limits of GPUs visible to the process, to be used as a limits probe
+     */
+    static void probeLimits(Resources &limits);
+
     using RequestLaneCallback = sstl::FixedFunction<void(std::vector<std::shared_ptr<LaneHolder>> &&)>;
     struct Layout
     {
@@ -70,7 +76,7 @@ public:
     }
 
 private:
-    std::vector<int> getValidGpuIds();
+    static std::vector<int> getValidGpuIds();
     void createCudaHostAllocator(tfgpu::StreamExecutor *se);
 
     bool m_disabled = false;
@@ -31,6 +31,8 @@
 #include "oplibraries/tensorflow/tfsession.h"
 #include "utils/macros.h"
 
+#include <tuple>
+
 namespace salus::oplib::tensorflow {
 
 inline tf::StringPiece svToStringPiece(std::string_view sv)
@@ -135,17 +137,35 @@ void TFInstance::handleCreateSession(std::unique_ptr<tf::CreateSessionRequest> &
     }
 
     CHECK_EQ(layout.memoryLimits.size(), layout.persistentOccupation.size());
+    // Scheduling is done on the first lane only, see setLaneId below. LaneMgr gives lanes
+    // back in ascending order of memory limit, then persistent size.
+    size_t persistentOnFirstLane = 0;
+    {
+        const auto &limits = layout.memoryLimits;
+        const auto &persist = layout.persistentOccupation;
+        size_t first = 0;
+        for (size_t i = 1; i < limits.size(); ++i) {
+            if (std::tie(limits[i], persist[i]) < std::tie(limits[first], persist[first])) {
+                first = i;
+            }
+        }
+        persistentOnFirstLane = persist.at(first);
+    }
 
     auto totalRunningTime =
         static_cast<uint64_t>(std::round(sstl::getOrDefault(m.persistant(), "TIME:TOTAL", 0.0))) * 1000;
     ectx->setExpectedRunningTime(totalRunningTime);
 
+    // relative deadline of each iteration in ms, used by the edf policy
+    auto iterDeadline = static_cast<uint64_t>(std::round(sstl::getOrDefault(m.persistant(), "TIME:DEADLINE", 0.0)));
+    ectx->setIterationDeadline(iterDeadline);
+
     // smaller is higher priority
     auto priority = static_cast<int>(sstl::getOrDefault(m.persistant(), "SCHED:PRIORITY", 20));
 
-    LOG(INFO) << "Accept session with priority " << priority;
+    LOG(INFO) << "Accept session with priority " << priority << ", iteration deadline " << iterDeadline << "ms";
 
-    m_laneMgr->requestLanes(std::move(layout), [&resp, priority,
+    m_laneMgr->requestLanes(std::move(layout), [&resp, priority, persistentOnFirstLane,
                                                 cb = std::move(cb), req = std::move(req), ectx = std::move(ectx),
                                                 this](auto &&lanes) mutable {
         std::vector<tf::Device *> devices;
@@ -164,6 +184,7 @@ void TFInstance::handleCreateSession(std::unique_ptr<tf::CreateSessionRequest> &
         // Revisit if later multi-lane for a job is implemented.
         // TODO: support multiple lane id
         ectx->setLaneId(lanes.at(0)->id());
+        ectx->setLaneMemory(lanes.at(0)->totalMemory(), persistentOnFirstLane);
 
         auto session =
             std::make_shared<TFSession>(*this, ectx, std::move(devices), req->config(), req->mutable_graph_def());
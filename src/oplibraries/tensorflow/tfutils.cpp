@@ -20,6 +20,7 @@
 #include "oplibraries/tensorflow/tensorflow_headers.h"
 #include "oplibraries/tensorflow/tfutils.h"
 #include "oplibraries/tensorflow/tfexception.h"
+#include "resources/resources.h"
 
 #include <unordered_map>
 #include <sstream>
@@ -33,7 +34,11 @@ DeviceSpec tfDeviceNameToSpec(const std::string &name)
     if (!tf::DeviceNameUtils::ParseFullName(name, &parsedName)) {
         throw TFException(tf::errors::InvalidArgument("Device name invalid: ", name));
     }
-    return DeviceSpec{ tfDeviceTypeToType(parsedName.type), parsedName.id };
+    DeviceSpec spec{tfDeviceTypeToType(parsedName.type), parsedName.id};
+    if (!resources::hasDeviceSlot(spec)) {
+        throw TFException(tf::errors::InvalidArgument("Device not supported: ", name));
+    }
+    return spec;
 }
 
 DeviceType tfDeviceTypeToType(const std::string &type)
@@ -2434,15 +2434,43 @@ class TFExecutorTask : public IterationTask
 {
     ExecutorImpl &m_impl;
     tf::CancellationManager &m_cm;
+    tf::CancellationToken m_cancelToken;
+    // Whether the callback is still registered with m_cm. m_cm may be gone once the iteration
+    // is handed to m_state and finishes, so it is deregistered before that.
+    bool m_registered = false;
 
     std::unique_ptr<ExecutorState> m_state;
 
+    void deregisterCancel()
+    {
+        if (m_registered) {
+            m_cm.DeregisterCallback(m_cancelToken);
+            m_registered = false;
+        }
+    }
+
 public:
     TFExecutorTask(ExecutorImpl &impl, const tf::Executor::Args &args, tf::Executor::DoneCallback done)
         : m_impl(impl)
         , m_cm(*args.cancellation_manager)
+        , m_cancelToken(m_cm.get_cancellation_token())
         , m_state(std::make_unique<ExecutorState>(args, &impl, std::move(done)))
     {
+        // Let the engine drop the iteration as soon as it is canceled, rather than
+        // finding out in its next scheduling pass.
+        std::weak_ptr<ExecutionContext> wectx = m_impl.params_.ins;
+        m_registered = m_cm.RegisterCallback(m_cancelToken, [wectx = std::move(wectx)]() {
+            if (auto ectx = wectx.lock()) {
+                ectx->notifyIterationCanceled();
+            }
+        });
+    }
+
+    ~TFExecutorTask() override
+    {
+        // only still registered if the iteration was dropped without running, in which case
+        // m_state still holds the done callback and the step, thus m_cm, is alive
+        deregisterCancel();
     }
 
     uint64_t graphId() const override
@@ -2467,6 +2495,7 @@ public:
 
     void runAsync(std::shared_ptr<IterationContext> &&ictx) noexcept override
     {
+        deregisterCancel();
         // SIExecutorState will delete itself after called runAsync
         m_state.release()->runAsync(std::move(ictx));
     }
@@ -2474,6 +2503,7 @@ public:
     void cancel() override
     {
         m_cm.StartCancel();
+        deregisterCancel();
     }
 
     bool isCanceled() const override
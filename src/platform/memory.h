@@ -33,6 +33,14 @@ void *malloc(size_t size);
 void *realloc(void *ptr, size_t size);
 void free(void *ptr);
 
+// Size of physical memory installed on this machine, or 0 if unknown.
+size_t physicalMemory();
+
+// Map 'size' bytes of zeroed memory directly from the system, backed by huge pages
+// where supported. Returns nullptr on failure.
+void *hugePageAlloc(size_t size);
+void hugePageFree(void *ptr, size_t size);
+
 } // namespace mem
 
 #endif // MEMORY_H
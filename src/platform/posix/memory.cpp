@@ -22,6 +22,8 @@
 #include "config.h" // IWYU: keep
 
 #include <cstdlib>
+#include <sys/mman.h>
+#include <unistd.h>
 
 void *mem::alignedAlloc(int minimum_alignment, size_t size)
 {
@@ -67,3 +69,31 @@ void mem::free(void *ptr)
 {
     std::free(ptr);
 }
+
+size_t mem::physicalMemory()
+{
+    auto pages = sysconf(_SC_PHYS_PAGES);
+    auto pageSize = sysconf(_SC_PAGE_SIZE);
+    if (pages <= 0 || pageSize <= 0) {
+        return 0;
+    }
+    return static_cast<size_t>(pages) * static_cast<size_t>(pageSize);
+}
+
+void *mem::hugePageAlloc(size_t size)
+{
+    auto ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ptr == MAP_FAILED) {
+        return nullptr;
+    }
+#if defined(MADV_HUGEPAGE)
+    // only a hint, transparent huge pages may be disabled
+    madvise(ptr, size, MADV_HUGEPAGE);
+#endif
+    return ptr;
+}
+
+void mem::hugePageFree(void *ptr, size_t size)
+{
+    munmap(ptr, size);
+}
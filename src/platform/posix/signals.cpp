@@ -110,6 +110,13 @@ void initialize()
 
     installSignalHandler(SIGINT, handler);
     installSignalHandler(SIGTERM, handler);
+
+    // SIGUSR1 asks for runtime statistics, and is only received by waitForTerminate.
+    // Block it before any thread is created, so they all inherit the mask.
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &set, nullptr);
 }
 
 std::pair<int, SignalAction> waitForTerminate()
@@ -118,11 +125,15 @@ std::pair<int, SignalAction> waitForTerminate()
     sigemptyset(&set);
     sigaddset(&set, SIGTERM);
     sigaddset(&set, SIGINT);
+    sigaddset(&set, SIGUSR1);
     int sig;
     sigwait(&set, &sig);
 
     LOG(INFO) << "Received signal " << signalName(sig) << "(" << sig << ")";
 
+    if (sig == SIGUSR1) {
+        return {sig, SignalAction::DumpStats};
+    }
     return {sig, SignalAction::Exit};
 }
 
@@ -28,6 +28,7 @@ enum class SignalAction
 {
     Exit,
     Ignore,
+    DumpStats,
 };
 
 void initialize();
@@ -57,3 +57,24 @@ void mem::free(void *ptr)
 {
     std::free(ptr);
 }
+
+size_t mem::physicalMemory()
+{
+    MEMORYSTATUSEX status;
+    status.dwLength = sizeof(status);
+    if (!GlobalMemoryStatusEx(&status)) {
+        return 0;
+    }
+    return static_cast<size_t>(status.ullTotalPhys);
+}
+
+void *mem::hugePageAlloc(size_t size)
+{
+    // large pages need SeLockMemoryPrivilege, use normal pages instead
+    return VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+}
+
+void mem::hugePageFree(void *ptr, size_t)
+{
+    VirtualFree(ptr, 0, MEM_RELEASE);
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "resources/alloctimeline.h"
+
+#include <algorithm>
+
+namespace salus {
+
+AllocTimeline::AllocTimeline(size_t numBuckets)
+    : m_profile(std::max(numBuckets, size_t{1}), 0)
+    , m_suffixPeak(m_profile.size(), 0)
+{
+}
+
+void AllocTimeline::beginIter()
+{
+    m_samples.clear();
+    m_samples.reserve(m_events);
+}
+
+void AllocTimeline::record(size_t usage)
+{
+    m_samples.push_back(usage);
+}
+
+size_t AllocTimeline::bucketOf(size_t event, size_t numEvents) const
+{
+    if (numEvents == 0) {
+        return 0;
+    }
+    return std::min(event * m_profile.size() / numEvents, m_profile.size() - 1);
+}
+
+void AllocTimeline::endIter()
+{
+    if (m_samples.empty()) {
+        return;
+    }
+
+    std::vector<size_t> observed(m_profile.size(), 0);
+    for (size_t i = 0; i != m_samples.size(); ++i) {
+        auto &b = observed[bucketOf(i, m_samples.size())];
+        b = std::max(b, m_samples[i]);
+    }
+
+    // Rise immediately but decay slowly, so a single light iteration doesn't make us
+    // under-predict the next one.
+    for (size_t b = 0; b != m_profile.size(); ++b) {
+        auto &p = m_profile[b];
+        if (m_numIters == 0 || observed[b] >= p) {
+            p = observed[b];
+        } else {
+            p -= (p - observed[b]) / 2;
+        }
+    }
+
+    size_t peak = 0;
+    for (size_t b = m_profile.size(); b-- > 0;) {
+        peak = std::max(peak, m_profile[b]);
+        m_suffixPeak[b] = peak;
+    }
+
+    m_events = m_numIters == 0 ? m_samples.size() : (m_events + m_samples.size()) / 2;
+    ++m_numIters;
+}
+
+size_t AllocTimeline::remainingPeak(size_t progress) const
+{
+    return m_suffixPeak[bucketOf(progress, m_events)];
+}
+
+} // namespace salus
@@ -0,0 +1,102 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SALUS_MEM_ALLOCTIMELINE_H
+#define SALUS_MEM_ALLOCTIMELINE_H
+
+#include <cstddef>
+#include <vector>
+
+namespace salus {
+
+/**
+ * @brief Predicts temporary usage of an iteration as a function of its progress, learned
+ * from previous iterations of the same graph.
+ *
+ * Progress is measured in allocation events since the iteration began, as a graph allocates
+ * in mostly the same order every iteration. Iterations are normalized to a fixed number of
+ * buckets, each remembering the peak usage seen in that part of the iteration.
+ */
+class AllocTimeline
+{
+public:
+    explicit AllocTimeline(size_t numBuckets = 64);
+
+    /**
+     * @brief Start recording a new iteration
+     */
+    void beginIter();
+
+    /**
+     * @brief Record usage after one more allocation event in current iteration
+     */
+    void record(size_t usage);
+
+    /**
+     * @brief Learn the recorded iteration into the model
+     */
+    void endIter();
+
+    /**
+     * @brief Whether at least one iteration has been learned
+     */
+    bool trained() const
+    {
+        return m_numIters > 0;
+    }
+
+    /**
+     * @brief Predicted peak usage from event 'progress' till the end of the iteration.
+     * Only meaningful if trained.
+     */
+    size_t remainingPeak(size_t progress) const;
+
+    /**
+     * @brief Predicted peak usage of a whole iteration
+     */
+    size_t peak() const
+    {
+        return m_suffixPeak.front();
+    }
+
+    /**
+     * @brief Expected number of allocation events in an iteration
+     */
+    size_t expectedEvents() const
+    {
+        return m_events;
+    }
+
+private:
+    size_t bucketOf(size_t event, size_t numEvents) const;
+
+    // usage after each event of current iteration
+    std::vector<size_t> m_samples;
+
+    // learned peak usage per bucket, and max of buckets from each one on
+    std::vector<size_t> m_profile;
+    std::vector<size_t> m_suffixPeak;
+
+    size_t m_events = 0;
+    int m_numIters = 0;
+};
+
+} // namespace salus
+
+#endif // SALUS_MEM_ALLOCTIMELINE_H
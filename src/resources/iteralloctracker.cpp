@@ -18,25 +18,16 @@
  */
 
 #include "resources/iteralloctracker.h"
-#include "utils/date.h"
 #include "platform/logging.h"
 
-using std::chrono::duration_cast;
-using std::chrono::microseconds;
-using std::chrono::milliseconds;
-using std::chrono::nanoseconds;
-using std::chrono::seconds;
-using std::chrono::system_clock;
-using FpSeconds = std::chrono::duration<double, seconds::period>;
-using namespace std::chrono_literals;
-using namespace date;
+#include <algorithm>
 
 namespace salus {
 
-IterAllocTracker::IterAllocTracker(const ResourceTag &tag, size_t window, double peakthr)
+IterAllocTracker::IterAllocTracker(const ResourceTag &tag, size_t numBuckets, double margin)
     : m_tag(tag)
-    , m_peakthr(peakthr)
-    , m_window(window)
+    , m_margin(margin)
+    , m_timeline(numBuckets)
 {
 }
 
@@ -50,25 +41,18 @@ bool IterAllocTracker::beginIter(AllocationRegulator::Ticket ticket, ResStats es
     if (m_numIters == 0) {
         m_est = estimation;
     }
+    if (m_timeline.trained()) {
+        m_est.temporary = m_timeline.peak();
+        m_est.count = m_timeline.expectedEvents();
+    }
 
     VLOG(3) << "IterAllocTracker@" << as_hex(this) << "::beginIter ticket=" << m_ticket.as_int
             << ", estimation=" << m_est.DebugString() << ", numIter=" << m_numIters;
 
     // reset curr
     m_currPersist = currentUsage;
-    m_currPeak = 0;
     m_count = 0;
-
-    // reset buffer
-    m_buf.clear();
-    if (m_window == 0 && m_est.count != 0) {
-        auto cap = std::max(m_est.count / 50, size_t{2});
-        m_buf.set_capacity(cap);
-    } else if (m_window == 0){
-        m_buf.set_capacity(50);
-    } else {
-        m_buf.set_capacity(m_window);
-    }
+    m_timeline.beginIter();
 
     // reserve res
     Resources cap;
@@ -76,6 +60,7 @@ bool IterAllocTracker::beginIter(AllocationRegulator::Ticket ticket, ResStats es
     VLOG(3) << "IterAllocTracker@" << as_hex(this) << " reserve: " << cap;
     m_holding = m_ticket.beginAllocation(cap);
     if (m_holding) {
+        m_held = m_est.temporary;
         ++m_numIters;
     } else {
         // to avoid deadlock
@@ -88,11 +73,12 @@ bool IterAllocTracker::beginIter(AllocationRegulator::Ticket ticket, ResStats es
 
 bool IterAllocTracker::update(size_t num)
 {
-    m_currPeak = std::max(m_currPeak, num);
+    auto temporary = num > m_currPersist ? num - m_currPersist : 0;
+    m_timeline.record(temporary);
     ++m_count;
 
     VLOG(3) << "IterAllocTracker@" << as_hex(this) << "::update ticket=" << m_ticket.as_int << ", numIter=" << m_numIters
-            << ", current=" << m_currPersist << ", peak=" << m_currPeak << ", count=" << m_count;
+            << ", current=" << m_currPersist << ", temporary=" << temporary << ", count=" << m_count;
 
     if (!m_holding) {
         return false;
@@ -101,67 +87,71 @@ bool IterAllocTracker::update(size_t num)
 #if defined(SALUS_ENABLE_EXCLUSIVE_ITER)
     return false;
 #else
-    // If we hold memory allocation, estimate when we should release it
-    m_buf.push_back({system_clock::now().time_since_epoch().count(), num});
+    // The iteration may use more than learned, e.g. when the graph allocates in a different order.
+    // Grow the hold to cover it, so others are not admitted on memory that is actually in use.
+    if (temporary > m_held) {
+        growAllocationHold(static_cast<uint64_t>(temporary * (1 + m_margin)) - m_held);
+        return false;
+    }
 
-    if (m_buf.size() < 2) {
+    // Without a learned timeline we don't know whether the peak has passed,
+    // so keep holding till the iteration ends.
+    if (!m_timeline.trained()) {
         return false;
     }
 
-    auto [stx, sty] = m_buf.front();
-    auto [edx, edy] = m_buf.back();
-    auto slope = (edy - sty) * 1.0 / (edx - stx);
-    if (slope < 0 && num >= m_peakthr * m_est.temporary) {
-        releaseAllocationHold();
-        return true;
+    // Hold only what the rest of the iteration is predicted to need, but never less than
+    // what is in use now.
+    auto needed = std::max(m_timeline.remainingPeak(m_count), temporary);
+    auto target = static_cast<uint64_t>(needed * (1 + m_margin));
+    if (target >= m_held) {
+        return false;
     }
 
-    return false;
+    releaseAllocationHold(m_held - target);
+    return true;
 #endif
 }
 
-void IterAllocTracker::releaseAllocationHold()
+void IterAllocTracker::growAllocationHold(uint64_t amount)
 {
-    if (!m_holding) {
+    Resources toHold{
+        {m_tag, amount}
+    };
+    if (!m_ticket.extendAllocation(toHold)) {
+        VLOG(2) << "IterAllocTracker@" << as_hex(this) << " can't grow hold by " << toHold << ", held=" << m_held;
         return;
     }
-
-    m_holding = false;
-
-    Resources toRelease{
-        {m_tag, m_est.temporary}
-    };
-    VLOG(3) << "IterAllocTracker@" << as_hex(this) << "::endIter ticket=" << m_ticket.as_int << ", estimation=" << m_est.DebugString()
-            << ", numIter=" << m_numIters << ", toRelease=" << toRelease;
-    m_ticket.endAllocation(toRelease);
+    m_held += amount;
+    VLOG(3) << "IterAllocTracker@" << as_hex(this) << "::growAllocationHold ticket=" << m_ticket.as_int
+            << ", toHold=" << toHold << ", held=" << m_held;
 }
 
-namespace {
-size_t runningAvg(size_t lastAvg, size_t current, int newCount)
+void IterAllocTracker::releaseAllocationHold(uint64_t amount)
 {
-    if (lastAvg == 0 || newCount == 0) {
-        return current;
+    if (!m_holding || amount == 0) {
+        return;
     }
 
-    double avg = lastAvg;
-    avg = (avg * (newCount - 1) + current) / newCount;
-    return static_cast<size_t>(avg);
-}
+    amount = std::min(amount, m_held);
+    m_held -= amount;
+
+    Resources toRelease{
+        {m_tag, amount}
+    };
+    VLOG(3) << "IterAllocTracker@" << as_hex(this) << "::releaseAllocationHold ticket=" << m_ticket.as_int
+            << ", estimation=" << m_est.DebugString() << ", numIter=" << m_numIters << ", toRelease=" << toRelease
+            << ", held=" << m_held;
+    m_ticket.endAllocation(toRelease);
 }
 
 void IterAllocTracker::endIter()
 {
-    // first release hold, because we'll be modifying m_est
-    releaseAllocationHold();
-
-    // update our estimation using running average
+    // first release hold, before updating our estimation
+    releaseAllocationHold(m_held);
+    m_holding = false;
 
-    // persist usage
-    if (m_currPeak > m_currPersist) {
-        auto newTemporary = m_currPeak - m_currPersist;
-        m_est.temporary = runningAvg(m_est.temporary, newTemporary, m_numIters);
-    }
-    m_est.count = runningAvg(m_est.count, m_count, m_numIters);
+    m_timeline.endIter();
 }
 
 } // namespace salus
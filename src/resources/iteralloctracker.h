@@ -20,38 +20,62 @@
 #ifndef SALUS_MEM_ITERATIONALLOCATIONTRACKER_H
 #define SALUS_MEM_ITERATIONALLOCATIONTRACKER_H
 
+#include "resources/alloctimeline.h"
 #include "resources/resources.h"
 
-#include <boost/circular_buffer.hpp>
+#include <optional>
 
 namespace salus {
 
+/**
+ * @brief Holds allocation regulator resources for an iteration, and gives them back as soon as
+ * the learned allocation timeline of the graph says they won't be needed for the rest of it.
+ *
+ * Early release, and growing the hold back when usage exceeds it, only happen when built with
+ * WITH_EXCLUSIVE_ITER=OFF. Otherwise the whole hold is kept till the iteration ends.
+ */
 class IterAllocTracker
 {
     // knobs
     ResourceTag m_tag;
-    double m_peakthr;
-    size_t m_window;
+    double m_margin;
 
     // cross iter state
     int m_numIters = 0;
     ResStats m_est{};
+    AllocTimeline m_timeline;
     // in iter state
     bool m_holding = false;
+    uint64_t m_held = 0;
     uint64_t m_currPersist = 0;
-    uint64_t m_currPeak = 0;
     size_t m_count = 0;
     AllocationRegulator::Ticket m_ticket{};
 
-    boost::circular_buffer<std::pair<long, size_t>> m_buf;
-
-    void releaseAllocationHold();
+    void growAllocationHold(uint64_t amount);
+    void releaseAllocationHold(uint64_t amount);
 public:
-    IterAllocTracker(const ResourceTag &tag, size_t window = 0, double peakthr = 0.9);
+    /**
+     * @param tag the resource to track
+     * @param numBuckets resolution of the learned timeline
+     * @param margin fraction of predicted usage held in addition, as headroom for mispredictions
+     */
+    IterAllocTracker(const ResourceTag &tag, size_t numBuckets = 64, double margin = 0.1);
 
     bool beginIter(AllocationRegulator::Ticket ticket, ResStats estimation, uint64_t currentUsage);
     bool update(size_t num);
     void endIter();
+
+    /**
+     * @brief Predicted peak temporary usage of the next iteration, or nullopt if we haven't
+     * observed any iteration yet.
+     */
+    std::optional<size_t> predictedTemporary() const
+    {
+        if (!m_timeline.trained()) {
+            return std::nullopt;
+        }
+        return m_timeline.peak();
+    }
 };
 
 } // namespace salus
@@ -21,6 +21,384 @@
 
 #include "platform/logging.h"
 #include "platform/memory.h"
+#include "platform/thread_annotations.h"
+#include "utils/threadutils.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <unordered_map>
+
+namespace {
+
+// Every block starts with a header right before the pointer returned
+constexpr size_t kHeaderSize = 16;
+constexpr size_t kMinAlignment = 16;
+// Requests larger than this, including header and padding, go to large arenas
+constexpr size_t kMaxSmall = 32 << 10;
+// Size classes cache at most this many bytes per thread each
+constexpr size_t kMaxCachedBytes = 256 << 10;
+// Size classes take memory from large arenas in slabs of at least this size
+constexpr size_t kMinSlab = 64 << 10;
+
+constexpr size_t kPageSize = 4 << 10;
+constexpr size_t kHugePageSize = 2 << 20;
+constexpr size_t kMinArena = 64 << 20;
+
+constexpr uint32_t kLargeClass = UINT32_MAX;
+
+size_t alignUp(size_t v, size_t alignment)
+{
+    return (v + alignment - 1) & ~(alignment - 1);
+}
+
+struct FreeBlock
+{
+    FreeBlock *next;
+};
+
+} // namespace
+
+struct MemoryMgr::Impl
+{
+    struct Counters
+    {
+        std::atomic<size_t> bytes{0};
+        std::atomic<size_t> count{0};
+    };
+
+    struct BlockHeader
+    {
+        uint32_t cls;
+        // from the start of the block to the pointer returned
+        uint32_t offset;
+        Counters *session;
+    };
+    static_assert(sizeof(BlockHeader) <= kHeaderSize, "Block header too large");
+
+    struct FreeList
+    {
+        FreeBlock *head = nullptr;
+        size_t count = 0;
+
+        void push(FreeBlock *b)
+        {
+            b->next = head;
+            head = b;
+            ++count;
+        }
+
+        FreeBlock *pop()
+        {
+            auto b = head;
+            head = b->next;
+            --count;
+            return b;
+        }
+    };
+
+    struct Central
+    {
+        std::mutex mu;
+        FreeList list GUARDED_BY(mu);
+    };
+
+    struct ThreadCache
+    {
+        Impl *impl = nullptr;
+        std::vector<FreeList> lists;
+
+        // RPCs of the same session tend to come in a row
+        std::string lastSession;
+        Counters *lastCounters = nullptr;
+
+        ~ThreadCache()
+        {
+            if (!impl) {
+                return;
+            }
+            for (uint32_t cls = 0; cls != lists.size(); ++cls) {
+                impl->flush(cls, lists[cls], lists[cls].count);
+            }
+        }
+    };
+
+    std::vector<size_t> classSizes;
+    // class for sizes up to 1K, in steps of 16 bytes
+    std::vector<uint32_t> smallLookup;
+    std::vector<size_t> maxCached;
+    std::unique_ptr<Central[]> central;
+
+    std::atomic<size_t> reserved{0};
+
+    std::mutex arenaMu;
+    std::map<char *, size_t> freeByAddr GUARDED_BY(arenaMu);
+    std::multimap<size_t, char *> freeBySize GUARDED_BY(arenaMu);
+    std::unordered_map<char *, size_t> largeInUse GUARDED_BY(arenaMu);
+
+    mutable std::mutex sessMu;
+    // never removed, as blocks point to their counters
+    std::unordered_map<std::string, std::unique_ptr<Counters>> sessions GUARDED_BY(sessMu);
+
+    Impl()
+    {
+        // 16 bytes apart up to 128, then 4 classes per doubling
+        for (size_t size = 32; size <= 128; size += 16) {
+            classSizes.push_back(size);
+        }
+        for (size_t base = 128; base < kMaxSmall; base *= 2) {
+            for (size_t step = 1; step <= 4; ++step) {
+                classSizes.push_back(base + step * base / 4);
+            }
+        }
+
+        for (size_t i = 0; i <= 1024 / 16; ++i) {
+            auto it = std::lower_bound(classSizes.begin(), classSizes.end(), i * 16);
+            smallLookup.push_back(static_cast<uint32_t>(it - classSizes.begin()));
+        }
+
+        for (auto size : classSizes) {
+            maxCached.push_back(std::clamp(kMaxCachedBytes / size, size_t{4}, size_t{512}));
+        }
+        central = std::make_unique<Central[]>(classSizes.size());
+    }
+
+    ~Impl()
+    {
+        // memory in use by clients can't be unmapped, leave it to the process exit
+    }
+
+    uint32_t classOf(size_t size) const
+    {
+        if (size <= 1024) {
+            return smallLookup[(size + 15) / 16];
+        }
+        auto it = std::lower_bound(classSizes.begin(), classSizes.end(), size);
+        return static_cast<uint32_t>(it - classSizes.begin());
+    }
+
+    ThreadCache &threadCache()
+    {
+        thread_local ThreadCache cache;
+        if (!cache.impl) {
+            cache.impl = this;
+            cache.lists.resize(classSizes.size());
+        }
+        return cache;
+    }
+
+    Counters *countersOf(ThreadCache &cache, const std::string &session)
+    {
+        if (cache.lastCounters && cache.lastSession == session) {
+            return cache.lastCounters;
+        }
+        {
+            auto g = sstl::with_guard(sessMu);
+            auto &c = sessions[session];
+            if (!c) {
+                c = std::make_unique<Counters>();
+            }
+            cache.lastCounters = c.get();
+        }
+        cache.lastSession = session;
+        return cache.lastCounters;
+    }
+
+    void insertFree(char *ptr, size_t size) EXCLUSIVE_LOCKS_REQUIRED(arenaMu)
+    {
+        auto eraseBySize = [this](char *p, size_t s) {
+            auto [first, last] = freeBySize.equal_range(s);
+            for (auto it = first; it != last; ++it) {
+                if (it->second == p) {
+                    freeBySize.erase(it);
+                    return;
+                }
+            }
+        };
+
+        // coalesce with neighbors
+        auto next = freeByAddr.lower_bound(ptr);
+        if (next != freeByAddr.end() && ptr + size == next->first) {
+            size += next->second;
+            eraseBySize(next->first, next->second);
+            next = freeByAddr.erase(next);
+        }
+        if (next != freeByAddr.begin()) {
+            auto prev = std::prev(next);
+            if (prev->first + prev->second == ptr) {
+                eraseBySize(prev->first, prev->second);
+                ptr = prev->first;
+                size += prev->second;
+                freeByAddr.erase(prev);
+            }
+        }
+
+        freeByAddr.emplace(ptr, size);
+        freeBySize.emplace(size, ptr);
+    }
+
+    // Take 'size' bytes, a multiple of kPageSize, from large arenas
+    char *carve(size_t size) EXCLUSIVE_LOCKS_REQUIRED(arenaMu)
+    {
+        auto it = freeBySize.lower_bound(size);
+        if (it == freeBySize.end()) {
+            auto arenaSize = std::max(kMinArena, alignUp(size, kHugePageSize));
+            auto arena = static_cast<char *>(mem::hugePageAlloc(arenaSize));
+            if (!arena) {
+                return nullptr;
+            }
+            reserved += arenaSize;
+            insertFree(arena, arenaSize);
+            it = freeBySize.lower_bound(size);
+        }
+
+        // best fit, the remaining is still free
+        auto [avail, ptr] = *it;
+        freeBySize.erase(it);
+        freeByAddr.erase(ptr);
+        if (avail > size) {
+            freeByAddr.emplace(ptr + size, avail - size);
+            freeBySize.emplace(avail - size, ptr + size);
+        }
+        return ptr;
+    }
+
+    char *allocLarge(size_t size)
+    {
+        auto g = sstl::with_guard(arenaMu);
+        auto ptr = carve(size);
+        if (ptr) {
+            largeInUse.emplace(ptr, size);
+        }
+        return ptr;
+    }
+
+    size_t freeLarge(char *ptr)
+    {
+        auto g = sstl::with_guard(arenaMu);
+        auto node = largeInUse.extract(ptr);
+        CHECK(!node.empty()) << "Freeing unknown large block " << as_hex(ptr);
+        insertFree(ptr, node.mapped());
+        return node.mapped();
+    }
+
+    // Give 'n' blocks from 'list' back to the central list of 'cls'
+    void flush(uint32_t cls, FreeList &list, size_t n)
+    {
+        if (n == 0) {
+            return;
+        }
+        auto &c = central[cls];
+        auto g = sstl::with_guard(c.mu);
+        for (size_t i = 0; i != n; ++i) {
+            c.list.push(list.pop());
+        }
+    }
+
+    // Move a batch of blocks of 'cls' from the central list to 'list', making a new slab if needed
+    bool refill(uint32_t cls, FreeList &list)
+    {
+        auto size = classSizes[cls];
+        auto batch = std::max(maxCached[cls] / 2, size_t{1});
+
+        auto &c = central[cls];
+        auto g = sstl::with_guard(c.mu);
+        if (c.list.count < batch) {
+            auto slabSize = alignUp(std::max(kMinSlab, size * batch * 2), kPageSize);
+            char *slab;
+            {
+                auto ga = sstl::with_guard(arenaMu);
+                slab = carve(slabSize);
+            }
+            if (slab) {
+                for (size_t off = 0; off + size <= slabSize; off += size) {
+                    c.list.push(reinterpret_cast<FreeBlock *>(slab + off));
+                }
+            }
+        }
+
+        batch = std::min(batch, c.list.count);
+        for (size_t i = 0; i != batch; ++i) {
+            list.push(c.list.pop());
+        }
+        return batch > 0;
+    }
+
+    void *allocate(size_t alignment, size_t num_bytes, const std::string &session)
+    {
+        alignment = std::max(alignment, kMinAlignment);
+        // the padding before ptr is recorded in 32 bits
+        if (alignment > std::numeric_limits<uint32_t>::max()) {
+            return nullptr;
+        }
+        // blocks are aligned to kMinAlignment, so in the worst case this much is skipped
+        auto overhead = kHeaderSize + (alignment - kMinAlignment);
+        // num_bytes comes from clients, make sure neither this nor rounding up to arenas wraps around
+        if (num_bytes > std::numeric_limits<size_t>::max() - overhead - kHugePageSize) {
+            return nullptr;
+        }
+        auto needed = num_bytes + overhead;
+
+        auto &cache = threadCache();
+
+        char *block;
+        uint32_t cls;
+        size_t blockSize;
+        if (needed <= kMaxSmall) {
+            cls = classOf(needed);
+            blockSize = classSizes[cls];
+            auto &list = cache.lists[cls];
+            if (!list.count && !refill(cls, list)) {
+                return nullptr;
+            }
+            block = reinterpret_cast<char *>(list.pop());
+        } else {
+            cls = kLargeClass;
+            blockSize = alignUp(needed, kPageSize);
+            block = allocLarge(blockSize);
+            if (!block) {
+                return nullptr;
+            }
+        }
+
+        auto ptr = reinterpret_cast<char *>(alignUp(reinterpret_cast<uintptr_t>(block) + kHeaderSize, alignment));
+        auto header = reinterpret_cast<BlockHeader *>(ptr - kHeaderSize);
+        header->cls = cls;
+        header->offset = static_cast<uint32_t>(ptr - block);
+        header->session = countersOf(cache, session);
+
+        header->session->bytes.fetch_add(blockSize, std::memory_order_relaxed);
+        header->session->count.fetch_add(1, std::memory_order_relaxed);
+        return ptr;
+    }
+
+    void deallocate(char *ptr)
+    {
+        auto header = reinterpret_cast<BlockHeader *>(ptr - kHeaderSize);
+        auto block = ptr - header->offset;
+        auto session = header->session;
+        auto cls = header->cls;
+
+        size_t blockSize;
+        if (cls == kLargeClass) {
+            blockSize = freeLarge(block);
+        } else {
+            blockSize = classSizes[cls];
+            auto &list = threadCache().lists[cls];
+            list.push(reinterpret_cast<FreeBlock *>(block));
+            if (list.count > maxCached[cls]) {
+                flush(cls, list, list.count / 2);
+            }
+        }
+
+        session->bytes.fetch_sub(blockSize, std::memory_order_relaxed);
+        session->count.fetch_sub(1, std::memory_order_relaxed);
+    }
+};
 
 MemoryMgr &MemoryMgr::instance()
 {
@@ -28,14 +406,21 @@ MemoryMgr &MemoryMgr::instance()
     return mgr;
 }
 
-MemoryMgr::MemoryMgr() = default;
+MemoryMgr::MemoryMgr()
+    : m_impl(std::make_unique<Impl>())
+{
+}
 
 MemoryMgr::~MemoryMgr() = default;
 
-void *MemoryMgr::allocate(int alignment, size_t num_bytes)
+void *MemoryMgr::allocate(int alignment, size_t num_bytes, const std::string &session)
 {
-    // TODO: proper memory management
-    auto ptr = mem::alignedAlloc(alignment, num_bytes);
+    if (alignment <= 0 || (alignment & (alignment - 1)) != 0) {
+        LOG(ERROR) << "Invalid alignment " << alignment << " for request of " << num_bytes << " bytes";
+        return nullptr;
+    }
+
+    auto ptr = m_impl->allocate(static_cast<size_t>(alignment), num_bytes, session);
     if (!ptr) {
         LOG(ERROR) << "allocation failed for request: " << num_bytes << " bytes with alignment " << alignment;
     }
@@ -44,6 +429,55 @@ void *MemoryMgr::allocate(int alignment, size_t num_bytes)
 
 void MemoryMgr::deallocate(void *ptr)
 {
-    // TODO: proper memory management
-    mem::alignedFree(ptr);
+    if (!ptr) {
+        return;
+    }
+    m_impl->deallocate(static_cast<char *>(ptr));
+}
+
+MemoryMgr::Stats MemoryMgr::stats() const
+{
+    Stats s;
+    s.reserved = m_impl->reserved.load(std::memory_order_relaxed);
+    {
+        auto g = sstl::with_guard(m_impl->sessMu);
+        for (auto &[session, counters] : m_impl->sessions) {
+            SessionStats ss;
+            ss.session = session;
+            ss.bytes = counters->bytes.load(std::memory_order_relaxed);
+            ss.count = counters->count.load(std::memory_order_relaxed);
+            s.inuse += ss.bytes;
+            s.count += ss.count;
+            if (ss.count) {
+                s.sessions.emplace_back(std::move(ss));
+            }
+        }
+    }
+    s.free = s.reserved > s.inuse ? s.reserved - s.inuse : 0;
+    return s;
+}
+
+std::string MemoryMgr::Stats::DebugString() const
+{
+    std::ostringstream oss;
+    oss << "MemoryMgr::Stats(reserved=" << reserved << ", inuse=" << inuse << ", count=" << count
+        << ", free=" << free << ", sessions=" << sessions.size() << ")";
+    return oss.str();
+}
+
+void MemoryMgr::logStats() const
+{
+    auto s = stats();
+    auto sessions = nlohmann::json::array();
+    for (auto &ss : s.sessions) {
+        sessions.push_back({{"sess", ss.session}, {"bytes", ss.bytes}, {"count", ss.count}});
+    }
+    CLOG(INFO, logging::kPerfTag) << "event: hostmem_stats "
+                                  << nlohmann::json({
+                                         {"reserved", s.reserved},
+                                         {"inuse", s.inuse},
+                                         {"count", s.count},
+                                         {"free", s.free},
+                                         {"sessions", std::move(sessions)},
+                                     });
 }
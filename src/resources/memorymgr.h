@@ -21,22 +21,70 @@
 #define MEMORYMGR_H
 
 #include <cstddef>
+#include <cstdint>
 #include <memory>
+#include <string>
+#include <vector>
 
 /**
- * @todo write docs
+ * @brief Host memory allocator serving Alloc/Dealloc requests from clients.
+ *
+ * Small requests are rounded up to a size class and served from a per-thread cache, which
+ * exchanges blocks with a central free list per class in batches. Large requests are carved
+ * out of arenas mapped with huge pages, keeping freed ranges for reuse. Memory is never
+ * given back to the system.
+ *
+ * Every allocation is accounted to the session requesting it. This class is thread-safe.
  */
 class MemoryMgr
 {
 public:
+    struct SessionStats
+    {
+        std::string session;
+        // bytes of blocks handed out, including rounding
+        size_t bytes = 0;
+        size_t count = 0;
+    };
+
+    struct Stats
+    {
+        // bytes obtained from the system
+        size_t reserved = 0;
+        // bytes of blocks handed out, including rounding
+        size_t inuse = 0;
+        size_t count = 0;
+        // bytes cached by size classes or free in large arenas
+        size_t free = 0;
+        std::vector<SessionStats> sessions;
+
+        std::string DebugString() const;
+    };
+
     static MemoryMgr &instance();
     ~MemoryMgr();
 
-    void *allocate(int alignment, size_t num_bytes);
+    /**
+     * @brief Allocate 'num_bytes' aligned to 'alignment', which must be a power of 2,
+     * accounted to 'session'.
+     * @return the memory, or nullptr if out of memory
+     */
+    void *allocate(int alignment, size_t num_bytes, const std::string &session = {});
     void deallocate(void *ptr);
 
+    Stats stats() const;
+
+    /**
+     * @brief Write current stats to the performance log
+     */
+    void logStats() const;
+
 private:
     MemoryMgr();
+
+    struct Impl;
+
+    std::unique_ptr<Impl> m_impl;
 };
 
 #endif // MEMORYMGR_H
@@ -20,11 +20,15 @@
 #include "resources/resources.h"
 
 #include "platform/logging.h"
+#include "platform/memory.h"
 #include "utils/containerutils.h"
 #include "utils/threadutils.h"
 #include "utils/debugging.h"
 
 #include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <fstream>
 #include <functional>
 #include <sstream>
 #include <tuple>
@@ -59,6 +63,7 @@ ResourceType resourceTypeFromString(const std::string &rt)
         {"COMPUTE", ResourceType::COMPUTE},
         {"MEMORY", ResourceType::MEMORY},
         {"GPU_STREAM", ResourceType::GPU_STREAM},
+        {"EXCLUSIVE", ResourceType::EXCLUSIVE},
     };
 
     auto it = lookup.find(rt);
@@ -105,118 +110,141 @@ std::string ResourceMonitor::DebugString() const
     std::ostringstream oss;
     oss << "ResourceMonitor: dumping available resources" << std::endl;
 
-    auto g = sstl::with_guard(m_mu);
-
+    // Each part is consistent on its own, but may not be consistent with each other
+    Resources avail;
+    for (size_t slot = 0; slot != m_avail.size(); ++slot) {
+        if (auto val = m_avail[slot].avail.load(std::memory_order_acquire)) {
+            avail[resources::tagOf(slot)] = val;
+        }
+    }
     oss << "    Available:" << std::endl;
-    oss << resources::DebugString(m_limits, "        ");
-
-    oss << "    Staging " << m_staging.size() << " tickets, in total:" << std::endl;
-    Resources total;
-    for (auto p : m_staging) {
-        resources::merge(total, p.second);
+    oss << resources::DebugString(avail, "        ");
+
+    Resources staging, inuse;
+    size_t numStaging = 0, numInuse = 0;
+    const auto numRecords = m_numRecords.load(std::memory_order_acquire);
+    for (size_t i = 0; i != numRecords; ++i) {
+        auto &rec = record(i);
+        auto g = sstl::with_guard(rec.mu);
+        if (rec.hasStaging) {
+            ++numStaging;
+            resources::merge(staging, rec.staging);
+        }
+        if (!rec.inuse.empty()) {
+            ++numInuse;
+            resources::merge(inuse, rec.inuse);
+        }
     }
-    oss << resources::DebugString(total, "       ");
 
-    oss << "    In use " << m_using.size() << " tickets, in total:" << std::endl;
-    total.clear();
-    for (auto p : m_using) {
-        resources::merge(total, p.second);
-    }
-    oss << resources::DebugString(total, "       ");
+    oss << "    Staging " << numStaging << " tickets, in total:" << std::endl;
+    oss << resources::DebugString(staging, "       ");
+
+    oss << "    In use " << numInuse << " tickets, in total:" << std::endl;
+    oss << resources::DebugString(inuse, "       ");
 
     return oss.str();
 }
 
 namespace resources {
-bool contains(const Resources &avail, const Resources &req)
+namespace detail {
+void unsupportedTag(const ResourceTag &tag)
 {
-    auto aend = avail.end();
+    LOG(FATAL) << "Resource tag has no slot in Resources: " << tag.DebugString();
+    std::abort();
+}
+} // namespace detail
 
-    ResourceTag tag{};
-    size_t val;
-    for (auto p : req) {
-        std::tie(tag, val) = p;
-        auto it = avail.find(tag);
-        if (it == aend && val != 0) {
-            return false;
-        }
-        if (it == aend) {
-            continue;
-        }
-        if (val > it->second) {
-            return false;
-        }
+namespace {
+using Values = Resources::Values;
+
+/**
+ * @brief Expand bits in `mask` to all-ones or all-zeros lanes, for branch free masking
+ */
+Values expandMask(uint64_t mask)
+{
+    Values lanes;
+    for (size_t i = 0; i != kNumSlots; ++i) {
+        lanes[i] = size_t{0} - ((mask >> i) & 1);
     }
-    return true;
+    return lanes;
 }
+} // namespace
 
-bool compatible(const Resources &lhs, const Resources &rhs)
+bool contains(const Resources &avail, const Resources &req)
 {
-    for (auto p : rhs) {
-        if (lhs.count(p.first) == 0) {
-            return false;
-        }
+    // absent tags have zero amount, so no need to look at presence
+    const auto &a = avail.m_values;
+    const auto &r = req.m_values;
+    // collect the borrow of a - r in the top bit, which vectorizes without unsigned compare instructions
+    size_t borrow = 0;
+    for (size_t i = 0; i != kNumSlots; ++i) {
+        borrow |= (~a[i] & r[i]) | (~(a[i] ^ r[i]) & (a[i] - r[i]));
     }
-    return true;
+    return (borrow >> (sizeof(size_t) * 8 - 1)) == 0;
+}
+
+bool compatible(const Resources &lhs, const Resources &rhs)
+{
+    return (rhs.m_present & ~lhs.m_present) == 0;
 }
 
 Resources &merge(Resources &lhs, const Resources &rhs, bool skipNonExist)
 {
-    for (auto p : rhs) {
-        if (lhs.count(p.first) == 0 && skipNonExist) {
-            continue;
-        }
-        lhs[p.first] += p.second;
+    const auto mask = skipNonExist ? lhs.m_present : ~uint64_t{0};
+    const auto lanes = expandMask(mask);
+    auto &l = lhs.m_values;
+    const auto &r = rhs.m_values;
+    for (size_t i = 0; i != kNumSlots; ++i) {
+        l[i] += r[i] & lanes[i];
     }
+    lhs.m_present |= rhs.m_present & mask;
     return lhs;
 }
 
 Resources &subtract(Resources &lhs, const Resources &rhs, bool skipNonExist)
 {
-    for (auto p : rhs) {
-        if (lhs.count(p.first) == 0 && skipNonExist) {
-            continue;
-        }
-        lhs[p.first] -= p.second;
+    const auto mask = skipNonExist ? lhs.m_present : ~uint64_t{0};
+    const auto lanes = expandMask(mask);
+    auto &l = lhs.m_values;
+    const auto &r = rhs.m_values;
+    for (size_t i = 0; i != kNumSlots; ++i) {
+        l[i] -= r[i] & lanes[i];
     }
+    lhs.m_present |= rhs.m_present & mask;
     return lhs;
 }
 
 Resources subtractBounded(Resources &lhs, const Resources &rhs)
 {
-    const auto lend = lhs.end();
     Resources res;
-    for (auto [tag, val] : rhs) {
-        auto it = lhs.find(tag);
-        if (it == lend) {
-            continue;
-        }
-        auto v = std::min(val, it->second);
-        it->second -= v;
-        res[tag] = v;
+    auto &l = lhs.m_values;
+    const auto &r = rhs.m_values;
+    auto &out = res.m_values;
+    for (size_t i = 0; i != kNumSlots; ++i) {
+        out[i] = std::min(r[i], l[i]);
+        l[i] -= out[i];
     }
+    res.m_present = lhs.m_present & rhs.m_present;
     return res;
 }
 
 Resources &scale(Resources &lhs, double scale)
 {
-    for (auto &p : lhs) {
-        p.second *= scale;
+    auto &l = lhs.m_values;
+    for (size_t i = 0; i != kNumSlots; ++i) {
+        l[i] = static_cast<size_t>(l[i] * scale);
     }
     return lhs;
 }
 
 Resources &removeInvalid(Resources &lhs)
 {
-    auto it = lhs.begin();
-    auto itend = lhs.end();
-    while (it != itend) {
-        if (it->second <= 0) {
-            it = lhs.erase(it);
-        } else {
-            ++it;
-        }
+    const auto &l = lhs.m_values;
+    uint64_t nonzero = 0;
+    for (size_t i = 0; i != kNumSlots; ++i) {
+        nonzero |= uint64_t{l[i] != 0} << i;
     }
+    lhs.m_present &= nonzero;
     return lhs;
 }
 
@@ -229,43 +257,188 @@ std::string DebugString(const Resources &res, const std::string &indent)
     return oss.str();
 }
 
-Resources platformLimits()
+void addGPULimits(Resources &limits, int gpuId, size_t memory)
 {
-    Resources res;
-    res[{ResourceType::MEMORY, devices::CPU0}] = 100_sz * 1024 * 1024 * 1024;
+    DeviceSpec dev{DeviceType::GPU, gpuId};
+    limits[{ResourceType::MEMORY, dev}] = memory;
+    // 128 streams per GPU
+    limits[{ResourceType::GPU_STREAM, dev}] = 128;
+    limits[{ResourceType::EXCLUSIVE, dev}] = 1;
+}
 
-    // 14 G for GPU 0
-    res[{ResourceType::MEMORY, devices::GPU0}] = 14_sz * 1024 * 1024 * 1024;
+namespace {
 
-    // 128 streams for GPU 0
-    res[{ResourceType::GPU_STREAM, devices::GPU0}] = 128;
+struct LimitsRegistry
+{
+    std::mutex mu;
+    std::vector<LimitsProbe> probes GUARDED_BY(mu);
+    std::optional<Resources> fixed GUARDED_BY(mu);
+    Resources overrides GUARDED_BY(mu);
+    std::vector<std::tuple<ResourceType, salus::DeviceType, size_t>> caps GUARDED_BY(mu);
 
-    res[{ResourceType::EXCLUSIVE, devices::GPU0}] = 1;
+    std::once_flag computed;
+    Resources limits;
+};
 
-    return res;
+LimitsRegistry &limitsRegistry()
+{
+    static LimitsRegistry registry;
+    return registry;
 }
 
-} // namespace resources
+Resources probeLimits(const std::vector<LimitsProbe> &probes)
+{
+    Resources limits;
+    auto cpuMemory = mem::physicalMemory();
+    if (cpuMemory == 0) {
+        LOG(WARNING) << "Failed to query physical memory size, assuming 100 GB";
+        cpuMemory = 100_sz * 1024 * 1024 * 1024;
+    }
+    limits[{ResourceType::MEMORY, devices::CPU0}] = cpuMemory;
 
-using namespace resources;
+    for (auto &probe : probes) {
+        probe(limits);
+    }
 
-// Read limits from hardware, and capped by cap
-AllocationRegulator::AllocationRegulator()
+    auto hasGPU = std::any_of(limits.begin(), limits.end(),
+                              [](auto p) { return p.first.device.type == DeviceType::GPU; });
+    if (!hasGPU) {
+        // 14 G for GPU 0
+        LOG(INFO) << "No GPU discovered, assuming one with 14 GB memory";
+        addGPULimits(limits, 0, 14_sz * 1024 * 1024 * 1024);
+    }
+    return limits;
+}
+
+bool parseAmount(const std::string &str, size_t &amount)
 {
-    m_limits = resources::platformLimits();
+    char *end = nullptr;
+    errno = 0;
+    auto val = std::strtoull(str.c_str(), &end, 10);
+    if (errno || end == str.c_str()) {
+        return false;
+    }
+
+    std::string suffix(end);
+    if (suffix == "K") {
+        val <<= 10;
+    } else if (suffix == "M") {
+        val <<= 20;
+    } else if (suffix == "G") {
+        val <<= 30;
+    } else if (!suffix.empty()) {
+        return false;
+    }
+    amount = val;
+    return true;
 }
 
-AllocationRegulator::AllocationRegulator(const Resources &cap)
-    : AllocationRegulator()
+} // namespace
+
+const Resources &platformLimits()
 {
-    auto lend = m_limits.end();
+    auto &reg = limitsRegistry();
+    std::call_once(reg.computed, [&reg]() {
+        auto g = sstl::with_guard(reg.mu);
+        reg.limits = reg.fixed ? *reg.fixed : probeLimits(reg.probes);
+        for (auto [tag, val] : reg.overrides) {
+            if (val == 0) {
+                reg.limits.erase(tag);
+            } else {
+                reg.limits[tag] = val;
+            }
+        }
+        for (auto [type, deviceType, amount] : reg.caps) {
+            for (auto [tag, val] : reg.limits) {
+                if (tag.type == type && tag.device.type == deviceType) {
+                    val = std::min(val, amount);
+                }
+            }
+        }
+        LOG(INFO) << "Platform limits:\n" << DebugString(reg.limits, "    ");
+    });
+    return reg.limits;
+}
 
-    for (auto [tag, val] : cap) {
-        auto it = m_limits.find(tag);
-        if (it != lend) {
-            it->second = std::min(it->second, val);
+void registerLimitsProbe(LimitsProbe probe)
+{
+    auto &reg = limitsRegistry();
+    auto g = sstl::with_guard(reg.mu);
+    reg.probes.emplace_back(std::move(probe));
+}
+
+void overridePlatformLimits(const Resources &overrides)
+{
+    auto &reg = limitsRegistry();
+    auto g = sstl::with_guard(reg.mu);
+    for (auto [tag, val] : overrides) {
+        reg.overrides[tag] = val;
+    }
+}
+
+void capPlatformLimits(ResourceType type, salus::DeviceType deviceType, size_t amount)
+{
+    auto &reg = limitsRegistry();
+    auto g = sstl::with_guard(reg.mu);
+    reg.caps.emplace_back(type, deviceType, amount);
+}
+
+void setPlatformLimits(const Resources &limits)
+{
+    auto &reg = limitsRegistry();
+    auto g = sstl::with_guard(reg.mu);
+    reg.fixed = limits;
+}
+
+std::optional<Resources> loadLimitsFile(const std::string &path)
+{
+    std::ifstream in(path);
+    if (!in) {
+        LOG(ERROR) << "Can't open limits file " << path;
+        return {};
+    }
+
+    Resources res;
+    std::string line;
+    size_t lineno = 0;
+    while (std::getline(in, line)) {
+        ++lineno;
+        std::istringstream iss(line);
+        std::string tagStr, amountStr, rest;
+        if (!(iss >> tagStr) || tagStr[0] == '#') {
+            continue;
+        }
+
+        size_t amount;
+        if (!(iss >> amountStr) || (iss >> rest) || !parseAmount(amountStr, amount)) {
+            LOG(ERROR) << "Malformed limit at " << path << ":" << lineno << ": " << line;
+            return {};
+        }
+
+        auto tag = ResourceTag::fromString(tagStr);
+        if (!hasDeviceSlot(tag.device)) {
+            LOG(ERROR) << "Unsupported device at " << path << ":" << lineno << ": " << tagStr << ", only "
+                       << kMaxCPUs << " CPU and " << kMaxGPUs << " GPU devices can be tracked";
+            return {};
+        }
+        if (!hasSlot(tag)) {
+            LOG(ERROR) << "Unsupported resource at " << path << ":" << lineno << ": " << tagStr;
+            return {};
         }
+        res[tag] = amount;
     }
+    return res;
+}
+
+} // namespace resources
+
+using namespace resources;
+
+void AllocationRegulator::initializeLimits()
+{
+    auto g = sstl::with_guard(m_mu);
+    m_limits = resources::platformLimits();
+    m_total = m_limits;
 }
 
 AllocationRegulator::Ticket AllocationRegulator::registerJob()
@@ -281,13 +454,42 @@ bool AllocationRegulator::Ticket::beginAllocation(const Resources &res)
     {
         auto g = sstl::with_guard(reg->m_mu);
 
-        if (!contains(reg->m_limits, res)) {
+        auto &js = reg->m_jobs[*this];
+
+        // a reservation granted while waiting, give it back and take what is requested now
+        auto granted = !js.granted.empty();
+        if (granted) {
+            merge(reg->m_limits, js.granted);
+            js.granted.clear();
+        }
+
+        // requests waiting ahead go first
+        auto &waiting = reg->m_waiting;
+        auto queued = !granted && !waiting.empty() && !(js.waiting && waiting.front() == *this);
+        if (queued || !contains(reg->m_limits, res)) {
+            if (!js.waker) {
+                return false;
+            }
+            if (!contains(reg->m_total, res)) {
+                LOG(ERROR) << "Allocation hold request can never be fulfilled: ticket=" << as_int << ", res=" << res;
+                return false;
+            }
+            if (!js.waiting) {
+                js.waiting = true;
+                waiting.push_back(*this);
+            }
+            js.pending = res;
             return false;
         }
 
+        if (js.waiting) {
+            js.waiting = false;
+            waiting.remove(*this);
+        }
+
         subtract(reg->m_limits, res);
 
-        merge(reg->m_jobs[*this].inuse, res);
+        merge(js.inuse, res);
     }
     LogAlloc() << "Start session allocation hold: ticket=" << as_int
             << ", res=" << sstl::getOrDefault(res, resources::GPU0Memory, 0);
@@ -295,9 +497,64 @@ bool AllocationRegulator::Ticket::beginAllocation(const Resources &res)
     return true;
 }
 
+bool AllocationRegulator::Ticket::extendAllocation(const Resources &res)
+{
+    {
+        auto g = sstl::with_guard(reg->m_mu);
+        if (!contains(reg->m_limits, res)) {
+            return false;
+        }
+
+        subtract(reg->m_limits, res);
+        merge(reg->m_jobs[*this].inuse, res);
+    }
+    LogAlloc() << "Extend session allocation hold: ticket=" << as_int
+            << ", res=" << sstl::getOrDefault(res, resources::GPU0Memory, 0);
+
+    return true;
+}
+
+void AllocationRegulator::Ticket::setWaker(std::function<void()> cb)
+{
+    auto g = sstl::with_guard(reg->m_mu);
+    reg->m_jobs[*this].waker = std::move(cb);
+}
+
+void AllocationRegulator::Ticket::cancelWaiting()
+{
+    Wakers wakers;
+    {
+        auto g = sstl::with_guard(reg->m_mu);
+
+        auto it = reg->m_jobs.find(*this);
+        if (it == reg->m_jobs.end()) {
+            return;
+        }
+        auto &js = it->second;
+        if (!js.waiting && js.granted.empty()) {
+            return;
+        }
+
+        if (js.waiting) {
+            js.waiting = false;
+            reg->m_waiting.remove(*this);
+        }
+        js.pending.clear();
+        merge(reg->m_limits, js.granted);
+        js.granted.clear();
+
+        // even if nothing is released, the queue head may have changed
+        reg->grantWaiting(wakers);
+    }
+    LogAlloc() << "Cancel waiting session allocation hold: ticket=" << as_int;
+
+    wake(wakers);
+}
+
 void AllocationRegulator::Ticket::endAllocation(const Resources &res)
 {
     Resources released;
+    Wakers wakers;
     {
         auto g = sstl::with_guard(reg->m_mu);
 
@@ -312,18 +569,64 @@ void AllocationRegulator::Ticket::endAllocation(const Resources &res)
 
         removeInvalid(js.inuse);
         merge(reg->m_limits, released);
+
+        if (!removeInvalid(released).empty()) {
+            reg->grantWaiting(wakers);
+        }
     }
     LogAlloc() << "End session allocation hold: ticket=" << as_int
             << ", res=" << sstl::getOrDefault(released, resources::GPU0Memory, 0);
+
+    wake(wakers);
 }
 
 void AllocationRegulator::Ticket::finishJob()
 {
-    auto g = sstl::with_guard(reg->m_mu);
+    Wakers wakers;
+    {
+        auto g = sstl::with_guard(reg->m_mu);
+
+        if (auto it = reg->m_jobs.find(*this); it != reg->m_jobs.end()) {
+            auto &js = it->second;
+            if (js.waiting) {
+                reg->m_waiting.remove(*this);
+            }
+            merge(reg->m_limits, js.inuse);
+            merge(reg->m_limits, js.granted);
+            reg->m_jobs.erase(it);
+
+            // even if nothing is released, the queue head may have changed
+            reg->grantWaiting(wakers);
+        }
+    }
+
+    wake(wakers);
+}
+
+void AllocationRegulator::grantWaiting(Wakers &wakers)
+{
+    while (!m_waiting.empty()) {
+        auto &js = m_jobs[m_waiting.front()];
+        if (!contains(m_limits, js.pending)) {
+            break;
+        }
+
+        subtract(m_limits, js.pending);
+        js.granted = std::move(js.pending);
+        js.pending.clear();
+        js.waiting = false;
+        m_waiting.pop_front();
+
+        if (js.waker) {
+            wakers.emplace_back(js.waker);
+        }
+    }
+}
 
-    if (auto it = reg->m_jobs.find(*this); it != reg->m_jobs.end()) {
-        merge(reg->m_limits, it->second.inuse);
-        reg->m_jobs.erase(it);
+/*static*/ void AllocationRegulator::wake(const Wakers &wakers)
+{
+    for (auto &waker : wakers) {
+        waker();
     }
 }
 
@@ -334,6 +637,7 @@ std::string AllocationRegulator::DebugString() const
     std::ostringstream oss;
 
     oss << "AllocationRegulator(Free:" << m_limits << std::endl;
+    oss << "    Waiting tickets: " << m_waiting.size() << std::endl;
     oss << "    Issued tickets:" << std::endl;
     for (const auto &[ticket, state] : m_jobs) {
         oss << "      " << ticket.as_int << " -> " << state.inuse;
@@ -344,51 +648,242 @@ std::string AllocationRegulator::DebugString() const
 
 void ResourceMonitor::initializeLimits()
 {
-    auto g = sstl::with_guard(m_mu);
-
-    m_limits = resources::platformLimits();
+    initializeLimits({});
 }
 
 void ResourceMonitor::initializeLimits(const Resources &cap)
 {
-    initializeLimits();
+    auto limits = resources::platformLimits();
+    for (auto [tag, val] : cap) {
+        auto it = limits.find(tag);
+        if (it != limits.end()) {
+            it->second = std::min(it->second, val);
+        }
+    }
 
-    auto g = sstl::with_guard(m_mu);
+    for (auto &c : m_avail) {
+        c.avail.store(0, std::memory_order_relaxed);
+    }
+    for (auto [tag, val] : limits) {
+        m_avail[slotOf(tag)].avail.store(val, std::memory_order_release);
+    }
+}
+
+bool ResourceMonitor::take(const Resources &req, Resources *missing)
+{
+    Resources taken;
+    bool ok = true;
+    for (auto [tag, amount] : req) {
+        if (amount == 0) {
+            continue;
+        }
+        auto &avail = m_avail[slotOf(tag)].avail;
+        auto cur = avail.load(std::memory_order_relaxed);
+        do {
+            if (cur < amount) {
+                ok = false;
+                break;
+            }
+        } while (!avail.compare_exchange_weak(cur, cur - amount, std::memory_order_acq_rel,
+                                              std::memory_order_relaxed));
+        if (!ok) {
+            break;
+        }
+        taken[tag] = amount;
+    }
 
-    auto lend = m_limits.end();
+    if (ok) {
+        return true;
+    }
 
-    ResourceTag tag{};
-    size_t val;
-    for (auto p : cap) {
-        std::tie(tag, val) = p;
-        auto it = m_limits.find(tag);
-        if (it != lend) {
-            it->second = std::min(it->second, val);
+    // Roll back. Others may have failed seeing what we took, let them retry.
+    if (!taken.empty()) {
+        giveBack(taken);
+        notifyReleased();
+    }
+
+    if (missing) {
+        missing->clear();
+        for (auto [tag, amount] : req) {
+            auto avail = m_avail[slotOf(tag)].avail.load(std::memory_order_relaxed);
+            if (amount > avail) {
+                (*missing)[tag] = amount - avail;
+            }
         }
     }
+    return false;
+}
+
+Resources ResourceMonitor::takeUpTo(const Resources &req)
+{
+    Resources taken;
+    for (auto [tag, amount] : req) {
+        auto &avail = m_avail[slotOf(tag)].avail;
+        auto cur = avail.load(std::memory_order_relaxed);
+        size_t got;
+        do {
+            got = std::min(cur, amount);
+        } while (got && !avail.compare_exchange_weak(cur, cur - got, std::memory_order_acq_rel,
+                                                     std::memory_order_relaxed));
+        taken[tag] = got;
+    }
+    return taken;
+}
+
+void ResourceMonitor::giveBack(const Resources &res)
+{
+    for (auto [tag, amount] : res) {
+        if (amount) {
+            m_avail[slotOf(tag)].avail.fetch_add(amount, std::memory_order_acq_rel);
+        }
+    }
+}
+
+ResourceMonitor::~ResourceMonitor()
+{
+    for (auto &chunk : m_chunks) {
+        delete[] chunk.load(std::memory_order_acquire);
+    }
+}
+
+uint64_t ResourceMonitor::newTicket(const Resources *staging)
+{
+    // reuse a free record if any...
+    std::optional<size_t> index;
+    auto head = m_freeHead.load(std::memory_order_acquire);
+    while (static_cast<uint32_t>(head) != 0) {
+        auto idx = static_cast<uint32_t>(head) - 1;
+        auto next = record(idx).nextFree.load(std::memory_order_relaxed);
+        auto newHead = (((head >> 32) + 1) << 32) | next;
+        if (m_freeHead.compare_exchange_weak(head, newHead, std::memory_order_acq_rel,
+                                             std::memory_order_acquire)) {
+            index = idx;
+            break;
+        }
+    }
+
+    // ... otherwise take a new one from the slab
+    if (!index) {
+        auto g = sstl::with_guard(m_growMu);
+        auto idx = m_numRecords.load(std::memory_order_relaxed);
+        auto chunk = idx / kChunkSize;
+        CHECK_LT(chunk, kMaxChunks) << "Too many tickets in use";
+        if (!m_chunks[chunk].load(std::memory_order_relaxed)) {
+            m_chunks[chunk].store(new Record[kChunkSize], std::memory_order_release);
+        }
+        m_numRecords.store(idx + 1, std::memory_order_release);
+        index = idx;
+    }
+
+    auto &rec = record(*index);
+    auto g = sstl::with_guard(rec.mu);
+    rec.refs = 1;
+    rec.hasStaging = staging != nullptr;
+    rec.staging = staging ? *staging : Resources{};
+    rec.inuse.clear();
+    return makeTicket(*index, rec.generation);
+}
+
+void ResourceMonitor::maybeRecycle(Record &rec, uint64_t ticket)
+{
+    if (rec.refs > 0 || rec.hasStaging || !rec.inuse.empty()) {
+        return;
+    }
+
+    // invalidate the ticket, then put the record to the free list
+    ++rec.generation;
+    auto index = indexOf(ticket);
+    auto head = m_freeHead.load(std::memory_order_acquire);
+    uint64_t newHead;
+    do {
+        rec.nextFree.store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+        newHead = (((head >> 32) + 1) << 32) | (index + 1);
+    } while (!m_freeHead.compare_exchange_weak(head, newHead, std::memory_order_acq_rel,
+                                               std::memory_order_acquire));
+}
+
+void ResourceMonitor::retainTicket(uint64_t ticket)
+{
+    auto &rec = recordOf(ticket);
+    auto g = sstl::with_guard(rec.mu);
+    if (!isCurrent(rec, ticket)) {
+        LOG(ERROR) << "Retaining released ticket " << ticket;
+        return;
+    }
+    ++rec.refs;
+}
+
+void ResourceMonitor::releaseTicket(uint64_t ticket)
+{
+    auto &rec = recordOf(ticket);
+    auto g = sstl::with_guard(rec.mu);
+    if (!isCurrent(rec, ticket)) {
+        LOG(ERROR) << "Releasing released ticket " << ticket;
+        return;
+    }
+    DCHECK_GT(rec.refs, 0);
+    --rec.refs;
+    maybeRecycle(rec, ticket);
 }
 
 std::optional<uint64_t> ResourceMonitor::preAllocate(const Resources &req, Resources *missing)
 {
     // TODO: check ticket
 
-    auto g = sstl::with_guard(m_mu);
-    if (!contains(m_limits, req)) {
+    if (!take(req, missing)) {
+        return {};
+    }
+
+    return newTicket(&req);
+}
+
+size_t ResourceMonitor::preAllocateBatch(std::vector<PreAllocRequest> &reqs)
+{
+    size_t succeeded = 0;
+
+    for (auto &r : reqs) {
+        DCHECK(r.req);
+        r.ticket = preAllocate(*r.req, &r.missing);
+        if (r.ticket) {
+            ++succeeded;
+        }
+    }
+    return succeeded;
+}
+
+bool ResourceMonitor::reserveUpTo(uint64_t &ticket, const Resources &target, Resources *missing)
+{
+    if (ticket == 0) {
+        Resources empty;
+        ticket = newTicket(&empty);
+    }
+
+    auto &rec = recordOf(ticket);
+    auto g = sstl::with_guard(rec.mu);
+    if (!isCurrent(rec, ticket)) {
+        LOG(ERROR) << "Reserving on released ticket " << ticket;
         if (missing) {
-            *missing = req;
-            subtract(*missing, m_limits, true /* skipNonExist */);
-            removeInvalid(*missing);
+            *missing = target;
         }
-        return {};
+        return false;
     }
+    rec.hasStaging = true;
+    auto &staging = rec.staging;
 
-    auto ticket = ++m_nextTicket;
+    // staging only grows up to target, so this never goes below zero
+    Resources lacking(target);
+    subtract(lacking, staging, true /* skipNonExist */);
+    removeInvalid(lacking);
 
-    // Allocate
-    subtract(m_limits, req);
-    m_staging[ticket] = req;
+    auto granted = takeUpTo(lacking);
+    merge(staging, granted);
+    subtract(lacking, granted);
+    removeInvalid(lacking);
 
-    return ticket;
+    if (missing) {
+        *missing = lacking;
+    }
+    return lacking.empty();
 }
 
 bool ResourceMonitor::allocate(uint64_t ticket, const Resources &res)
@@ -398,8 +893,9 @@ bool ResourceMonitor::allocate(uint64_t ticket, const Resources &res)
         return false;
     }
 
-    auto g = sstl::with_uguard(m_mu);
-    return allocateUnsafe(ticket, res);
+    auto &rec = recordOf(ticket);
+    auto g = sstl::with_guard(rec.mu);
+    return allocateUnsafe(rec, ticket, res);
 }
 
 bool ResourceMonitor::LockedProxy::allocate(uint64_t ticket, const Resources &res)
@@ -409,48 +905,40 @@ bool ResourceMonitor::LockedProxy::allocate(uint64_t ticket, const Resources &re
         LOG(ERROR) << "Invalid ticket 0";
         return false;
     }
+    DCHECK_EQ(ticket, m_ticket);
 
-    return m_resMonitor->allocateUnsafe(ticket, res);
+    return m_resMonitor->allocateUnsafe(m_resMonitor->recordOf(ticket), ticket, res);
 }
 
-bool ResourceMonitor::allocateUnsafe(uint64_t ticket, const Resources &res)
+bool ResourceMonitor::allocateUnsafe(Record &rec, uint64_t ticket, const Resources &res)
 {
-    auto remaining(res);
-    auto it = m_staging.find(ticket);
-    if (it != m_staging.end()) {
-        // first try allocate from reserve
-        if (contains(it->second, remaining)) {
-            subtract(it->second, remaining);
-            merge(m_using[ticket], remaining);
-            return true;
-        }
-
-        // pre-allocation is not enough, see how much we need
-        // to request from global avail...
-        subtract(remaining, it->second, true /*skipNonExist*/);
+    if (!isCurrent(rec, ticket)) {
+        LOG(ERROR) << "Allocating on released ticket " << ticket;
+        return false;
     }
 
+    // first try allocate from reserve...
+    auto remaining(res);
+    Resources fromStaging;
+    if (rec.hasStaging) {
+        auto staging = rec.staging;
+        fromStaging = subtractBounded(staging, res);
+        subtract(remaining, fromStaging);
+    }
     removeInvalid(remaining);
 
-    // ... then try from global avail
-    if (!contains(m_limits, remaining)) {
+    // ... then try from global avail for what the reserve is short of
+    if (!remaining.empty() && !take(remaining, nullptr)) {
         return false;
     }
 
-    if (it != m_staging.end()) {
-        // actual subtract from staging
-        auto fromStaging(res);
-        subtract(fromStaging, remaining);
-        removeInvalid(fromStaging);
-        assert(contains(it->second, fromStaging));
-        subtract(it->second, fromStaging);
+    if (rec.hasStaging) {
+        subtract(rec.staging, fromStaging);
     }
 
-    // actual subtract from global
-    subtract(m_limits, remaining);
-
     // add to used
-    merge(m_using[ticket], res);
+    merge(rec.inuse, res);
+    removeInvalid(rec.inuse);
 
     return true;
 }
@@ -463,63 +951,84 @@ void ResourceMonitor::freeStaging(uint64_t ticket)
         return;
     }
 
-    auto g = sstl::with_uguard(m_mu);
+    Resources staging;
+    {
+        auto &rec = recordOf(ticket);
+        auto g = sstl::with_uguard(rec.mu);
 
-    auto it = m_staging.find(ticket);
-    if (it == m_staging.end()) {
-        g.unlock();
-        LOG(ERROR) << "Unknown ticket for freeStaging: " << ticket;
-        return;
+        if (!isCurrent(rec, ticket) || !rec.hasStaging) {
+            g.unlock();
+            LOG(ERROR) << "Unknown ticket for freeStaging: " << ticket;
+            return;
+        }
+        staging = rec.staging;
+        rec.staging.clear();
+        rec.hasStaging = false;
+        maybeRecycle(rec, ticket);
     }
 
-    merge(m_limits, it->second);
-    m_staging.erase(it);
+    giveBack(staging);
+    notifyReleased();
 }
 
 bool ResourceMonitor::free(uint64_t ticket, const Resources &res)
 {
-    auto g = sstl::with_guard(m_mu);
-    return freeUnsafe(ticket, res);
+    bool last;
+    {
+        auto &rec = recordOf(ticket);
+        auto g = sstl::with_guard(rec.mu);
+        last = freeUnsafe(rec, ticket, res);
+    }
+    notifyReleased();
+    return last;
 }
 
 bool ResourceMonitor::LockedProxy::free(uint64_t ticket, const Resources &res)
 {
     assert(m_resMonitor);
-    return m_resMonitor->freeUnsafe(ticket, res);
+    DCHECK_EQ(ticket, m_ticket);
+    m_released = true;
+    return m_resMonitor->freeUnsafe(m_resMonitor->recordOf(ticket), ticket, res);
 }
 
 std::optional<Resources> ResourceMonitor::LockedProxy::queryStaging(uint64_t ticket) const
 {
-    DCHECK(m_resMonitor);
-    return m_resMonitor->queryStagingUnsafe(ticket);
+    assert(m_resMonitor);
+    DCHECK_EQ(ticket, m_ticket);
+    return m_resMonitor->queryStagingUnsafe(m_resMonitor->recordOf(ticket), ticket);
 }
 
-bool ResourceMonitor::freeUnsafe(uint64_t ticket, const Resources &res)
+bool ResourceMonitor::freeUnsafe(Record &rec, uint64_t ticket, const Resources &res)
 {
     // Ticket can not be 0 when free actual resource to prevent
     // monitor go out of sync of physical usage.
     DCHECK_NE(ticket, 0);
 
-    merge(m_limits, res);
+    giveBack(res);
 
-    auto it = m_using.find(ticket);
-    DCHECK_NE(it, m_using.end());
+    if (!isCurrent(rec, ticket)) {
+        LOG(ERROR) << "Freeing on released ticket " << ticket;
+        return true;
+    }
 
-    DCHECK(contains(it->second, res));
+    DCHECK(contains(rec.inuse, res));
 
-    subtract(it->second, res);
-    removeInvalid(it->second);
-    if (it->second.empty()) {
-        m_using.erase(it);
+    subtract(rec.inuse, res);
+    removeInvalid(rec.inuse);
+    if (rec.inuse.empty()) {
+        maybeRecycle(rec, ticket);
         return true;
     }
     return false;
 }
 
-std::optional<Resources> ResourceMonitor::queryStagingUnsafe(uint64_t ticket) const
+std::optional<Resources> ResourceMonitor::queryStagingUnsafe(const Record &rec, uint64_t ticket) const
 {
     DCHECK_NE(ticket, 0);
-    return sstl::optionalGet(m_staging, ticket);
+    if (!isCurrent(rec, ticket) || !rec.hasStaging) {
+        return {};
+    }
+    return rec.staging;
 }
 
 std::vector<std::pair<size_t, uint64_t>> ResourceMonitor::sortVictim(
@@ -532,19 +1041,20 @@ std::vector<std::pair<size_t, uint64_t>> ResourceMonitor::sortVictim(
 
     // TODO: currently only select based on GPU memory usage, generalize to all resources
     ResourceTag tag{ResourceType::MEMORY, devices::GPU0};
-    {
-        auto g = sstl::with_guard(m_mu);
-        for (auto &ticket : candidates) {
-            auto usagemap = sstl::optionalGet(m_using, ticket);
-            if (!usagemap) {
-                continue;
-            }
-            auto gpuusage = sstl::optionalGet(usagemap, tag);
-            if (!gpuusage || *gpuusage == 0) {
+    for (auto &ticket : candidates) {
+        size_t gpuusage;
+        {
+            auto &rec = recordOf(ticket);
+            auto g = sstl::with_guard(rec.mu);
+            if (!isCurrent(rec, ticket)) {
                 continue;
             }
-            usages.emplace_back(*gpuusage, ticket);
+            gpuusage = sstl::getOrDefault(rec.inuse, tag, 0);
         }
+        if (gpuusage == 0) {
+            continue;
+        }
+        usages.emplace_back(gpuusage, ticket);
     }
 
     std::sort(usages.begin(), usages.end(), [](const auto &lhs, const auto &rhs) {
@@ -555,22 +1065,30 @@ std::vector<std::pair<size_t, uint64_t>> ResourceMonitor::sortVictim(
 
 Resources ResourceMonitor::queryUsages(const std::unordered_set<uint64_t> &tickets) const
 {
-    auto g = sstl::with_guard(m_mu);
     Resources res;
     for (auto t : tickets) {
-        merge(res, sstl::getOrDefault(m_using, t, {}));
+        auto &rec = recordOf(t);
+        auto g = sstl::with_guard(rec.mu);
+        if (isCurrent(rec, t)) {
+            merge(res, rec.inuse);
+        }
     }
     return res;
 }
 
 optional<Resources> ResourceMonitor::queryUsage(uint64_t ticket) const
 {
-    auto g = sstl::with_guard(m_mu);
-    return sstl::optionalGet(m_using, ticket);
+    auto &rec = recordOf(ticket);
+    auto g = sstl::with_guard(rec.mu);
+    if (!isCurrent(rec, ticket) || rec.inuse.empty()) {
+        return {};
+    }
+    return rec.inuse;
 }
 
 bool ResourceMonitor::hasUsage(uint64_t ticket) const
 {
-    auto g = sstl::with_guard(m_mu);
-    return m_using.count(ticket) > 0;
+    auto &rec = recordOf(ticket);
+    auto g = sstl::with_guard(rec.mu);
+    return isCurrent(rec, ticket) && !rec.inuse.empty();
 }
@@ -26,12 +26,19 @@
 #include "utils/threadutils.h"
 #include "platform/thread_annotations.h"
 
+#include <array>
+#include <atomic>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
 #include <list>
 #include <mutex>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
 #include <optional>
+#include <type_traits>
+#include <utility>
 
 enum class ResourceType
 {
@@ -93,7 +100,270 @@ public:
 };
 } // namespace std
 
-using Resources = std::unordered_map<ResourceTag, size_t>;
+class Resources;
+
+namespace resources {
+// Devices with a slot in Resources. Tags on other devices can't be stored.
+constexpr int kMaxCPUs = 1;
+constexpr int kMaxGPUs = 4;
+constexpr size_t kNumDeviceSlots = kMaxCPUs + kMaxGPUs;
+constexpr size_t kNumTypeSlots = static_cast<size_t>(ResourceType::EXCLUSIVE) + 1;
+constexpr size_t kNumSlots = kNumTypeSlots * kNumDeviceSlots;
+static_assert(kNumSlots <= 64, "Presence of slots is tracked in a 64 bit mask");
+
+constexpr bool hasDeviceSlot(const salus::DeviceSpec &dev)
+{
+    if (dev.id < 0) {
+        return false;
+    }
+    return dev.type == salus::DeviceType::CPU ? dev.id < kMaxCPUs : dev.id < kMaxGPUs;
+}
+
+constexpr bool hasSlot(const ResourceTag &tag)
+{
+    return static_cast<size_t>(tag.type) < kNumTypeSlots && hasDeviceSlot(tag.device);
+}
+
+/**
+ * @brief Index of `tag` in Resources. Only valid if hasSlot(tag).
+ */
+constexpr size_t slotOf(const ResourceTag &tag)
+{
+    auto dev = static_cast<size_t>(tag.device.id) + (tag.device.type == salus::DeviceType::CPU ? 0 : kMaxCPUs);
+    return static_cast<size_t>(tag.type) * kNumDeviceSlots + dev;
+}
+
+constexpr ResourceTag tagOf(size_t slot)
+{
+    auto type = static_cast<ResourceType>(slot / kNumDeviceSlots);
+    auto dev = static_cast<int>(slot % kNumDeviceSlots);
+    if (dev < kMaxCPUs) {
+        return {type, salus::DeviceSpec{salus::DeviceType::CPU, dev}};
+    }
+    return {type, salus::DeviceSpec{salus::DeviceType::GPU, dev - kMaxCPUs}};
+}
+
+bool contains(const Resources &avail, const Resources &req);
+bool compatible(const Resources &lhs, const Resources &rhs);
+Resources &removeInvalid(Resources &lhs);
+Resources &merge(Resources &lhs, const Resources &rhs, bool skipNonExist);
+Resources &subtract(Resources &lhs, const Resources &rhs, bool skipNonExist);
+Resources subtractBounded(Resources &lhs, const Resources &rhs);
+Resources &scale(Resources &lhs, double scale);
+
+namespace detail {
+[[noreturn]] void unsupportedTag(const ResourceTag &tag);
+} // namespace detail
+} // namespace resources
+
+/**
+ * @brief Amount of each type of resource on each device.
+ *
+ * Amounts are stored densely in a fixed slot per tag, see resources::slotOf, so set operations in
+ * namespace resources are element-wise loops over all slots, which the compiler vectorizes.
+ *
+ * The interface is what's used of the std::unordered_map it replaces, and a tag may still be present
+ * with zero amount. Amounts of absent tags are always zero.
+ */
+class Resources
+{
+public:
+    using key_type = ResourceTag;
+    using mapped_type = size_t;
+    using Values = std::array<size_t, resources::kNumSlots>;
+
+    /**
+     * @brief Iterates over present tags, dereferences to a pair of tag and reference to the amount
+     */
+    template<bool Const>
+    class Iter
+    {
+        using Owner = std::conditional_t<Const, const Resources, Resources>;
+        using Amount = std::conditional_t<Const, const size_t, size_t>;
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::pair<ResourceTag, Amount &>;
+        using difference_type = std::ptrdiff_t;
+        using reference = value_type;
+
+        struct pointer
+        {
+            value_type p;
+            const value_type *operator->() const
+            {
+                return &p;
+            }
+        };
+
+        Iter() = default;
+        Iter(Owner *owner, size_t slot)
+            : m_owner(owner)
+            , m_slot(slot)
+        {
+        }
+        template<bool C = Const, typename = std::enable_if_t<C>>
+        Iter(const Iter<false> &other) // NOLINT(google-explicit-constructor)
+            : m_owner(other.m_owner)
+            , m_slot(other.m_slot)
+        {
+        }
+
+        reference operator*() const
+        {
+            return {resources::tagOf(m_slot), m_owner->m_values[m_slot]};
+        }
+
+        pointer operator->() const
+        {
+            return {**this};
+        }
+
+        Iter &operator++()
+        {
+            m_slot = m_owner->nextPresent(m_slot + 1);
+            return *this;
+        }
+
+        Iter operator++(int)
+        {
+            auto tmp = *this;
+            ++*this;
+            return tmp;
+        }
+
+        bool operator==(const Iter &rhs) const
+        {
+            return m_slot == rhs.m_slot;
+        }
+
+        bool operator!=(const Iter &rhs) const
+        {
+            return m_slot != rhs.m_slot;
+        }
+
+    private:
+        friend class Resources;
+        friend class Iter<true>;
+
+        Owner *m_owner = nullptr;
+        size_t m_slot = resources::kNumSlots;
+    };
+    using iterator = Iter<false>;
+    using const_iterator = Iter<true>;
+
+    Resources() = default;
+
+    Resources(std::initializer_list<std::pair<const ResourceTag, size_t>> init)
+    {
+        for (const auto &[tag, val] : init) {
+            (*this)[tag] = val;
+        }
+    }
+
+    iterator begin()
+    {
+        return {this, nextPresent(0)};
+    }
+    iterator end()
+    {
+        return {this, resources::kNumSlots};
+    }
+    const_iterator begin() const
+    {
+        return {this, nextPresent(0)};
+    }
+    const_iterator end() const
+    {
+        return {this, resources::kNumSlots};
+    }
+
+    iterator find(const ResourceTag &tag)
+    {
+        return {this, present(tag) ? resources::slotOf(tag) : resources::kNumSlots};
+    }
+    const_iterator find(const ResourceTag &tag) const
+    {
+        return {this, present(tag) ? resources::slotOf(tag) : resources::kNumSlots};
+    }
+
+    size_t count(const ResourceTag &tag) const
+    {
+        return present(tag) ? 1 : 0;
+    }
+
+    size_t &operator[](const ResourceTag &tag)
+    {
+        if (SALUS_PREDICT_FALSE(!resources::hasSlot(tag))) {
+            resources::detail::unsupportedTag(tag);
+        }
+        auto slot = resources::slotOf(tag);
+        m_present |= bit(slot);
+        return m_values[slot];
+    }
+
+    iterator erase(iterator it)
+    {
+        m_values[it.m_slot] = 0;
+        m_present &= ~bit(it.m_slot);
+        return {this, nextPresent(it.m_slot + 1)};
+    }
+    size_t erase(const ResourceTag &tag)
+    {
+        if (!present(tag)) {
+            return 0;
+        }
+        erase(find(tag));
+        return 1;
+    }
+
+    bool empty() const
+    {
+        return m_present == 0;
+    }
+
+    size_t size() const
+    {
+        return static_cast<size_t>(__builtin_popcountll(m_present));
+    }
+
+    void clear()
+    {
+        m_values.fill(0);
+        m_present = 0;
+    }
+
+private:
+    friend bool resources::contains(const Resources &avail, const Resources &req);
+    friend bool resources::compatible(const Resources &lhs, const Resources &rhs);
+    friend Resources &resources::removeInvalid(Resources &lhs);
+    friend Resources &resources::merge(Resources &lhs, const Resources &rhs, bool skipNonExist);
+    friend Resources &resources::subtract(Resources &lhs, const Resources &rhs, bool skipNonExist);
+    friend Resources resources::subtractBounded(Resources &lhs, const Resources &rhs);
+    friend Resources &resources::scale(Resources &lhs, double scale);
+
+    static constexpr uint64_t bit(size_t slot)
+    {
+        return uint64_t{1} << slot;
+    }
+
+    bool present(const ResourceTag &tag) const
+    {
+        return resources::hasSlot(tag) && (m_present & bit(resources::slotOf(tag)));
+    }
+
+    size_t nextPresent(size_t slot) const
+    {
+        if (slot >= resources::kNumSlots) {
+            return resources::kNumSlots;
+        }
+        auto rest = m_present >> slot;
+        return rest ? slot + static_cast<size_t>(__builtin_ctzll(rest)) : resources::kNumSlots;
+    }
+
+    Values m_values{};
+    uint64_t m_present = 0;
+};
 
 namespace resources {
 /**
@@ -158,6 +428,59 @@ Resources &scale(Resources &lhs, double scale);
 
 std::string DebugString(const Resources &res, const std::string &indent = "");
 
+/**
+ * @brief Resources available on this machine.
+ *
+ * Computed once on first use: registered probes fill in what they discover from
+ * hardware, then overrides replace individual tags and caps are applied. Consumers
+ * should read limits only after all probes, overrides and caps are set up.
+ */
+const Resources &platformLimits();
+
+/**
+ * @brief A probe filling in limits for devices it knows how to discover
+ */
+using LimitsProbe = std::function<void(Resources &limits)>;
+
+/**
+ * @brief Register a probe to be run when limits are first computed.
+ * Registering after that has no effect on already computed limits.
+ */
+void registerLimitsProbe(LimitsProbe probe);
+
+/**
+ * @brief Replace limits for tags present in 'overrides' after probing.
+ * A value of 0 removes the resource.
+ */
+void overridePlatformLimits(const Resources &overrides);
+
+/**
+ * @brief Cap limits of 'type' on every device of 'deviceType' at 'amount', after probing
+ * and overrides. Useful to simulate smaller devices without knowing how many there are.
+ */
+void capPlatformLimits(ResourceType type, salus::DeviceType deviceType, size_t amount);
+
+/**
+ * @brief Use exactly 'limits' instead of probing hardware, e.g. to simulate
+ * a different topology. Overrides are still applied on top of it.
+ */
+void setPlatformLimits(const Resources &limits);
+
+/**
+ * @brief Fill in limits for GPU 'gpuId' having 'memory' bytes usable
+ */
+void addGPULimits(Resources &limits, int gpuId, size_t memory);
+
+/**
+ * @brief Read limit overrides from file at 'path'.
+ *
+ * Each line is `<type>:<device> <amount>`, e.g. `MEMORY:GPU:1 8G`. Amounts may
+ * have a K, M or G suffix. Empty lines and lines starting with '#' are ignored.
+ *
+ * @return the overrides, or an empty optional if the file can not be parsed
+ */
+std::optional<Resources> loadLimitsFile(const std::string &path);
+
 // some handy constant
 constexpr ResourceTag CPU0Memory {ResourceType::MEMORY, salus::devices::CPU0};
 constexpr ResourceTag GPU0Memory {ResourceType::MEMORY, salus::devices::GPU0};
@@ -213,12 +536,40 @@ public:
          * @brief Start an allocation phase using a ticket. Making sure
          * at least 'cap' resource is available or will be available
          * for allocation without deadlocking
+         *
+         * Requests are served in order. If the request can not be fulfilled now, and the
+         * ticket has a waker, the ticket waits in queue. Once enough is released for it,
+         * the request is reserved on its behalf and the waker is called, so calling
+         * this again succeeds.
+         *
          * @param cap
          * @return the allocation ticket, or an empty optional if the request
          * can not be fulfilled
          */
         bool beginAllocation(const Resources &res);
 
+        /**
+         * @brief Add `res` to the holding resources of the current allocation phase, if available now.
+         *
+         * Unlike beginAllocation, this never waits and goes ahead of waiting requests, as it's for
+         * an allocation phase that is already running and needs more than it asked for.
+         * @return whether `res` is now held
+         */
+        bool extendAllocation(const Resources &res);
+
+        /**
+         * @brief Set the callback to call when a waiting request of this ticket is granted.
+         * The callback is called without holding any lock.
+         */
+        void setWaker(std::function<void()> cb);
+
+        /**
+         * @brief Withdraw the waiting request of this ticket, e.g. when the iteration that made it
+         * is dropped. Anything already granted to the request is given back, and later requests
+         * are tried again. Does nothing if the ticket has no waiting or granted request.
+         */
+        void cancelWaiting();
+
         /**
          * @brief Stop current allocation phase, releasing 'res' amount of holding resources.
          *
@@ -230,7 +581,7 @@ public:
 
         /**
          * @brief Finish the use of the ticket, releasing any remaining resources
-         * associated with the ticket.
+         * associated with the ticket, and leave the wait queue.
          * @param ticket
          */
         void finishJob();
@@ -244,12 +595,17 @@ public:
         AllocationRegulator *reg;
     };
 
-    AllocationRegulator();
-    // Read limits from hardware, and capped by cap
-    explicit AllocationRegulator(const Resources &cap);
+    AllocationRegulator() = default;
 
     ~AllocationRegulator() = default;
 
+    /**
+     * @brief Read limits from hardware.
+     *
+     * Must be called before any ticket is issued.
+     */
+    void initializeLimits();
+
     /**
      * @brief Register and get a ticket that can be used to start
      * allocation phases
@@ -259,15 +615,34 @@ public:
     std::string DebugString() const;
 
 private:
+    using Wakers = std::vector<std::function<void()>>;
+
+    /**
+     * @brief Grant waiting requests in order as long as they fit, collecting wakers to call
+     * once the lock is released.
+     */
+    void grantWaiting(Wakers &wakers) EXCLUSIVE_LOCKS_REQUIRED(m_mu);
+
+    static void wake(const Wakers &wakers);
+
     mutable std::mutex m_mu;
 
     uint64_t m_next = 0 GUARDED_BY(m_mu);
 
     Resources m_limits GUARDED_BY(m_mu);
+    Resources m_total GUARDED_BY(m_mu);
 
     struct JobState
     {
         Resources inuse;
+        std::function<void()> waker;
+
+        // a request waiting in queue
+        bool waiting = false;
+        Resources pending;
+
+        // reserved for the waiting request, but not taken by it yet
+        Resources granted;
     };
 
     struct TicketHasher
@@ -280,15 +655,34 @@ private:
     };
 
     std::unordered_map<Ticket, JobState, TicketHasher> m_jobs GUARDED_BY(m_mu);
+
+    std::list<Ticket> m_waiting GUARDED_BY(m_mu);
 };
 
 /**
  * A monitor of resources. This class is thread-safe.
+ *
+ * Available amounts are kept in one atomic counter per slot of Resources, i.e. per resource type and
+ * device, and reserved with compare-and-swap without any lock. Staging and in-use resources of each
+ * ticket are kept in a record with its own lock, in a slab indexed by the ticket.
+ *
+ * A ticket is the index of its record and the generation of the record when it was issued. A record
+ * is recycled once its ticket is released by every holder and no longer holds any resources, after
+ * which the old ticket is reported as holding nothing.
+ *
+ * A reservation taking several slots may see another one partially applied and fail, while it would
+ * have succeeded if both were serialized. Anything rolled back triggers the release callback, so a
+ * failed request is retried.
  */
 class ResourceMonitor
 {
+    struct Record;
+
 public:
     ResourceMonitor() = default;
+    ~ResourceMonitor();
+
+    SALUS_DISALLOW_COPY_AND_ASSIGN(ResourceMonitor);
 
     /**
      * @brief Read limits from hardware
@@ -305,10 +699,48 @@ public:
      * @param req Requested resources to pre-allocate
      * @param missing If not null, contains missing resources that would have make the allocation succeed. Ignored when
      * the allocation succeed.
-     * @return An ticket when the pre-allocation succeed, otherwise empty.
+     * @return An ticket when the pre-allocation succeed, otherwise empty. The caller holds the ticket
+     * until it calls releaseTicket, or passes it to a ResourceContext.
      */
     std::optional<uint64_t> preAllocate(const Resources &req, Resources *missing);
 
+    /**
+     * @brief One entry in a batch pre-allocation
+     */
+    struct PreAllocRequest
+    {
+        // Requested resources, must not be null
+        const Resources *req = nullptr;
+        // Filled on return, empty if the pre-allocation failed
+        std::optional<uint64_t> ticket;
+        // Filled on failure, see preAllocate
+        Resources missing;
+    };
+
+    /**
+     * @brief Try pre-allocate a batch of requests in order.
+     *
+     * Each request succeeds or fails on its own, as if preAllocate were called on each of them in turn.
+     *
+     * @param reqs requests, results are filled in place
+     * @return number of succeeded requests
+     */
+    size_t preAllocateBatch(std::vector<PreAllocRequest> &reqs);
+
+    /**
+     * @brief Grow the staging resources of `ticket` towards `target` with whatever is available,
+     * without taking more than `target` on any tag.
+     *
+     * Unlike preAllocate, partial reservations are kept, so resources freed later go to the ticket
+     * first. Release them with freeStaging.
+     *
+     * @param ticket The ticket to grow. A new ticket is created if it's 0, which the caller holds.
+     * @param target Resources the ticket should eventually hold
+     * @param missing If not null, filled with resources still missing to reach `target`
+     * @return Whether the staging resources of `ticket` now contain `target`
+     */
+    bool reserveUpTo(uint64_t &ticket, const Resources &target, Resources *missing);
+
     // Allocate resources from pre-allocated resources, if res < reserved, gauranteed to succeed
     // otherwise may return false
     bool allocate(uint64_t ticket, const Resources &res);
@@ -318,6 +750,17 @@ public:
      */
     void freeStaging(uint64_t ticket);
 
+    /**
+     * @brief Add a holder of `ticket`, so its record is kept until a matching releaseTicket.
+     */
+    void retainTicket(uint64_t ticket);
+
+    /**
+     * @brief Drop a holder of `ticket`. The ticket becomes invalid once it has no holder and holds
+     * no resources.
+     */
+    void releaseTicket(uint64_t ticket);
+
     /**
      * @brief Frees resources `res` for ticket `ticket`.
      * @returns true if the ticket holds no more resources.
@@ -331,21 +774,39 @@ public:
     std::optional<Resources> queryUsage(uint64_t ticket) const;
     bool hasUsage(uint64_t ticket) const;
 
+    /**
+     * @brief Set a callback that is called whenever some resources are given back,
+     * either staging or in use. The callback is called without holding any lock.
+     *
+     * This is not thread safe and must be called before any allocation.
+     */
+    void setReleaseCallback(std::function<void()> cb)
+    {
+        m_releaseCb = std::move(cb);
+    }
+
+    /**
+     * @brief Operations on one ticket, with other operations on it held off until destroyed.
+     */
     struct LockedProxy
     {
         SALUS_DISALLOW_COPY_AND_ASSIGN(LockedProxy);
 
-        explicit LockedProxy(sstl::not_null<ResourceMonitor*> resMon)
+        explicit LockedProxy(sstl::not_null<ResourceMonitor*> resMon, uint64_t ticket)
             : m_resMonitor(resMon)
-            , m_ug(sstl::with_uguard(m_resMonitor->m_mu))
+            , m_ticket(ticket)
+            , m_ug(sstl::with_uguard(m_resMonitor->recordOf(ticket).mu))
         {
         }
 
         LockedProxy(LockedProxy &&other) noexcept
             : m_resMonitor(other.m_resMonitor)
+            , m_ticket(other.m_ticket)
             , m_ug(std::move(other.m_ug))
+            , m_released(other.m_released)
         {
             other.m_resMonitor = nullptr;
+            other.m_released = false;
         }
 
         LockedProxy &operator=(LockedProxy &&other) noexcept
@@ -353,6 +814,9 @@ public:
             release();
             using std::swap;
             swap(m_resMonitor, other.m_resMonitor);
+            swap(m_ticket, other.m_ticket);
+            swap(m_ug, other.m_ug);
+            swap(m_released, other.m_released);
             return *this;
         }
 
@@ -368,49 +832,150 @@ public:
     private:
         void release()
         {
+            auto resMonitor = m_resMonitor;
             if (m_resMonitor) {
                 m_resMonitor = nullptr;
             }
             if (m_ug) {
                 m_ug.unlock();
             }
+            // notify after unlocking
+            if (resMonitor && m_released) {
+                resMonitor->notifyReleased();
+            }
+            m_released = false;
         }
 
         ResourceMonitor *m_resMonitor;
+        uint64_t m_ticket;
         sstl::detail::UGuard m_ug;
+        bool m_released = false;
     };
 
-    LockedProxy lock()
+    LockedProxy lock(uint64_t ticket)
     {
-        return LockedProxy(this);
+        return LockedProxy(this, ticket);
     }
 
     std::string DebugString() const;
 
 private:
-    bool allocateUnsafe(uint64_t ticket, const Resources &res);
-    bool freeUnsafe(uint64_t ticket, const Resources &res);
-    std::optional<Resources> queryStagingUnsafe(uint64_t ticket) const;
+    static constexpr size_t kChunkSize = 1024;
+    static constexpr size_t kMaxChunks = 4096;
 
-    mutable std::mutex m_mu;
+    struct Record
+    {
+        mutable std::mutex mu;
+
+        // Generation of the current ticket of this record, bumped when the record is recycled
+        uint32_t generation GUARDED_BY(mu) = 0;
+        // Number of holders of the current ticket
+        uint32_t refs GUARDED_BY(mu) = 0;
+        bool hasStaging GUARDED_BY(mu) = false;
+
+        /**
+         * @brief Staging resources
+         */
+        Resources staging GUARDED_BY(mu);
+
+        /**
+         * @brief In-use resources
+         */
+        Resources inuse GUARDED_BY(mu);
+
+        // Link in the free list, index + 1 of the next free record, 0 for none
+        std::atomic<uint32_t> nextFree{0};
+    };
+
+    static uint64_t makeTicket(size_t index, uint32_t generation)
+    {
+        return (uint64_t{generation} << 32) | (index + 1);
+    }
+
+    static size_t indexOf(uint64_t ticket)
+    {
+        return static_cast<uint32_t>(ticket) - 1;
+    }
+
+    static uint32_t generationOf(uint64_t ticket)
+    {
+        return static_cast<uint32_t>(ticket >> 32);
+    }
+
+    Record &record(size_t index) const
+    {
+        return m_chunks[index / kChunkSize].load(std::memory_order_acquire)[index % kChunkSize];
+    }
+
+    /**
+     * @brief Record of `ticket`, which may be already recycled. Check with isCurrent.
+     */
+    Record &recordOf(uint64_t ticket) const
+    {
+        return record(indexOf(ticket));
+    }
 
-    // 0 is invalid ticket
-    uint64_t m_nextTicket = 1;
+    static bool isCurrent(const Record &rec, uint64_t ticket) EXCLUSIVE_LOCKS_REQUIRED(rec.mu)
+    {
+        return rec.generation == generationOf(ticket);
+    }
 
     /**
-     * @brief Available resources
+     * @brief Issue a new ticket with one holder
+     * @param staging If not null, the staging resources of the ticket
      */
-    Resources m_limits;
+    uint64_t newTicket(const Resources *staging);
 
     /**
-     * @brief Staging resources
+     * @brief Recycle the record if nothing refers to it anymore
      */
-    std::unordered_map<uint64_t, Resources> m_staging;
+    void maybeRecycle(Record &rec, uint64_t ticket) EXCLUSIVE_LOCKS_REQUIRED(rec.mu);
 
     /**
-     * @brief In-use resources
+     * @brief Take `req` from available resources, all or nothing
+     * @param missing If not null, filled with what's lacking on failure
+     */
+    bool take(const Resources &req, Resources *missing);
+    /**
+     * @brief Take as much of `req` as available from each slot
+     * @return what's taken
      */
-    std::unordered_map<uint64_t, Resources> m_using;
+    Resources takeUpTo(const Resources &req);
+    /**
+     * @brief Give back resources to available ones
+     */
+    void giveBack(const Resources &res);
+
+    bool allocateUnsafe(Record &rec, uint64_t ticket, const Resources &res) EXCLUSIVE_LOCKS_REQUIRED(rec.mu);
+    bool freeUnsafe(Record &rec, uint64_t ticket, const Resources &res) EXCLUSIVE_LOCKS_REQUIRED(rec.mu);
+    std::optional<Resources> queryStagingUnsafe(const Record &rec, uint64_t ticket) const
+        EXCLUSIVE_LOCKS_REQUIRED(rec.mu);
+
+    void notifyReleased() const
+    {
+        if (m_releaseCb) {
+            m_releaseCb();
+        }
+    }
+
+    std::function<void()> m_releaseCb;
+
+    // Slab of records, allocated a chunk at a time and never moved. 0 is invalid ticket.
+    std::array<std::atomic<Record *>, kMaxChunks> m_chunks{};
+    std::atomic<size_t> m_numRecords{0};
+    std::mutex m_growMu;
+
+    // Head of the free list of records, with index + 1 in the low half and an ABA tag in the high half
+    std::atomic<uint64_t> m_freeHead{0};
+
+    /**
+     * @brief Available resources, one counter per slot of Resources, each on its own cache line
+     */
+    struct alignas(64) Counter
+    {
+        std::atomic<size_t> avail{0};
+    };
+    std::array<Counter, resources::kNumSlots> m_avail;
 };
 
 #endif // SALUS_EXEC_RESOURCES_H
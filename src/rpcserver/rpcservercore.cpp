@@ -112,7 +112,6 @@ void RpcServerCore::Alloc(ZmqServer::Sender &&sender, IOpLibrary *oplib, const E
                           const AllocRequest &request)
 {
     UNUSED(sender);
-    UNUSED(evenlop);
     UNUSED(oplib);
 
     auto alignment = request.alignment();
@@ -120,7 +119,7 @@ void RpcServerCore::Alloc(ZmqServer::Sender &&sender, IOpLibrary *oplib, const E
 
     VLOG(2) << "Serving AllocRequest with alignment " << alignment << " and num_bytes " << num_bytes;
 
-    auto ptr = MemoryMgr::instance().allocate(num_bytes, alignment);
+    auto ptr = MemoryMgr::instance().allocate(static_cast<int>(alignment), num_bytes, evenlop.sessionid());
     auto addr_handle = reinterpret_cast<uint64_t>(ptr);
 
     auto response = std::make_unique<AllocResponse>();
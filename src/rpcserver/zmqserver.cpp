@@ -20,6 +20,7 @@
 #include "zmqserver.h"
 
 #include "rpcservercore.h"
+#include "execution/executionengine.h"
 #include "platform/logging.h"
 #include "platform/signals.h"
 #include "platform/thread_annotations.h"
@@ -334,9 +335,17 @@ void ZmqServer::requestStop()
 void ZmqServer::join()
 {
     // Handle SIGINT and SIGTERM
-    // so the user can stop the server from terminal
-    for (auto [signo, action] = signals::waitForTerminate(); action != signals::SignalAction::Exit;) {
+    // so the user can stop the server from terminal,
+    // and SIGUSR1 to dump runtime statistics
+    while (true) {
+        auto [signo, action] = signals::waitForTerminate();
         UNUSED(signo);
+        if (action == signals::SignalAction::Exit) {
+            break;
+        }
+        if (action == signals::SignalAction::DumpStats) {
+            salus::ExecutionEngine::instance().logIterLatency();
+        }
     }
 
     LOG(INFO) << "Stopping ZmqServer";
@@ -0,0 +1,207 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "platform/memory.h"
+#include "resources/memorymgr.h"
+
+#include <docopt.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::string_literals;
+
+namespace {
+
+namespace flags {
+const static auto iters = "--iters";
+const static auto threads = "--threads";
+const static auto window = "--window";
+} // namespace flags
+
+static auto kUsage =
+    R"(Usage:
+    salus-allocbench [options]
+    salus-allocbench --help
+
+Measures MemoryMgr against plain aligned allocation, under the pattern of Alloc/Dealloc
+RPCs: each thread allocates buffers of mixed sizes for a few sessions, keeps a window of
+them alive, and frees the oldest, which were often allocated by another thread.
+
+Options:
+    -h, --help          Print this help message and exit.
+    --iters=<num>       Number of allocations per thread. [default: 200000]
+    --threads=<num>     Maximum number of threads serving RPCs. Use 0 for
+                        the number of CPU cores. [default: 0]
+    --window=<num>      Number of buffers alive per thread. [default: 256]
+)"s;
+
+struct Request
+{
+    size_t bytes;
+    int alignment;
+    const std::string *session;
+};
+
+// Mostly small tensors, some medium ones and a few large ones
+std::vector<Request> makeRequests(size_t n, unsigned seed, const std::vector<std::string> &sessions)
+{
+    std::mt19937_64 rng(seed);
+    std::uniform_real_distribution<double> kind(0, 1);
+    std::uniform_int_distribution<size_t> pick(0, sessions.size() - 1);
+
+    std::vector<Request> reqs;
+    reqs.reserve(n);
+    for (size_t i = 0; i != n; ++i) {
+        auto k = kind(rng);
+        double lo, hi;
+        if (k < 0.8) {
+            lo = 6, hi = 12; // 64B - 4K
+        } else if (k < 0.98) {
+            lo = 12, hi = 18; // 4K - 256K
+        } else {
+            lo = 20, hi = 24; // 1M - 16M
+        }
+        auto bytes = static_cast<size_t>(std::exp2(std::uniform_real_distribution<double>(lo, hi)(rng)));
+        reqs.push_back({bytes, k < 0.5 ? 16 : 64, &sessions[pick(rng)]});
+    }
+    return reqs;
+}
+
+struct PlainAlloc
+{
+    void *allocate(const Request &r) const
+    {
+        return mem::alignedAlloc(r.alignment, r.bytes);
+    }
+    void deallocate(void *ptr) const
+    {
+        mem::alignedFree(ptr);
+    }
+};
+
+struct MgrAlloc
+{
+    void *allocate(const Request &r) const
+    {
+        return MemoryMgr::instance().allocate(r.alignment, r.bytes, *r.session);
+    }
+    void deallocate(void *ptr) const
+    {
+        MemoryMgr::instance().deallocate(ptr);
+    }
+};
+
+/**
+ * @brief Run the RPC pattern on `numThreads` threads. Threads hand their oldest buffers to
+ * the next thread to free, like a Dealloc served by another worker than the Alloc.
+ * @returns wall nanoseconds per allocation on each thread, including freeing
+ */
+template<typename A>
+double run(A alloc, size_t numThreads, size_t iters, size_t window)
+{
+    std::vector<std::string> sessions{"sess-a", "sess-b", "sess-c", "sess-d"};
+    std::vector<std::vector<Request>> reqs;
+    for (size_t t = 0; t != numThreads; ++t) {
+        reqs.emplace_back(makeRequests(iters, static_cast<unsigned>(t), sessions));
+    }
+
+    // slot i of thread t is freed by thread (t + 1) % numThreads, once the owner moves on
+    std::vector<std::vector<std::atomic<void *>>> slots;
+    for (size_t t = 0; t != numThreads; ++t) {
+        slots.emplace_back(window);
+    }
+
+    std::atomic<bool> go{false};
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t != numThreads; ++t) {
+        workers.emplace_back([&, t]() {
+            while (!go.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            auto &mine = slots[t];
+            auto &peer = slots[(t + numThreads - 1) % numThreads];
+            for (size_t i = 0; i != iters; ++i) {
+                auto &r = reqs[t][i];
+                auto ptr = alloc.allocate(r);
+                // touch it like a client filling the buffer
+                std::memset(ptr, 0, std::min(r.bytes, size_t{64}));
+                if (auto old = mine[i % window].exchange(ptr, std::memory_order_acq_rel)) {
+                    alloc.deallocate(old);
+                }
+                // free something the previous thread allocated
+                if (auto old = peer[(i * 7) % window].exchange(nullptr, std::memory_order_acq_rel)) {
+                    alloc.deallocate(old);
+                }
+            }
+        });
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    go.store(true, std::memory_order_release);
+    for (auto &w : workers) {
+        w.join();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    for (auto &s : slots) {
+        for (auto &p : s) {
+            if (auto old = p.exchange(nullptr)) {
+                alloc.deallocate(old);
+            }
+        }
+    }
+    return std::chrono::duration<double, std::nano>(elapsed).count() / iters;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    auto args = docopt::docopt(kUsage, {argv + 1, argv + argc}, /* help = */ true);
+    auto iters = static_cast<size_t>(args[flags::iters].asLong());
+    auto window = std::max(static_cast<size_t>(args[flags::window].asLong()), size_t{1});
+
+    auto maxThreads = static_cast<size_t>(args[flags::threads].asLong());
+    if (maxThreads == 0) {
+        maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << std::left << std::setw(10) << "threads" << std::right << std::setw(14) << "aligned(ns)"
+              << std::setw(14) << "memmgr(ns)" << std::setw(10) << "speedup" << "\n";
+    for (size_t n = 1; n <= maxThreads; n *= 2) {
+        auto before = run(PlainAlloc{}, n, iters, window);
+        auto after = run(MgrAlloc{}, n, iters, window);
+        std::cout << std::left << std::setw(10) << n << std::right << std::setw(14) << before << std::setw(14)
+                  << after << std::setw(9) << before / after << "x\n";
+    }
+
+    std::cout << "\n" << MemoryMgr::instance().stats().DebugString() << "\n";
+    return 0;
+}
@@ -0,0 +1,177 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "execution/threadpool/threadpool.h"
+
+#include <docopt.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::string_literals;
+
+namespace {
+
+namespace flags {
+const static auto threads = "--threads";
+const static auto tasks = "--tasks";
+const static auto taskUs = "--task-us";
+const static auto batch = "--batch";
+} // namespace flags
+
+static auto kUsage =
+    R"(Usage:
+    salus-poolstress [options]
+    salus-poolstress --help
+
+Floods a worker pool with more tasks than its queues can hold, and compares a submitter
+that leaves the excess to the pool's overflow queue against one that parks until the pool drains.
+
+Options:
+    -h, --help          Print this help message and exit.
+    --threads=<num>     Number of worker threads. [default: 4]
+    --tasks=<num>       Number of tasks to submit. [default: 200000]
+    --task-us=<us>      Microseconds each task sleeps. [default: 20]
+    --batch=<num>       Number of tasks per submission. [default: 64]
+)"s;
+
+struct StressReport
+{
+    size_t batches = 0;
+    ThreadPool::QueueStats queue;
+    size_t wakeups = 0;
+    double wallSeconds = 0;
+    double submitterCpuSeconds = 0;
+};
+
+double threadCpuSeconds()
+{
+    timespec ts{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Submit `numTasks` sleeping tasks to a fresh pool in batches.
+ * When `park` is false, tasks beyond the worker queues wait in the pool's overflow queue.
+ * Otherwise the submitter waits for the pool's drain callback after a batch overflows.
+ */
+StressReport runStress(size_t numThreads, size_t numTasks, std::chrono::microseconds taskTime, size_t batchSize,
+                       bool park)
+{
+    StressReport report;
+
+    // declared before the pool so they outlive its workers
+    std::mutex mu;
+    std::condition_variable cv;
+    bool drained = false;
+    std::atomic<size_t> finished{0};
+
+    ThreadPool pool(ThreadPoolOptions{}.setNumThreads(numThreads));
+    pool.setDrainCallback([&]() {
+        {
+            std::lock_guard<std::mutex> g(mu);
+            drained = true;
+        }
+        cv.notify_one();
+    });
+
+    auto makeTask = [&]() -> ThreadPool::Closure {
+        return [&finished, taskTime]() {
+            std::this_thread::sleep_for(taskTime);
+            finished.fetch_add(1, std::memory_order_relaxed);
+        };
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    auto cpuStart = threadCpuSeconds();
+
+    std::vector<ThreadPool::Closure> pending;
+    size_t submitted = 0;
+    while (submitted < numTasks) {
+        while (pending.size() < batchSize && submitted + pending.size() < numTasks) {
+            pending.emplace_back(makeTask());
+        }
+
+        if (park) {
+            std::unique_lock<std::mutex> ul(mu);
+            // clear before submitting so a drain between the overflow and the wait is not lost
+            drained = false;
+        }
+
+        ++report.batches;
+        submitted += pool.tryRunBatch(pending);
+        pending.clear();
+
+        if (park && pool.saturated()) {
+            std::unique_lock<std::mutex> ul(mu);
+            cv.wait(ul, [&]() { return drained || !pool.saturated(); });
+            ++report.wakeups;
+        }
+    }
+
+    report.submitterCpuSeconds = threadCpuSeconds() - cpuStart;
+
+    while (finished.load(std::memory_order_relaxed) < numTasks) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    report.wallSeconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    report.queue = pool.queueStats();
+
+    return report;
+}
+
+void printReport(const std::string &name, const StressReport &report)
+{
+    std::cout << std::left << std::setw(14) << name << std::right << std::setw(10) << report.batches
+              << std::setw(12) << report.queue.overflowed << std::setw(10) << report.queue.spilled
+              << std::setw(10) << report.wakeups << std::setw(12)
+              << report.wallSeconds << std::setw(14) << report.submitterCpuSeconds << "\n";
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    auto args = docopt::docopt(kUsage, {argv + 1, argv + argc}, /* help = */ true);
+
+    auto numThreads = static_cast<size_t>(args[flags::threads].asLong());
+    auto numTasks = static_cast<size_t>(args[flags::tasks].asLong());
+    auto taskTime = std::chrono::microseconds(args[flags::taskUs].asLong());
+    auto batchSize = std::max<size_t>(1, static_cast<size_t>(args[flags::batch].asLong()));
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << std::left << std::setw(14) << "submitter" << std::right << std::setw(10) << "batches"
+              << std::setw(12) << "overflowed" << std::setw(10) << "spilled" << std::setw(10) << "wakeups"
+              << std::setw(12) << "wall(s)" << std::setw(14) << "cpu(s)" << "\n";
+    printReport("overflow", runStress(numThreads, numTasks, taskTime, batchSize, false));
+    printReport("backpressure", runStress(numThreads, numTasks, taskTime, batchSize, true));
+
+    return 0;
+}
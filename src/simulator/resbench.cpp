@@ -0,0 +1,269 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "resources/resources.h"
+
+#include <docopt.h>
+
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using namespace std::string_literals;
+
+namespace {
+
+namespace flags {
+const static auto iters = "--iters";
+const static auto threads = "--threads";
+} // namespace flags
+
+static auto kUsage =
+    R"(Usage:
+    salus-resbench [options]
+    salus-resbench --help
+
+Measures the cost of set operations on Resources, against the std::unordered_map
+representation it replaced, and the throughput of ResourceMonitor when allocating
+from several threads.
+
+Options:
+    -h, --help          Print this help message and exit.
+    --iters=<num>       Number of times to run each operation. [default: 2000000]
+    --threads=<num>     Maximum number of threads allocating together. Use 0 for
+                        the number of CPU cores. [default: 0]
+)"s;
+
+// The previous representation and its operations, kept for comparison
+namespace legacy {
+using Resources = std::unordered_map<ResourceTag, size_t>;
+
+bool contains(const Resources &avail, const Resources &req)
+{
+    for (auto [tag, val] : req) {
+        auto it = avail.find(tag);
+        if (it == avail.end()) {
+            if (val != 0) {
+                return false;
+            }
+            continue;
+        }
+        if (val > it->second) {
+            return false;
+        }
+    }
+    return true;
+}
+
+Resources &merge(Resources &lhs, const Resources &rhs)
+{
+    for (auto [tag, val] : rhs) {
+        lhs[tag] += val;
+    }
+    return lhs;
+}
+
+Resources &subtract(Resources &lhs, const Resources &rhs)
+{
+    for (auto [tag, val] : rhs) {
+        lhs[tag] -= val;
+    }
+    return lhs;
+}
+
+Resources subtractBounded(Resources &lhs, const Resources &rhs)
+{
+    Resources res;
+    for (auto [tag, val] : rhs) {
+        auto it = lhs.find(tag);
+        if (it == lhs.end()) {
+            continue;
+        }
+        auto v = std::min(val, it->second);
+        it->second -= v;
+        res[tag] = v;
+    }
+    return res;
+}
+} // namespace legacy
+
+// Keep results alive so the compiler can't drop the work
+volatile size_t g_sink;
+
+template<typename Fn>
+double nsPerOp(size_t iters, Fn &&fn)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i != iters; ++i) {
+        fn(i);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / iters;
+}
+
+template<typename R>
+struct Fixture
+{
+    // what a ResourceMonitor has, and what a task asks for
+    R limits;
+    R req;
+
+    Fixture()
+    {
+        limits[resources::CPU0Memory] = 100ull << 30;
+        limits[resources::GPU0Memory] = 14ull << 30;
+        limits[{ResourceType::GPU_STREAM, salus::devices::GPU0}] = 128;
+        limits[{ResourceType::EXCLUSIVE, salus::devices::GPU0}] = 1;
+        req[resources::GPU0Memory] = 1 << 20;
+        req[{ResourceType::GPU_STREAM, salus::devices::GPU0}] = 1;
+    }
+};
+
+template<typename R, typename Ops>
+std::vector<double> runAll(size_t iters, Ops ops)
+{
+    Fixture<R> fx;
+    std::vector<double> res;
+
+    res.push_back(nsPerOp(iters, [&](size_t) { g_sink = ops.contains(fx.limits, fx.req); }));
+    res.push_back(nsPerOp(iters, [&](size_t) {
+        auto r = fx.limits;
+        ops.merge(r, fx.req);
+        g_sink = r.size();
+    }));
+    res.push_back(nsPerOp(iters, [&](size_t) {
+        auto r = fx.limits;
+        ops.subtract(r, fx.req);
+        g_sink = r.size();
+    }));
+    res.push_back(nsPerOp(iters, [&](size_t) {
+        auto r = fx.limits;
+        g_sink = ops.subtractBounded(r, fx.req).size();
+    }));
+    // what ResourceMonitor::preAllocate does for one task
+    res.push_back(nsPerOp(iters, [&](size_t i) {
+        std::unordered_map<uint64_t, R> staging;
+        if (ops.contains(fx.limits, fx.req)) {
+            ops.subtract(fx.limits, fx.req);
+            staging[i] = fx.req;
+            ops.merge(fx.limits, fx.req);
+        }
+        g_sink = staging.size();
+    }));
+    return res;
+}
+
+struct DenseOps
+{
+    bool contains(const Resources &a, const Resources &b) const { return resources::contains(a, b); }
+    void merge(Resources &a, const Resources &b) const { resources::merge(a, b); }
+    void subtract(Resources &a, const Resources &b) const { resources::subtract(a, b); }
+    Resources subtractBounded(Resources &a, const Resources &b) const { return resources::subtractBounded(a, b); }
+};
+
+struct LegacyOps
+{
+    bool contains(const legacy::Resources &a, const legacy::Resources &b) const { return legacy::contains(a, b); }
+    void merge(legacy::Resources &a, const legacy::Resources &b) const { legacy::merge(a, b); }
+    void subtract(legacy::Resources &a, const legacy::Resources &b) const { legacy::subtract(a, b); }
+    legacy::Resources subtractBounded(legacy::Resources &a, const legacy::Resources &b) const
+    {
+        return legacy::subtractBounded(a, b);
+    }
+};
+
+/**
+ * @brief Run what a task does to the monitor, pre-allocate, allocate, free and release staging,
+ * on `numThreads` threads together.
+ * @returns million cycles per second over all threads
+ */
+double monitorThroughput(size_t numThreads, size_t itersPerThread)
+{
+    ResourceMonitor monitor;
+    monitor.initializeLimits();
+
+    Resources req{{resources::GPU0Memory, 1 << 20}, {{ResourceType::GPU_STREAM, salus::devices::GPU0}, 1}};
+    Resources alloc{{resources::GPU0Memory, 1 << 20}};
+
+    std::atomic<bool> go{false};
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t != numThreads; ++t) {
+        workers.emplace_back([&]() {
+            while (!go.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            for (size_t i = 0; i != itersPerThread; ++i) {
+                auto ticket = monitor.preAllocate(req, nullptr);
+                if (!ticket) {
+                    continue;
+                }
+                if (monitor.allocate(*ticket, alloc)) {
+                    monitor.free(*ticket, alloc);
+                }
+                monitor.freeStaging(*ticket);
+                monitor.releaseTicket(*ticket);
+            }
+        });
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    go.store(true, std::memory_order_release);
+    for (auto &w : workers) {
+        w.join();
+    }
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return numThreads * itersPerThread / elapsed / 1e6;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    auto args = docopt::docopt(kUsage, {argv + 1, argv + argc}, /* help = */ true);
+    auto iters = static_cast<size_t>(args[flags::iters].asLong());
+
+    auto before = runAll<legacy::Resources>(iters, LegacyOps{});
+    auto after = runAll<Resources>(iters, DenseOps{});
+
+    const char *names[] = {"contains", "copy+merge", "copy+subtract", "copy+subtractBounded", "preAllocate"};
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << std::left << std::setw(24) << "operation" << std::right << std::setw(14) << "map(ns)" << std::setw(14)
+              << "dense(ns)" << std::setw(10) << "speedup" << "\n";
+    for (size_t i = 0; i != before.size(); ++i) {
+        std::cout << std::left << std::setw(24) << names[i] << std::right << std::setw(14) << before[i]
+                  << std::setw(14) << after[i] << std::setw(9) << before[i] / after[i] << "x\n";
+    }
+
+    auto maxThreads = static_cast<size_t>(args[flags::threads].asLong());
+    if (maxThreads == 0) {
+        maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    std::cout << "\n" << std::left << std::setw(24) << "monitor threads" << std::right << std::setw(14)
+              << "Mcycles/s" << "\n";
+    for (size_t n = 1; n <= maxThreads; n *= 2) {
+        std::cout << std::left << std::setw(24) << n << std::right << std::setw(14)
+                  << monitorThroughput(n, iters / 10 / n) << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,153 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "simulator/simdevice.h"
+
+#include "platform/logging.h"
+#include "utils/threadutils.h"
+
+#include <algorithm>
+
+using std::chrono::duration_cast;
+
+namespace salus::sim {
+
+SimDevice::SimDevice(double speedup, int smUnits)
+    : m_speedup(speedup)
+    , m_smUnits(smUnits)
+    , m_epoch(Clock::now())
+    , m_freeUnits(smUnits)
+{
+    CHECK_GT(m_speedup, 0);
+    CHECK_GT(m_smUnits, 0);
+    m_thread = std::thread(&SimDevice::timerLoop, this);
+}
+
+SimDevice::~SimDevice()
+{
+    stop();
+}
+
+void SimDevice::stop()
+{
+    {
+        auto g = sstl::with_guard(m_mu);
+        m_stopping = true;
+    }
+    m_cv.notify_all();
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+SimDevice::Clock::time_point SimDevice::wallAfter(Duration delay) const
+{
+    return Clock::now() + duration_cast<Clock::duration>(delay / m_speedup);
+}
+
+double SimDevice::now() const
+{
+    return Duration(Clock::now() - m_epoch).count() * m_speedup;
+}
+
+double SimDevice::busyUnitSeconds() const
+{
+    auto g = sstl::with_guard(m_mu);
+    return m_busyUnitSeconds;
+}
+
+void SimDevice::after(Duration delay, std::function<void()> fn)
+{
+    {
+        auto g = sstl::with_guard(m_mu);
+        m_timers.emplace(wallAfter(delay), std::move(fn));
+    }
+    m_cv.notify_all();
+}
+
+void SimDevice::launch(int sm, Duration dur, std::function<void()> done)
+{
+    sm = std::clamp(sm, 1, m_smUnits);
+    {
+        auto g = sstl::with_guard(m_mu);
+        if (m_pending.empty() && m_freeUnits >= sm) {
+            startKernel({sm, dur, std::move(done)});
+        } else {
+            m_pending.push_back({sm, dur, std::move(done)});
+        }
+    }
+    m_cv.notify_all();
+}
+
+void SimDevice::startKernel(Kernel &&k)
+{
+    m_freeUnits -= k.sm;
+    m_busyUnitSeconds += k.sm * k.dur.count();
+    m_timers.emplace(wallAfter(k.dur), [this, sm = k.sm, done = std::move(k.done)]() {
+        kernelFinished(sm);
+        done();
+    });
+}
+
+void SimDevice::kernelFinished(int sm)
+{
+    auto g = sstl::with_guard(m_mu);
+    m_freeUnits += sm;
+    // strictly FIFO, so large kernels are not starved by small ones
+    while (!m_pending.empty() && m_pending.front().sm <= m_freeUnits) {
+        startKernel(std::move(m_pending.front()));
+        m_pending.pop_front();
+    }
+}
+
+void SimDevice::timerLoop()
+{
+    threading::set_thread_name("SimTimer");
+
+    auto lock = sstl::with_uguard(m_mu);
+    while (!m_stopping) {
+        if (m_timers.empty()) {
+            m_cv.wait(lock);
+            continue;
+        }
+        auto it = m_timers.begin();
+        if (it->first > Clock::now()) {
+            m_cv.wait_until(lock, it->first);
+            continue;
+        }
+        auto fn = std::move(it->second);
+        m_timers.erase(it);
+
+        lock.unlock();
+        fn();
+        lock.lock();
+    }
+
+    // fire what's left right away, so nothing waiting on a timer is left hanging
+    while (!m_timers.empty()) {
+        auto fn = std::move(m_timers.begin()->second);
+        m_timers.erase(m_timers.begin());
+
+        lock.unlock();
+        fn();
+        lock.lock();
+    }
+}
+
+} // namespace salus::sim
@@ -0,0 +1,123 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SALUS_SIM_SIMDEVICE_H
+#define SALUS_SIM_SIMDEVICE_H
+
+#include "platform/thread_annotations.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+
+namespace salus::sim {
+
+/**
+ * @brief A simulated GPU with a fixed number of SM units, and a timer to drive the simulation.
+ *
+ * Simulated time runs `speedup` times faster than wall time. Kernels occupy some SM units
+ * for their duration, and wait in FIFO order when not enough units are free.
+ */
+class SimDevice
+{
+public:
+    // simulated seconds
+    using Duration = std::chrono::duration<double>;
+
+    SimDevice(double speedup, int smUnits);
+
+    ~SimDevice();
+
+    /**
+     * @brief Call `fn` on the timer thread after `delay` of simulated time
+     */
+    void after(Duration delay, std::function<void()> fn);
+
+    /**
+     * @brief Run a kernel using `sm` units for `dur` of simulated time, and call `done`
+     * on the timer thread once it finishes.
+     */
+    void launch(int sm, Duration dur, std::function<void()> done);
+
+    /**
+     * @brief Simulated seconds since the device is created
+     */
+    double now() const;
+
+    /**
+     * @brief Sum of SM units times simulated seconds of all launched kernels
+     */
+    double busyUnitSeconds() const;
+
+    int smUnits() const
+    {
+        return m_smUnits;
+    }
+
+    double speedup() const
+    {
+        return m_speedup;
+    }
+
+    /**
+     * @brief Stop the timer thread. Timers still pending are called right away.
+     */
+    void stop();
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Kernel
+    {
+        int sm;
+        Duration dur;
+        std::function<void()> done;
+    };
+
+    void timerLoop();
+
+    void startKernel(Kernel &&k) EXCLUSIVE_LOCKS_REQUIRED(m_mu);
+
+    void kernelFinished(int sm);
+
+    Clock::time_point wallAfter(Duration delay) const;
+
+    const double m_speedup;
+    const int m_smUnits;
+    const Clock::time_point m_epoch;
+
+    mutable std::mutex m_mu;
+    std::condition_variable m_cv;
+    bool m_stopping GUARDED_BY(m_mu) = false;
+    std::multimap<Clock::time_point, std::function<void()>> m_timers GUARDED_BY(m_mu);
+
+    int m_freeUnits GUARDED_BY(m_mu);
+    double m_busyUnitSeconds GUARDED_BY(m_mu) = 0;
+    std::deque<Kernel> m_pending GUARDED_BY(m_mu);
+
+    std::thread m_thread;
+};
+
+} // namespace salus::sim
+
+#endif // SALUS_SIM_SIMDEVICE_H
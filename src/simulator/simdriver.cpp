@@ -0,0 +1,380 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "simulator/simdriver.h"
+
+#include "execution/engine/resourcecontext.h"
+#include "execution/executionengine.h"
+#include "platform/logging.h"
+#include "simulator/simdevice.h"
+#include "simulator/simtasks.h"
+#include "utils/containerutils.h"
+#include "utils/threadutils.h"
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <future>
+#include <limits>
+
+using std::chrono::duration_cast;
+using std::chrono::steady_clock;
+using FpSeconds = std::chrono::duration<double>;
+
+namespace salus::sim {
+
+namespace {
+
+// all iterations of a job run the same graph
+constexpr uint64_t kGraphId = 1;
+
+// how long a job waits before trying again when its persistent memory doesn't fit
+constexpr SimDevice::Duration kAdmitRetry{1.0};
+
+double processCpuSeconds()
+{
+    rusage ru{};
+    getrusage(RUSAGE_SELF, &ru);
+    auto toSeconds = [](const timeval &tv) { return tv.tv_sec + tv.tv_usec / 1e6; };
+    return toSeconds(ru.ru_utime) + toSeconds(ru.ru_stime);
+}
+
+/**
+ * @brief A synthetic job. Everything after construction runs on the device's timer thread.
+ */
+class SimJob
+{
+public:
+    SimJob(ExecutionEngine &engine, SimDevice &dev, sstl::semaphore &finished, size_t index, const Workload &wl,
+           const SimConfig &config)
+        : m_engine(engine)
+        , m_dev(dev)
+        , m_finished(finished)
+        , m_handle("sim-" + std::to_string(index) + "-" + wl.name)
+        , m_hostBandwidth(config.hostBandwidth)
+    {
+        auto mem = static_cast<size_t>(wl.memMB * 1024 * 1024);
+        m_profile.iterTime = wl.iters ? wl.jct / wl.iters : 0;
+        m_profile.numOps = std::max<size_t>(config.numOps, 1);
+        m_profile.persistent = static_cast<size_t>(mem * config.persistentFraction);
+        m_profile.temporary = mem - m_profile.persistent;
+        m_profile.sm = config.sm;
+
+        m_result.name = wl.name;
+        m_result.iters = std::max<size_t>(config.maxIters ? std::min(config.maxIters, wl.iters) : wl.iters, 1);
+        m_result.standalone = m_profile.iterTime * m_result.iters;
+    }
+
+    void arrive()
+    {
+        m_result.arrival = m_dev.now();
+
+        m_ectx = m_engine.makeContext();
+        if (!m_ectx) {
+            LOG(ERROR) << "Engine is shutting down, job " << m_handle << " dropped";
+            finish();
+            return;
+        }
+        m_ectx->setSessionHandle(m_handle);
+        auto laneMemory = sstl::getOrDefault(resources::platformLimits(), resources::GPU0Memory, 0);
+        m_ectx->setLaneMemory(laneMemory, m_profile.persistent);
+        m_ectx->setInterruptCallback([this]() { LOG(ERROR) << "Job " << m_handle << " is force evicted"; });
+        PagingCallbacks pcb;
+        pcb.volunteer = [this](auto ticket, auto &&rctx) { return pageOut(ticket, std::move(rctx)); };
+        pcb.prefetch = [this](auto &&rctx) { return pageIn(std::move(rctx)); };
+        m_ectx->registerPagingCallbacks(std::move(pcb));
+        tryStart();
+    }
+
+    const JobResult &result() const
+    {
+        return m_result;
+    }
+
+private:
+    void tryStart()
+    {
+        // keep persistent memory for the whole job, which limits what others can use
+        Resources res{{resources::GPU0Memory, m_profile.persistent}};
+        auto rctx = m_ectx->makeResourceContext(kGraphId, devices::GPU0, res);
+        if (!rctx) {
+            VLOG(1) << "Job " << m_handle << " waiting for " << m_profile.persistent << " bytes persistent memory";
+            m_dev.after(kAdmitRetry, [this]() { tryStart(); });
+            return;
+        }
+        if (m_profile.persistent) {
+            // actually use it, which also makes it a victim for paging
+            rctx->alloc(ResourceType::MEMORY);
+        }
+        m_device.push_back({std::move(rctx), m_profile.persistent});
+
+        m_result.start = m_dev.now();
+        nextIteration();
+    }
+
+    void nextIteration()
+    {
+        if (m_itersDone == m_result.iters) {
+            finish();
+            return;
+        }
+        m_ectx->scheduleIteartion(std::make_unique<SimIterationTask>(m_dev, m_ectx, m_profile, kGraphId, [this]() {
+            ++m_itersDone;
+            nextIteration();
+        }));
+    }
+
+    void finish()
+    {
+        m_result.finish = m_dev.now();
+        m_result.iters = m_itersDone;
+
+        CLOG(INFO, logging::kPerfTag) << "event: sim_job "
+                                      << nlohmann::json({
+                                             {"sess", m_handle},
+                                             {"arrival", m_result.arrival},
+                                             {"start", m_result.start},
+                                             {"finish", m_result.finish},
+                                             {"jct", m_result.jct()},
+                                             {"standalone", m_result.standalone},
+                                             {"iters", m_result.iters},
+                                         });
+
+        m_done = true;
+        m_device.clear();
+        m_host.clear();
+        if (m_ectx) {
+            m_ectx->finish([]() {});
+            m_ectx.reset();
+        }
+        m_finished.notify();
+    }
+
+    ExecutionEngine &m_engine;
+    SimDevice &m_dev;
+    sstl::semaphore &m_finished;
+    const std::string m_handle;
+
+    SimProfile m_profile;
+    JobResult m_result;
+    size_t m_itersDone = 0;
+
+    /**
+     * @brief Move memory under `ticket` to host memory reserved in `host`, taking simulated transfer time.
+     * Called on a thread pool worker, blocks until the transfer is done.
+     */
+    size_t pageOut(uint64_t ticket, std::unique_ptr<ResourceContext> &&host)
+    {
+        std::promise<size_t> released;
+        auto fu = released.get_future();
+        // everything else of the job happens on the timer thread, look up there
+        m_dev.after(SimDevice::Duration{0}, [this, ticket, host = std::make_shared<std::unique_ptr<ResourceContext>>(std::move(host)), &released]() {
+            auto it = std::find_if(m_device.begin(), m_device.end(),
+                                   [ticket](const auto &held) { return held.rctx->ticket() == ticket; });
+            if (m_done || it == m_device.end() || it->bytes == 0) {
+                released.set_value(0);
+                return;
+            }
+            auto bytes = it->bytes;
+            m_dev.after(transferTime(bytes), [this, bytes, ticket, host, &released]() {
+                auto it = std::find_if(m_device.begin(), m_device.end(),
+                                       [ticket](const auto &held) { return held.rctx->ticket() == ticket; });
+                if (m_done || it == m_device.end()) {
+                    released.set_value(0);
+                    return;
+                }
+                (*host)->alloc(ResourceType::MEMORY);
+                m_host.push_back({std::move(*host), bytes});
+                it->rctx->dealloc(ResourceType::MEMORY, bytes);
+                m_device.erase(it);
+                released.set_value(bytes);
+            });
+        });
+        return fu.get();
+    }
+
+    /**
+     * @brief Move everything on host back to device memory reserved in `device`
+     */
+    size_t pageIn(std::unique_ptr<ResourceContext> &&device)
+    {
+        std::promise<size_t> restored;
+        auto fu = restored.get_future();
+        m_dev.after(SimDevice::Duration{0}, [this, device = std::make_shared<std::unique_ptr<ResourceContext>>(std::move(device)), &restored]() {
+            size_t bytes = 0;
+            for (auto &held : m_host) {
+                bytes += held.bytes;
+            }
+            if (m_done || bytes == 0) {
+                restored.set_value(0);
+                return;
+            }
+            m_dev.after(transferTime(bytes), [this, bytes, device, &restored]() {
+                if (m_done) {
+                    restored.set_value(0);
+                    return;
+                }
+                (*device)->alloc(ResourceType::MEMORY);
+                m_device.push_back({std::move(*device), bytes});
+                for (auto &held : m_host) {
+                    held.rctx->dealloc(ResourceType::MEMORY, held.bytes);
+                }
+                m_host.clear();
+                restored.set_value(bytes);
+            });
+        });
+        return fu.get();
+    }
+
+    SimDevice::Duration transferTime(size_t bytes) const
+    {
+        return SimDevice::Duration{bytes / m_hostBandwidth};
+    }
+
+    std::shared_ptr<ExecutionContext> m_ectx;
+
+    // memory kept across iterations, on device and paged out to host
+    struct Held
+    {
+        std::unique_ptr<ResourceContext> rctx;
+        size_t bytes;
+    };
+    std::vector<Held> m_device;
+    std::vector<Held> m_host;
+    const double m_hostBandwidth;
+    bool m_done = false;
+};
+
+} // namespace
+
+std::vector<Workload> loadWorkloads(const std::string &path)
+{
+    std::vector<Workload> workloads;
+
+    std::ifstream in(path);
+    if (!in) {
+        LOG(ERROR) << "Can't open workload file " << path;
+        return workloads;
+    }
+
+    std::string line;
+    size_t lineno = 0;
+    while (std::getline(in, line)) {
+        ++lineno;
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+
+        // the last column is the command, which may contain anything
+        std::vector<std::string> cols;
+        size_t pos = 0;
+        while (cols.size() != 4) {
+            auto next = line.find(',', pos);
+            if (next == std::string::npos) {
+                break;
+            }
+            cols.emplace_back(line.substr(pos, next - pos));
+            pos = next + 1;
+        }
+
+        try {
+            if (cols.size() != 4) {
+                throw std::invalid_argument("too few columns");
+            }
+            auto &wl = workloads.emplace_back();
+            wl.name = cols[0];
+            wl.jct = std::stod(cols[1]);
+            wl.memMB = std::stod(cols[2]);
+            wl.iters = std::stoul(cols[3]);
+        } catch (const std::logic_error &ex) {
+            LOG(ERROR) << "Skipping malformed line " << lineno << " in " << path << ": " << ex.what();
+            if (cols.size() == 4) {
+                workloads.pop_back();
+            }
+        }
+    }
+    return workloads;
+}
+
+Simulator::Simulator(ExecutionEngine &engine, const SimConfig &config)
+    : m_engine(engine)
+    , m_config(config)
+{
+}
+
+Simulator::~Simulator() = default;
+
+SimReport Simulator::run(const std::vector<Workload> &jobs)
+{
+    SimReport report;
+    if (jobs.empty()) {
+        return report;
+    }
+
+    SimDevice dev(m_config.speedup, m_config.smUnits);
+    sstl::semaphore finished;
+
+    std::vector<std::unique_ptr<SimJob>> simJobs;
+    simJobs.reserve(jobs.size());
+    for (size_t i = 0; i != jobs.size(); ++i) {
+        simJobs.emplace_back(std::make_unique<SimJob>(m_engine, dev, finished, i, jobs[i], m_config));
+    }
+
+    auto cpuStart = processCpuSeconds();
+    auto wallStart = steady_clock::now();
+
+    for (size_t i = 0; i != simJobs.size(); ++i) {
+        dev.after(SimDevice::Duration{m_config.interval * i}, [job = simJobs[i].get()]() { job->arrive(); });
+    }
+    finished.wait(simJobs.size());
+
+    report.cpuSeconds = processCpuSeconds() - cpuStart;
+    report.wallSeconds = FpSeconds(steady_clock::now() - wallStart).count();
+
+    dev.stop();
+
+    double firstArrival = std::numeric_limits<double>::max();
+    double lastFinish = 0;
+    for (auto &job : simJobs) {
+        auto &res = job->result();
+        firstArrival = std::min(firstArrival, res.arrival);
+        lastFinish = std::max(lastFinish, res.finish);
+        report.totalIters += res.iters;
+        report.jobs.emplace_back(res);
+    }
+    report.makespan = lastFinish - firstArrival;
+    if (report.makespan > 0) {
+        report.utilization = dev.busyUnitSeconds() / (dev.smUnits() * report.makespan);
+    }
+
+    CLOG(INFO, logging::kPerfTag) << "event: sim_report "
+                                  << nlohmann::json({
+                                         {"jobs", report.jobs.size()},
+                                         {"makespan", report.makespan},
+                                         {"utilization", report.utilization},
+                                         {"process_cpu_s", report.cpuSeconds},
+                                         {"wall_s", report.wallSeconds},
+                                         {"iters", report.totalIters},
+                                     });
+    return report;
+}
+
+} // namespace salus::sim
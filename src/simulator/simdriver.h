@@ -0,0 +1,126 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SALUS_SIM_SIMDRIVER_H
+#define SALUS_SIM_SIMDRIVER_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace salus {
+class ExecutionEngine;
+} // namespace salus
+
+namespace salus::sim {
+
+/**
+ * @brief One line of a workload file, in the format of tests/workloads.csv:
+ * name,jct(s),mem(MB),iters,cmd
+ */
+struct Workload
+{
+    std::string name;
+    // JCT in seconds when running alone
+    double jct = 0;
+    // peak GPU memory in MB
+    double memMB = 0;
+    size_t iters = 0;
+};
+
+/**
+ * @brief Load workloads from `path`. Malformed lines are skipped with an error logged.
+ */
+std::vector<Workload> loadWorkloads(const std::string &path);
+
+struct SimConfig
+{
+    // simulated time runs this many times faster than wall time
+    double speedup = 100;
+    // simulated seconds between job arrivals
+    double interval = 0;
+    // kernels per iteration
+    size_t numOps = 20;
+    // fraction of the peak memory kept across iterations
+    double persistentFraction = 0.5;
+    // SM units of the device, and used by each kernel
+    int smUnits = 100;
+    int sm = 100;
+    // cap on iterations per job, 0 means running all iterations in the workload
+    size_t maxIters = 0;
+    // bytes per simulated second when paging between device and host memory
+    double hostBandwidth = 12e9;
+};
+
+struct JobResult
+{
+    std::string name;
+    // all times are in simulated seconds since the simulation started
+    double arrival = 0;
+    double start = 0;
+    double finish = 0;
+    // JCT when running alone
+    double standalone = 0;
+    size_t iters = 0;
+
+    double jct() const
+    {
+        return finish - arrival;
+    }
+};
+
+struct SimReport
+{
+    std::vector<JobResult> jobs;
+    // simulated seconds from the first arrival to the last finish
+    double makespan = 0;
+    // busy SM units over available SM units during makespan
+    double utilization = 0;
+    // CPU time used by the process, including the scheduler, the task executor and the
+    // simulation itself, which is negligible as kernels only wait on timers
+    double cpuSeconds = 0;
+    double wallSeconds = 0;
+    size_t totalIters = 0;
+};
+
+/**
+ * @brief Replays workloads as synthetic jobs on a simulated GPU, driven by the real
+ * execution engine. Each job runs its iterations one after another, like a training loop.
+ */
+class Simulator
+{
+public:
+    Simulator(ExecutionEngine &engine, const SimConfig &config);
+
+    ~Simulator();
+
+    /**
+     * @brief Run `jobs`, arriving in order, until all of them finish.
+     * The engine's scheduler must have been started.
+     */
+    SimReport run(const std::vector<Workload> &jobs);
+
+private:
+    ExecutionEngine &m_engine;
+    SimConfig m_config;
+};
+
+} // namespace salus::sim
+
+#endif // SALUS_SIM_SIMDRIVER_H
@@ -0,0 +1,264 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "execution/executionengine.h"
+#include "platform/logging.h"
+#include "resources/resources.h"
+#include "simulator/simdriver.h"
+
+#include <docopt.h>
+
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <set>
+#include <sstream>
+#include <string>
+
+using namespace std::string_literals;
+
+namespace {
+
+namespace flags {
+const static auto workloads = "<workloads>";
+const static auto jobs = "--jobs";
+const static auto interval = "--interval";
+const static auto speedup = "--speedup";
+const static auto maxIters = "--iters";
+const static auto numOps = "--ops";
+const static auto persistent = "--persistent";
+const static auto sm = "--sm";
+const static auto scheduler = "--sched";
+const static auto schedThreads = "--sched-threads";
+const static auto maxConcurrentIters = "--max-concurrent-iters";
+const static auto maxShadowHold = "--max-shadow-hold";
+const static auto chainTasks = "--chain-tasks";
+const static auto oversubscribe = "--oversubscribe";
+const static auto gpuMemLimit = "--gpu-mem-limit";
+const static auto resourceLimits = "--resource-limits";
+
+const static auto logConf = "--logconf";
+const static auto verbose = "--verbose";
+const static auto vModule = "--vmodule";
+const static auto vLogFile = "--vlogfile";
+const static auto pLogFile = "--perflog";
+} // namespace flags
+
+static auto kUsage =
+    R"(Usage:
+    salus-sim [options] <workloads>
+    salus-sim --help
+
+Salus scheduler simulator. Replays workloads on a simulated GPU using synthetic tasks,
+and reports JCT, makespan, utilization and scheduling overhead.
+
+<workloads> is a CSV file in the format of tests/workloads.csv:
+    name,jct(s),mem(MB),iters,cmd
+
+Options:
+    -h, --help                  Print this help message and exit.
+    -j <names>, --jobs=<names>  Comma separated workload names to run, in arrival order.
+                                A name may repeat. Run all workloads if not given.
+    --interval=<sec>            Simulated seconds between job arrivals. [default: 0]
+    --speedup=<x>               Run simulated time <x> times faster than wall time.
+                                Scheduling overhead is not scaled, so it becomes relatively
+                                larger as <x> increases. [default: 100]
+    --iters=<num>               Run at most <num> iterations per job. Use 0 to run
+                                all iterations in the workload. [default: 0]
+    --ops=<num>                 Number of kernels per iteration. [default: 20]
+    --persistent=<frac>         Fraction of the workload's memory kept across
+                                iterations. [default: 0.5]
+    --sm=<percent>              Percent of SMs used by each kernel. [default: 100]
+    -s <policy>, --sched=<policy>
+                                Use <policy> for scheduling . Choices: fair, preempt, pack, rr, fifo, edf, timeslice.
+                                [default: pack]
+    --sched-threads=<num>       Number of threads scheduling iterations. Use 0 to decide
+                                based on the number of CPU cores. [default: 0]
+    --max-concurrent-iters=<num>
+                                Maximum number of iterations running together on one lane,
+                                when their predicted memory usage fits in the lane. [default: 1]
+    --max-shadow-hold=<ms>      Maximum time a queue head blocked on resources reserves
+                                resources freed by others, while later tasks are
+                                backfilled around it. Use 0 to disable. [default: 1000]
+    --chain-tasks               Let a worker finishing a task run the next admitted task
+                                from the same session inline.
+    --oversubscribe             Page data of other sessions out to host memory when GPU
+                                memory is used up, instead of force evicting them.
+    --gpu-mem-limit=<MB>        Only use this much GPU memory on each GPU, to simulate
+                                a smaller device. Use 0 for no limit. [default: 0]
+    --resource-limits=<file>    Override resource limits of the simulated machine with
+                                those in <file>. Each line is `<type>:<device> <amount>',
+                                e.g. `MEMORY:GPU:0 8G'.
+    -c <file>, --logconf=<file> Path to log configuration file.
+    -v <level>, --verbose=<level>
+                                Enable verbose logging level <level>.
+                                Valid range: 0-9. (0 means disable)
+                                [default: 0]
+    --vmodule=<vmodules>        Specify verbose level per module. [default: ]
+    --vlogfile=<file>           Verbose logging goes to <file>.
+                                [default: verbose.log]
+    --perflog=<file>            Enable performance logging and log to <file>.
+)"s;
+
+template<typename T>
+std::optional<T> optional_arg(const docopt::value &v);
+
+template<>
+std::optional<std::string> optional_arg(const docopt::value &v)
+{
+    return v ? std::make_optional(v.asString()) : std::nullopt;
+}
+
+template<>
+std::optional<int> optional_arg(const docopt::value &v)
+{
+    return v ? std::make_optional(static_cast<int>(v.asLong())) : std::nullopt;
+}
+
+// docopt doesn't handle double number, so we get as string and do conversion ourselves
+double asDouble(const docopt::value &v)
+{
+    return std::stod(v.asString());
+}
+
+std::vector<salus::sim::Workload> selectJobs(const std::vector<salus::sim::Workload> &workloads,
+                                             const docopt::value &names)
+{
+    if (!names) {
+        return workloads;
+    }
+
+    std::map<std::string, const salus::sim::Workload *> byName;
+    for (auto &wl : workloads) {
+        byName.emplace(wl.name, &wl);
+    }
+
+    std::vector<salus::sim::Workload> jobs;
+    std::istringstream iss(names.asString());
+    std::string name;
+    while (std::getline(iss, name, ',')) {
+        if (name.empty()) {
+            continue;
+        }
+        auto it = byName.find(name);
+        if (it == byName.end()) {
+            LOG(ERROR) << "Unknown workload: " << name;
+            continue;
+        }
+        jobs.emplace_back(*it->second);
+    }
+    return jobs;
+}
+
+void printReport(const salus::sim::SimReport &report)
+{
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << std::left << std::setw(32) << "job" << std::right << std::setw(12) << "arrival" << std::setw(12)
+              << "jct" << std::setw(12) << "standalone" << std::setw(10) << "slowdown" << std::setw(10) << "iters"
+              << "\n";
+    for (auto &job : report.jobs) {
+        std::cout << std::left << std::setw(32) << job.name << std::right << std::setw(12) << job.arrival
+                  << std::setw(12) << job.jct() << std::setw(12) << job.standalone << std::setw(10)
+                  << (job.standalone > 0 ? job.jct() / job.standalone : 0) << std::setw(10) << job.iters << "\n";
+    }
+
+    double avgJct = 0;
+    for (auto &job : report.jobs) {
+        avgJct += job.jct();
+    }
+    if (!report.jobs.empty()) {
+        avgJct /= report.jobs.size();
+    }
+
+    std::cout << "\n";
+    std::cout << "Jobs:            " << report.jobs.size() << "\n";
+    std::cout << "Average JCT:     " << avgJct << " s\n";
+    std::cout << "Makespan:        " << report.makespan << " s\n";
+    std::cout << "Utilization:     " << report.utilization * 100 << " %\n";
+    std::cout << "Wall time:       " << report.wallSeconds << " s\n";
+    std::cout << "Process CPU:     " << report.cpuSeconds << " s ("
+              << (report.wallSeconds > 0 ? report.cpuSeconds / report.wallSeconds * 100 : 0) << " % of wall time, "
+              << (report.totalIters ? report.cpuSeconds * 1e6 / report.totalIters : 0) << " us per iteration)\n";
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    auto args = docopt::docopt(kUsage, {argv + 1, argv + argc}, /* help = */ true);
+
+    logging::initialize({
+        optional_arg<std::string>(args[flags::logConf]),
+        optional_arg<int>(args[flags::verbose]),
+        optional_arg<std::string>(args[flags::vModule]),
+        optional_arg<std::string>(args[flags::vLogFile]),
+        optional_arg<std::string>(args[flags::pLogFile]),
+    });
+
+    salus::sim::SimConfig config;
+    config.speedup = asDouble(args[flags::speedup]);
+    config.interval = asDouble(args[flags::interval]);
+    config.maxIters = args[flags::maxIters].asLong();
+    config.numOps = args[flags::numOps].asLong();
+    config.persistentFraction = asDouble(args[flags::persistent]);
+    config.sm = args[flags::sm].asLong();
+
+    auto workloads = salus::sim::loadWorkloads(args[flags::workloads].asString());
+    auto jobs = selectJobs(workloads, args[flags::jobs]);
+    if (jobs.empty()) {
+        LOG(ERROR) << "Nothing to run";
+        return 1;
+    }
+
+    if (auto gpuMemLimit = static_cast<uint64_t>(args[flags::gpuMemLimit].asLong()) * 1024 * 1024) {
+        resources::capPlatformLimits(ResourceType::MEMORY, salus::DeviceType::GPU, gpuMemLimit);
+    }
+
+    if (auto path = optional_arg<std::string>(args[flags::resourceLimits])) {
+        auto overrides = resources::loadLimitsFile(*path);
+        if (!overrides) {
+            LOG(ERROR) << "Invalid resource limits file " << *path;
+            return 1;
+        }
+        resources::overridePlatformLimits(*overrides);
+    }
+
+    auto &engine = salus::ExecutionEngine::instance();
+    engine.setSchedulingParam({
+        static_cast<uint64_t>(args[flags::maxShadowHold].asLong()),
+        true,
+        args[flags::scheduler].asString(),
+        static_cast<uint64_t>(args[flags::schedThreads].asLong()),
+        static_cast<uint64_t>(args[flags::maxConcurrentIters].asLong()),
+        args[flags::chainTasks].asBool(),
+        args[flags::oversubscribe].asBool(),
+    });
+
+    LOG(INFO) << "Simulating " << jobs.size() << " jobs with policy " << engine.schedulingParam().scheduler
+              << " at " << config.speedup << "x speed";
+
+    engine.startScheduler();
+    auto report = salus::sim::Simulator(engine, config).run(jobs);
+    engine.logIterLatency();
+    engine.stopScheduler();
+
+    printReport(report);
+    return 0;
+}
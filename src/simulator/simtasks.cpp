@@ -0,0 +1,153 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "simulator/simtasks.h"
+
+#include "execution/engine/iterationcontext.h"
+#include "execution/engine/resourcecontext.h"
+#include "execution/executionengine.h"
+#include "platform/logging.h"
+#include "simulator/simdevice.h"
+
+#include <sstream>
+
+namespace salus::sim {
+
+SimOperationTask::SimOperationTask(SimDevice &dev, const SimProfile &profile, uint64_t graphId, size_t index,
+                                   std::function<void()> done)
+    : m_dev(dev)
+    , m_profile(profile)
+    , m_graphId(graphId)
+    , m_index(index)
+    , m_done(std::move(done))
+{
+}
+
+SimOperationTask::~SimOperationTask() = default;
+
+std::string SimOperationTask::DebugString() const
+{
+    std::ostringstream oss;
+    oss << "SimOperationTask(graph=" << m_graphId << ", index=" << m_index << ")";
+    return oss.str();
+}
+
+Resources SimOperationTask::estimatedUsage(const DeviceSpec &dev)
+{
+    if (dev != devices::GPU0) {
+        return {};
+    }
+    return {{resources::GPU0Memory, m_profile.temporary / std::max<size_t>(m_profile.numOps, 1)}};
+}
+
+OperationTask::DeviceTypes SimOperationTask::supportedDeviceTypes() const
+{
+    static DeviceType types[] = {DeviceType::GPU};
+    return types;
+}
+
+bool SimOperationTask::prepare(std::unique_ptr<ResourceContext> &&rctx) noexcept
+{
+    m_rctx = std::move(rctx);
+    return static_cast<bool>(m_rctx);
+}
+
+ResourceContext &SimOperationTask::resourceContext() const
+{
+    DCHECK(m_rctx);
+    return *m_rctx;
+}
+
+void SimOperationTask::run(Callbacks cbs) noexcept
+{
+    auto dur = SimDevice::Duration{m_profile.iterTime / std::max<size_t>(m_profile.numOps, 1)};
+    m_dev.launch(m_profile.sm, dur, [cbs = std::move(cbs), done = m_done]() {
+        cbs.done();
+        if (done) {
+            done();
+        }
+    });
+}
+
+struct SimIterationTask::Running
+{
+    SimDevice &dev;
+    const SimProfile &profile;
+    uint64_t graphId;
+    std::shared_ptr<IterationContext> ictx;
+    std::function<void()> done;
+    size_t nextOp = 0;
+};
+
+SimIterationTask::SimIterationTask(SimDevice &dev, std::shared_ptr<ExecutionContext> ectx,
+                                   const SimProfile &profile, uint64_t graphId, std::function<void()> done)
+    : m_dev(dev)
+    , m_ectx(std::move(ectx))
+    , m_profile(profile)
+    , m_graphId(graphId)
+    , m_done(std::move(done))
+{
+}
+
+SimIterationTask::~SimIterationTask() = default;
+
+bool SimIterationTask::prepare()
+{
+    return m_ectx->m_item->beginIteration(m_ectx->m_ticket, estimatedPeakAllocation(devices::GPU0), m_graphId);
+}
+
+ResStats SimIterationTask::estimatedPeakAllocation(const DeviceSpec &dev) const
+{
+    if (dev != devices::GPU0) {
+        return {};
+    }
+    ResStats stats;
+    stats.temporary = m_profile.temporary;
+    stats.persist = m_profile.persistent;
+    stats.count = m_profile.numOps;
+    return stats;
+}
+
+void SimIterationTask::runAsync(std::shared_ptr<IterationContext> &&ictx) noexcept
+{
+    ictx->setGraphId(m_graphId);
+    runNextOp(std::make_shared<Running>(Running{m_dev, m_profile, m_graphId, std::move(ictx), std::move(m_done)}));
+}
+
+void SimIterationTask::runNextOp(std::shared_ptr<Running> running)
+{
+    if (running->nextOp == running->profile.numOps) {
+        running->ictx->finish();
+        running->ictx.reset();
+        if (running->done) {
+            running->done();
+        }
+        return;
+    }
+
+    auto index = running->nextOp++;
+    auto &ictx = *running->ictx;
+    auto &dev = running->dev;
+    auto &profile = running->profile;
+    auto graphId = running->graphId;
+    ictx.scheduleTask(std::make_unique<SimOperationTask>(dev, profile, graphId, index,
+                                                         [running = std::move(running)]() { runNextOp(running); }));
+}
+
+} // namespace salus::sim
@@ -0,0 +1,167 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SALUS_SIM_SIMTASKS_H
+#define SALUS_SIM_SIMTASKS_H
+
+#include "execution/iterationtask.h"
+#include "execution/operationtask.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+
+namespace salus {
+class ExecutionContext;
+} // namespace salus
+
+namespace salus::sim {
+
+class SimDevice;
+
+/**
+ * @brief Resource profile of a synthetic job
+ */
+struct SimProfile
+{
+    // simulated seconds per iteration when running alone
+    double iterTime = 0;
+    // number of kernels per iteration, run one after another
+    size_t numOps = 1;
+    // GPU memory kept for the whole job, in bytes
+    size_t persistent = 0;
+    // peak GPU memory used by an iteration on top of persistent, in bytes
+    size_t temporary = 0;
+    // SM units used by each kernel
+    int sm = 1;
+};
+
+/**
+ * @brief One kernel of a synthetic iteration. It holds its share of the iteration's
+ * temporary memory while running on the simulated device.
+ */
+class SimOperationTask : public OperationTask
+{
+public:
+    SimOperationTask(SimDevice &dev, const SimProfile &profile, uint64_t graphId, size_t index,
+                     std::function<void()> done);
+
+    ~SimOperationTask() override;
+
+    std::string DebugString() const override;
+
+    uint64_t graphId() const override
+    {
+        return m_graphId;
+    }
+
+    Resources estimatedUsage(const DeviceSpec &dev) override;
+
+    bool hasExactEstimation(const DeviceSpec &) override
+    {
+        return true;
+    }
+
+    DeviceTypes supportedDeviceTypes() const override;
+
+    int failedTimes() const override
+    {
+        return 0;
+    }
+
+    bool prepare(std::unique_ptr<ResourceContext> &&rctx) noexcept override;
+
+    ResourceContext &resourceContext() const override;
+
+    bool isAsync() const override
+    {
+        return false;
+    }
+
+    void run(Callbacks cbs) noexcept override;
+
+    void cancel() override {}
+
+private:
+    SimDevice &m_dev;
+    const SimProfile &m_profile;
+    const uint64_t m_graphId;
+    const size_t m_index;
+    std::function<void()> m_done;
+
+    std::unique_ptr<ResourceContext> m_rctx;
+};
+
+/**
+ * @brief A synthetic training iteration consisting of `numOps` kernels
+ */
+class SimIterationTask : public IterationTask
+{
+public:
+    /**
+     * @param profile must outlive the iteration
+     * @param done called after the iteration finished
+     */
+    SimIterationTask(SimDevice &dev, std::shared_ptr<ExecutionContext> ectx, const SimProfile &profile,
+                     uint64_t graphId, std::function<void()> done);
+
+    ~SimIterationTask() override;
+
+    uint64_t graphId() const override
+    {
+        return m_graphId;
+    }
+
+    bool prepare() override;
+
+    ResStats estimatedPeakAllocation(const DeviceSpec &dev) const override;
+
+    void runAsync(std::shared_ptr<IterationContext> &&ictx) noexcept override;
+
+    void cancel() override
+    {
+        m_canceled = true;
+    }
+
+    bool isCanceled() const override
+    {
+        return m_canceled;
+    }
+
+    bool isExpensive() const override
+    {
+        return true;
+    }
+
+private:
+    struct Running;
+    static void runNextOp(std::shared_ptr<Running> running);
+
+    SimDevice &m_dev;
+    std::shared_ptr<ExecutionContext> m_ectx;
+    const SimProfile &m_profile;
+    const uint64_t m_graphId;
+    std::function<void()> m_done;
+
+    std::atomic<bool> m_canceled{false};
+};
+
+} // namespace salus::sim
+
+#endif // SALUS_SIM_SIMTASKS_H
@@ -0,0 +1,204 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SALUS_SSTL_CONCURRENTIDSET_H
+#define SALUS_SSTL_CONCURRENTIDSET_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace sstl {
+/**
+ * @brief A lock-free set of nonzero 64 bit ids, for a small and churning population.
+ *
+ * Each id hashes to a window of `kWindow` slots in a table, and is stored in any empty slot of it.
+ * When a window is full, the id goes to the next table, which is twice as large and allocated on
+ * demand. Tables are only freed when the set is destroyed.
+ *
+ * `insert` of an id already present is a scan of its windows without any write. Two threads
+ * inserting the same id at the same time may both store it, so `erase` removes every copy.
+ * Concurrent `insert` and `erase` of the same id is not ordered.
+ */
+class ConcurrentIdSet
+{
+public:
+    explicit ConcurrentIdSet(size_t capacity = 256)
+        : m_first(capacity)
+    {
+    }
+
+    ConcurrentIdSet(const ConcurrentIdSet &) = delete;
+    ConcurrentIdSet &operator=(const ConcurrentIdSet &) = delete;
+
+    ~ConcurrentIdSet()
+    {
+        auto t = m_first.next.load(std::memory_order_relaxed);
+        while (t) {
+            auto next = t->next.load(std::memory_order_relaxed);
+            delete t;
+            t = next;
+        }
+    }
+
+    /**
+     * @brief Add id, which must be nonzero
+     * @returns false if it's already present
+     */
+    bool insert(uint64_t id)
+    {
+        if (contains(id)) {
+            return false;
+        }
+
+        for (auto t = &m_first;; t = t->nextOrGrow()) {
+            auto base = t->windowOf(id);
+            for (size_t i = 0; i != kWindow; ++i) {
+                auto &slot = t->slots[base + i];
+                auto curr = slot.load(std::memory_order_relaxed);
+                if (curr == 0 && slot.compare_exchange_strong(curr, id, std::memory_order_acq_rel)) {
+                    m_size.fetch_add(1, std::memory_order_relaxed);
+                    return true;
+                }
+                if (curr == id) {
+                    return false;
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief Remove all copies of id
+     * @returns true if it was present
+     */
+    bool erase(uint64_t id)
+    {
+        bool found = false;
+        for (auto t = &m_first; t; t = t->next.load(std::memory_order_acquire)) {
+            auto base = t->windowOf(id);
+            for (size_t i = 0; i != kWindow; ++i) {
+                auto expected = id;
+                if (t->slots[base + i].compare_exchange_strong(expected, 0, std::memory_order_acq_rel)) {
+                    m_size.fetch_sub(1, std::memory_order_relaxed);
+                    found = true;
+                }
+            }
+        }
+        return found;
+    }
+
+    bool contains(uint64_t id) const
+    {
+        for (auto t = &m_first; t; t = t->next.load(std::memory_order_acquire)) {
+            auto base = t->windowOf(id);
+            for (size_t i = 0; i != kWindow; ++i) {
+                if (t->slots[base + i].load(std::memory_order_acquire) == id) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    bool empty() const
+    {
+        return m_size.load(std::memory_order_relaxed) == 0;
+    }
+
+    /**
+     * @brief Call fn on each id present. Ids inserted or erased concurrently may or may not be
+     * visited, and an id may be visited more than once.
+     */
+    template<typename Fn>
+    void forEach(Fn &&fn) const
+    {
+        for (auto t = &m_first; t; t = t->next.load(std::memory_order_acquire)) {
+            for (size_t i = 0; i != t->numSlots(); ++i) {
+                auto id = t->slots[i].load(std::memory_order_acquire);
+                if (id) {
+                    fn(id);
+                }
+            }
+        }
+    }
+
+private:
+    constexpr static size_t kWindow = 8;
+
+    struct Table
+    {
+        // capacity is a power of 2 no smaller than kWindow, with kWindow - 1 extra slots
+        // so a window never wraps around
+        size_t capacity;
+        std::unique_ptr<std::atomic<uint64_t>[]> slots;
+        std::atomic<Table *> next{nullptr};
+
+        explicit Table(size_t cap)
+            : capacity(roundUp(cap))
+            , slots(new std::atomic<uint64_t>[numSlots()])
+        {
+            for (size_t i = 0; i != numSlots(); ++i) {
+                slots[i].store(0, std::memory_order_relaxed);
+            }
+        }
+
+        size_t numSlots() const
+        {
+            return capacity + kWindow - 1;
+        }
+
+        size_t windowOf(uint64_t id) const
+        {
+            // Fibonacci hashing, ids from a counter spread evenly
+            return static_cast<size_t>((id * 0x9E3779B97F4A7C15ull) >> 32) & (capacity - 1);
+        }
+
+        Table *nextOrGrow()
+        {
+            auto n = next.load(std::memory_order_acquire);
+            if (n) {
+                return n;
+            }
+            auto fresh = new Table(capacity * 2);
+            if (next.compare_exchange_strong(n, fresh, std::memory_order_acq_rel)) {
+                return fresh;
+            }
+            delete fresh;
+            return n;
+        }
+
+        static size_t roundUp(size_t cap)
+        {
+            size_t c = kWindow;
+            while (c < cap) {
+                c <<= 1;
+            }
+            return c;
+        }
+    };
+
+    Table m_first;
+    std::atomic<size_t> m_size{0};
+};
+
+} // namespace sstl
+
+#endif // SALUS_SSTL_CONCURRENTIDSET_H
@@ -0,0 +1,68 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "histogram.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace sstl {
+
+Histogram::Snapshot Histogram::snapshot() const
+{
+    Snapshot snap;
+    for (size_t i = 0; i != kNumBuckets; ++i) {
+        snap.buckets[i] = m_buckets[i].load(std::memory_order_relaxed);
+        // count from buckets, so percentiles are consistent with it
+        snap.count += snap.buckets[i];
+    }
+    snap.sum = m_sum.load(std::memory_order_relaxed);
+    snap.max = m_max.load(std::memory_order_relaxed);
+    return snap;
+}
+
+uint64_t Histogram::highestOf(size_t idx)
+{
+    if (idx < kSubBuckets) {
+        return idx;
+    }
+    auto shift = idx / kSubBuckets - 1;
+    auto sub = idx % kSubBuckets;
+    return ((kSubBuckets + sub + 1) << shift) - 1;
+}
+
+uint64_t Histogram::Snapshot::percentile(double p) const
+{
+    if (count == 0) {
+        return 0;
+    }
+    auto rank = static_cast<uint64_t>(std::ceil(std::clamp(p, 0.0, 100.0) / 100 * count));
+    rank = std::max<uint64_t>(rank, 1);
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i != kNumBuckets; ++i) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            return std::min(highestOf(i), max);
+        }
+    }
+    return max;
+}
+
+} // namespace sstl
@@ -0,0 +1,100 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SALUS_SSTL_HISTOGRAM_H
+#define SALUS_SSTL_HISTOGRAM_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace sstl {
+
+/**
+ * @brief Log-linear histogram of non-negative integers, in the spirit of HdrHistogram.
+ *
+ * Values below 2^kSubBucketBits are recorded exactly, larger ones with a relative error
+ * of at most 2^-kSubBucketBits. Values beyond 2^kMaxBits are clamped.
+ * Recording takes a few relaxed atomic adds, and snapshots can be taken from any thread
+ * while recording continues, at the cost of not being an exact point-in-time view.
+ */
+class Histogram
+{
+public:
+    static constexpr int kSubBucketBits = 4;
+    static constexpr int kMaxBits = 40;
+    static constexpr uint64_t kSubBuckets = uint64_t{1} << kSubBucketBits;
+    static constexpr size_t kNumBuckets = (kMaxBits - kSubBucketBits + 1) * kSubBuckets;
+    static constexpr uint64_t kMaxValue = (uint64_t{1} << kMaxBits) - 1;
+
+    struct Snapshot
+    {
+        uint64_t count = 0;
+        uint64_t sum = 0;
+        uint64_t max = 0;
+        std::array<uint64_t, kNumBuckets> buckets{};
+
+        double mean() const
+        {
+            return count ? static_cast<double>(sum) / count : 0;
+        }
+
+        /**
+         * @brief The highest value equivalent to the value at percentile `p` in [0, 100]
+         */
+        uint64_t percentile(double p) const;
+    };
+
+    void record(uint64_t value)
+    {
+        value = value > kMaxValue ? kMaxValue : value;
+        m_buckets[bucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+        m_sum.fetch_add(value, std::memory_order_relaxed);
+        auto prev = m_max.load(std::memory_order_relaxed);
+        while (prev < value && !m_max.compare_exchange_weak(prev, value, std::memory_order_relaxed)) {
+        }
+    }
+
+    Snapshot snapshot() const;
+
+    static size_t bucketOf(uint64_t value)
+    {
+        if (value < kSubBuckets) {
+            return value;
+        }
+        auto msb = 63 - __builtin_clzll(value);
+        auto shift = msb - kSubBucketBits;
+        return (shift + 1) * kSubBuckets + ((value >> shift) & (kSubBuckets - 1));
+    }
+
+    /**
+     * @brief The highest value recorded into bucket `idx`
+     */
+    static uint64_t highestOf(size_t idx);
+
+private:
+    std::array<std::atomic<uint64_t>, kNumBuckets> m_buckets{};
+    std::atomic<uint64_t> m_sum{0};
+    std::atomic<uint64_t> m_max{0};
+};
+
+} // namespace sstl
+
+#endif // SALUS_SSTL_HISTOGRAM_H
@@ -0,0 +1,100 @@
+/*
+ * Copyright 2019 Peifeng Yu <peifeng@umich.edu>
+ * 
+ * This file is part of Salus
+ * (see https://github.com/SymbioticLab/Salus).
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SALUS_SSTL_MPSCINBOX_H
+#define SALUS_SSTL_MPSCINBOX_H
+
+#include <atomic>
+#include <cstddef>
+
+namespace sstl {
+/**
+ * @brief An intrusive multi-producer single-consumer inbox.
+ *
+ * Producers push with a single CAS loop and no allocation, using the `Next` member of `T` as link.
+ * The consumer takes everything with one atomic exchange, in the order they were pushed.
+ *
+ * The inbox doesn't own nodes. A node must not be pushed again before it's drained.
+ */
+template<typename T, T *T::*Next>
+class MpscInbox
+{
+public:
+    MpscInbox() = default;
+    MpscInbox(const MpscInbox &) = delete;
+    MpscInbox &operator=(const MpscInbox &) = delete;
+
+    /**
+     * @brief Push node, safe to call from any thread
+     * @returns true if the inbox was empty before
+     */
+    bool push(T *node) noexcept
+    {
+        auto head = m_head.load(std::memory_order_relaxed);
+        do {
+            node->*Next = head;
+        } while (!m_head.compare_exchange_weak(head, node, std::memory_order_release, std::memory_order_relaxed));
+        return head == nullptr;
+    }
+
+    bool empty() const noexcept
+    {
+        return m_head.load(std::memory_order_relaxed) == nullptr;
+    }
+
+    /**
+     * @brief Take all nodes and call fn on each of them in push order. Only called from the consumer.
+     * The link of a node is cleared before fn is called on it.
+     * @returns number of nodes taken
+     */
+    template<typename Fn>
+    size_t drain(Fn &&fn)
+    {
+        auto head = m_head.exchange(nullptr, std::memory_order_acquire);
+        if (!head) {
+            return 0;
+        }
+
+        // reverse the LIFO chain
+        T *fifo = nullptr;
+        size_t count = 0;
+        while (head) {
+            auto next = head->*Next;
+            head->*Next = fifo;
+            fifo = head;
+            head = next;
+            ++count;
+        }
+
+        while (fifo) {
+            auto next = fifo->*Next;
+            fifo->*Next = nullptr;
+            fn(fifo);
+            fifo = next;
+        }
+        return count;
+    }
+
+private:
+    std::atomic<T *> m_head{nullptr};
+};
+
+} // namespace sstl
+
+#endif // SALUS_SSTL_MPSCINBOX_H
@@ -66,4 +66,14 @@ void notification::wait()
     m_notified = false;
 }
 
+bool notification::wait_until(std::chrono::steady_clock::time_point deadline)
+{
+    auto g = with_uguard(m_mu);
+    if (!m_cv.wait_until(g, deadline, [this]() { return m_notified; })) {
+        return false;
+    }
+    m_notified = false;
+    return true;
+}
+
 } // namespace sstl
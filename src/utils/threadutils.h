@@ -263,6 +263,11 @@ public:
     void notify();
     bool notified();
     void wait();
+    /**
+     * @brief Wait until notified or `deadline` is passed
+     * @returns whether notified
+     */
+    bool wait_until(std::chrono::steady_clock::time_point deadline);
 };
 
 } // namespace sstl